@@ -0,0 +1,69 @@
+// Compares the cost of calling methods on a Lang.Class instance with
+// calling them on a plain prototype.
+//
+// Run with: gjs examples/lang-class-bench.js [iterations]
+
+const GLib = imports.gi.GLib;
+const Lang = imports.lang;
+
+function Plain() {
+    this._value = 0;
+}
+
+Plain.prototype = {
+    add: function(n) {
+        this._value += n;
+        return this._value;
+    }
+};
+
+function PlainChild() {
+    Plain.call(this);
+}
+
+PlainChild.prototype = Object.create(Plain.prototype);
+PlainChild.prototype.add = function(n) {
+    return Plain.prototype.add.call(this, n) + 1;
+};
+
+const Base = new Lang.Class({
+    Name: 'Base',
+
+    _init: function() {
+        this._value = 0;
+    },
+
+    add: function(n) {
+        this._value += n;
+        return this._value;
+    }
+});
+
+const Child = new Lang.Class({
+    Name: 'Child',
+    Extends: Base,
+
+    add: function(n) {
+        return this.parent(n) + 1;
+    }
+});
+
+function measure(name, obj, iterations) {
+    // warm up the JIT first
+    for (let i = 0; i < 1000; i++)
+        obj.add(1);
+
+    let start = GLib.get_monotonic_time();
+    for (let i = 0; i < iterations; i++)
+        obj.add(1);
+    let elapsed = GLib.get_monotonic_time() - start;
+
+    print(name + ': ' + (elapsed * 1000 / iterations).toFixed(1) + ' ns/call');
+}
+
+let iterations = ARGV.length > 0 ? parseInt(ARGV[0], 10) : 1000000;
+
+measure('plain prototype', new Plain(), iterations);
+measure('Lang.Class', new Base(), iterations);
+measure('plain prototype, chained', new PlainChild(), iterations);
+measure('Lang.Class, parent()', new Child(), iterations);
@@ -28,6 +28,7 @@
 #include "boxed.h"
 #include "arg.h"
 #include "object.h"
+#include "gjs_gi_trace.h"
 #include <gjs/gjs-module.h>
 #include <gjs/compat.h>
 #include <gjs/runtime.h>
@@ -442,6 +443,16 @@ boxed_new(JSContext   *context,
     return boxed_init_from_props (context, obj, priv, argv[0]);
 }
 
+static void
+trace_proxy_new(Boxed *priv)
+{
+    if (priv->gboxed && TRACE_ENABLED(BOXED_PROXY_NEW)) {
+        TRACE(GJS_BOXED_PROXY_NEW(priv, priv->gboxed,
+                                  (char *) g_base_info_get_namespace((GIBaseInfo*) priv->info),
+                                  (char *) g_base_info_get_name((GIBaseInfo*) priv->info)));
+    }
+}
+
 GJS_NATIVE_CONSTRUCTOR_DECLARE(boxed)
 {
     GJS_NATIVE_CONSTRUCTOR_VARIABLES(boxed)
@@ -487,6 +498,7 @@ GJS_NATIVE_CONSTRUCTOR_DECLARE(boxed)
 
         if (g_type_is_a (priv->gtype, G_TYPE_BOXED)) {
             priv->gboxed = g_boxed_copy(priv->gtype, source_priv->gboxed);
+            trace_proxy_new(priv);
 
             GJS_NATIVE_CONSTRUCTOR_FINISH(boxed);
             return JS_TRUE;
@@ -494,6 +506,7 @@ GJS_NATIVE_CONSTRUCTOR_DECLARE(boxed)
             boxed_new_direct (priv);
             memcpy(priv->gboxed, source_priv->gboxed,
                    g_struct_info_get_size (priv->info));
+            trace_proxy_new(priv);
 
             GJS_NATIVE_CONSTRUCTOR_FINISH(boxed);
             return JS_TRUE;
@@ -511,6 +524,8 @@ GJS_NATIVE_CONSTRUCTOR_DECLARE(boxed)
     retval = boxed_new(context, object, priv, argc, argv, &actual_rval);
 
     if (retval) {
+        trace_proxy_new(priv);
+
         if (!JSVAL_IS_VOID (actual_rval))
             JS_SET_RVAL(context, vp, actual_rval);
         else
@@ -534,6 +549,12 @@ boxed_finalize(JSFreeOp *fop,
     if (priv == NULL)
         return; /* wrong class? */
 
+    if (priv->gboxed && TRACE_ENABLED(BOXED_PROXY_FINALIZE)) {
+        TRACE(GJS_BOXED_PROXY_FINALIZE(priv, priv->gboxed,
+                                       (char *) g_base_info_get_namespace((GIBaseInfo*) priv->info),
+                                       (char *) g_base_info_get_name((GIBaseInfo*) priv->info)));
+    }
+
     if (priv->gboxed && !priv->not_owning_gboxed) {
         if (priv->allocated_directly) {
             g_slice_free1(g_struct_info_get_size (priv->info), priv->gboxed);
@@ -1264,6 +1285,8 @@ gjs_boxed_from_c_struct(JSContext             *context,
         }
     }
 
+    trace_proxy_new(priv);
+
     return obj;
 }
 
@@ -29,6 +29,7 @@
 
 #include "closure.h"
 #include "keep-alive.h"
+#include "gjs_gi_trace.h"
 #include <gjs/gjs-module.h>
 #include <gjs/compat.h>
 #include <gjs/runtime.h>
@@ -81,6 +82,10 @@ invalidate_js_pointers(Closure *c)
     if (c->obj == NULL)
         return;
 
+    /* c->obj is traced from the signal-connected object wrapper, see
+     * gjs_closure_trace(); let an incremental GC know the edge is gone.
+     */
+    gjs_gc_write_barrier(c->obj);
     c->obj = NULL;
     c->context = NULL;
     c->runtime = NULL;
@@ -169,6 +174,8 @@ closure_invalidated(gpointer data,
     gjs_debug_closure("Invalidating closure %p which calls object %p",
                       closure, c->obj);
 
+    TRACE(GJS_CLOSURE_INVALIDATE(closure, c->obj));
+
     if (c->obj == NULL) {
         gjs_debug_closure("   (closure %p already dead, nothing to do)",
                           closure);
@@ -239,6 +246,9 @@ closure_set_invalid(gpointer  data,
 {
     Closure *self = (Closure*) closure;
 
+    TRACE(GJS_CLOSURE_INVALIDATE(closure, self->obj));
+
+    gjs_gc_write_barrier(self->obj);
     self->obj = NULL;
     self->context = NULL;
     self->runtime = NULL;
@@ -40,7 +40,9 @@ static struct {
     { NULL }
 };
 
+/* Shared by the runtimes of all threads; only touched with the lock held */
 static GHashTable* foreign_structs_table = NULL;
+static GMutex foreign_structs_lock;
 
 static GHashTable*
 get_foreign_structs(void)
@@ -55,6 +57,18 @@ get_foreign_structs(void)
     return foreign_structs_table;
 }
 
+static GjsForeignInfo*
+lookup_foreign_struct(const char *key)
+{
+    GjsForeignInfo *retval;
+
+    g_mutex_lock(&foreign_structs_lock);
+    retval = (GjsForeignInfo*)g_hash_table_lookup(get_foreign_structs(), key);
+    g_mutex_unlock(&foreign_structs_lock);
+
+    return retval;
+}
+
 static JSBool
 gjs_foreign_load_foreign_module(JSContext *context,
                                 const gchar *namespace)
@@ -103,7 +117,9 @@ gjs_struct_foreign_register(const char *namespace,
     g_return_val_if_fail(info->from_func != NULL, JS_FALSE);
 
     canonical_name = g_strdup_printf("%s.%s", namespace, type_name);
+    g_mutex_lock(&foreign_structs_lock);
     g_hash_table_insert(get_foreign_structs(), canonical_name, info);
+    g_mutex_unlock(&foreign_structs_lock);
     return JS_TRUE;
 }
 
@@ -112,17 +128,15 @@ gjs_struct_foreign_lookup(JSContext  *context,
                           GIBaseInfo *interface_info)
 {
     GjsForeignInfo *retval = NULL;
-    GHashTable *hash_table;
     char *key;
 
     key = g_strdup_printf("%s.%s",
                           g_base_info_get_namespace(interface_info),
                           g_base_info_get_name(interface_info));
-    hash_table = get_foreign_structs();
-    retval = (GjsForeignInfo*)g_hash_table_lookup(hash_table, key);
+    retval = lookup_foreign_struct(key);
     if (!retval) {
         if (gjs_foreign_load_foreign_module(context, g_base_info_get_namespace(interface_info))) {
-            retval = (GjsForeignInfo*)g_hash_table_lookup(hash_table, key);
+            retval = lookup_foreign_struct(key);
         }
     }
 
@@ -30,6 +30,7 @@
 #include "boxed.h"
 #include "union.h"
 #include "gerror.h"
+#include "gjs_gi_trace.h"
 #include <gjs/runtime.h>
 #include <gjs/gjs-module.h>
 #include <gjs/compat.h>
@@ -47,7 +48,9 @@
  */
 #define GJS_ARG_INDEX_INVALID G_MAXUINT8
 
-typedef struct {
+typedef struct _Function Function;
+
+struct _Function {
     GIFunctionInfo *info;
 
     GjsParamType *param_types;
@@ -55,15 +58,46 @@ typedef struct {
     guint8 expected_js_argc;
     guint8 js_out_argc;
     GIFunctionInvoker invoker;
-} Function;
+
+    /* For foo_async(): the position of its GAsyncReadyCallback, when
+     * that is the last JS argument, and foo_finish(), looked up the
+     * first time foo_async() is called without a callback.
+     */
+    guint8 async_callback_pos;
+    Function *async_finish;
+};
+
+/* A call to foo_async() without a callback, resolving @promise with
+ * the return value of foo_finish() or rejecting it with its error.
+ * All of them share gjs_async_ready_callback() as callback, instead
+ * of creating a trampoline each.
+ */
+typedef struct {
+    GList link; /* in async_calls or completed_async_calls */
+    JSRuntime *runtime; /* NULL once the runtime is gone */
+    Function *function;
+    JSObject *callee;
+    JSObject *this_obj;
+    JSObject *promise;
+    GAsyncResult *result;
+    gboolean started;
+} GjsAsyncCall;
 
 static struct JSClass gjs_function_class;
 
+static gboolean init_cached_function_data (JSContext      *context,
+                                           Function       *function,
+                                           GType           gtype,
+                                           GICallableInfo *info);
+static void uninit_cached_function_data (Function *function);
+static void gjs_async_ready_callback    (GObject        *source_object,
+                                         GAsyncResult   *result,
+                                         gpointer        user_data);
+
 /* Because we can't free the mmap'd data for a callback
  * while it's in use, this list keeps track of ones that
  * will be freed the next time we invoke a C function.
  */
-static GSList *completed_trampolines = NULL;  /* GjsCallbackTrampoline */
 
 GJS_DEFINE_PRIV_FROM_JS(Function, gjs_function_class)
 
@@ -76,7 +110,9 @@ gjs_callback_trampoline_ref(GjsCallbackTrampoline *trampoline)
 void
 gjs_callback_trampoline_unref(GjsCallbackTrampoline *trampoline)
 {
-    /* Not MT-safe, like all the rest of GJS */
+    /* Not MT-safe; a trampoline only belongs to the runtime that
+     * created it, which is used from a single thread.
+     */
 
     trampoline->ref_count--;
     if (trampoline->ref_count == 0) {
@@ -93,6 +129,7 @@ gjs_callback_trampoline_unref(GjsCallbackTrampoline *trampoline)
         g_callable_info_free_closure(trampoline->info, trampoline->closure);
         g_base_info_unref( (GIBaseInfo*) trampoline->info);
         g_free (trampoline->param_types);
+        g_free (trampoline->args);
         g_slice_free(GjsCallbackTrampoline, trampoline);
     }
 }
@@ -172,72 +209,61 @@ gjs_callback_closure(ffi_cif *cif,
     JSContext *context;
     GjsCallbackTrampoline *trampoline;
     int i, n_args, n_jsargs, n_outargs;
-    jsval *jsargs, rval;
+    jsval *frame, *jsargs, rval;
     JSObject *this_object;
-    GITypeInfo ret_type;
+    GITypeInfo *ret_type;
     gboolean success = FALSE;
-    gboolean ret_type_is_void;
 
     trampoline = data;
     g_assert(trampoline);
     gjs_callback_trampoline_ref(trampoline);
 
+    if (TRACE_ENABLED(CALLBACK_ENTRY)) {
+        TRACE(GJS_CALLBACK_ENTRY(trampoline,
+                                 (char *) g_base_info_get_name((GIBaseInfo *) trampoline->info),
+                                 trampoline->is_vfunc));
+    }
+
     context = gjs_runtime_get_context(trampoline->runtime);
     JS_BeginRequest(context);
 
-    n_args = g_callable_info_get_n_args(trampoline->info);
-
-    g_assert(n_args >= 0);
+    n_args = trampoline->n_args;
+    n_outargs = trampoline->n_outargs;
+    ret_type = &trampoline->ret_type;
 
-    n_outargs = 0;
-    jsargs = (jsval*)g_newa(jsval, n_args);
+    /* The JS arguments and the return value live in one traced frame
+     * on the runtime's value stack; the last slot is the return value.
+     */
+    frame = gjs_runtime_push_values(trampoline->runtime, n_args + 1);
+    jsargs = frame;
     for (i = 0, n_jsargs = 0; i < n_args; i++) {
-        GIArgInfo arg_info;
-        GITypeInfo type_info;
-        GjsParamType param_type;
-
-        g_callable_info_load_arg(trampoline->info, i, &arg_info);
-        g_arg_info_load_type(&arg_info, &type_info);
-
-        /* Skip void * arguments */
-        if (g_type_info_get_tag(&type_info) == GI_TYPE_TAG_VOID)
-            continue;
+        GjsCallbackArg *arg = &trampoline->args[i];
 
-        if (g_arg_info_get_direction(&arg_info) == GI_DIRECTION_OUT) {
-            n_outargs++;
+        /* Skip void * arguments and out arguments */
+        if (arg->is_void || arg->direction == GI_DIRECTION_OUT)
             continue;
-        }
-
-        if (g_arg_info_get_direction(&arg_info) == GI_DIRECTION_INOUT)
-            n_outargs++;
 
-        param_type = trampoline->param_types[i];
-
-        switch (param_type) {
+        switch (trampoline->param_types[i]) {
             case PARAM_SKIPPED:
                 continue;
             case PARAM_ARRAY: {
-                gint array_length_pos = g_type_info_get_array_length(&type_info);
-                GIArgInfo array_length_arg;
-                GITypeInfo arg_type_info;
+                gint array_length_pos = g_type_info_get_array_length(&arg->type_info);
                 jsval length;
 
-                g_callable_info_load_arg(trampoline->info, array_length_pos, &array_length_arg);
-                g_arg_info_load_type(&array_length_arg, &arg_type_info);
                 if (!gjs_value_from_g_argument(context, &length,
-                                               &arg_type_info,
+                                               &trampoline->args[array_length_pos].type_info,
                                                args[array_length_pos], TRUE))
                     goto out;
 
                 if (!gjs_value_from_explicit_array(context, &jsargs[n_jsargs++],
-                                                   &type_info, args[i], JSVAL_TO_INT(length)))
+                                                   &arg->type_info, args[i], JSVAL_TO_INT(length)))
                     goto out;
                 break;
             }
             case PARAM_NORMAL:
                 if (!gjs_value_from_g_argument(context,
                                                &jsargs[n_jsargs++],
-                                               &type_info,
+                                               &arg->type_info,
                                                args[i], FALSE))
                     goto out;
                 break;
@@ -260,21 +286,19 @@ gjs_callback_closure(ffi_cif *cif,
                               trampoline->js_function,
                               n_jsargs,
                               jsargs,
-                              &rval)) {
+                              &frame[n_args])) {
         goto out;
     }
+    rval = frame[n_args];
 
-    g_callable_info_load_return_type(trampoline->info, &ret_type);
-    ret_type_is_void = g_type_info_get_tag (&ret_type) == GI_TYPE_TAG_VOID;
-
-    if (n_outargs == 0 && !ret_type_is_void) {
+    if (n_outargs == 0 && !trampoline->ret_type_is_void) {
         GIArgument argument;
 
         /* non-void return value, no out args. Should
          * be a single return value. */
         if (!gjs_value_to_g_argument(context,
                                      rval,
-                                     &ret_type,
+                                     ret_type,
                                      "callback",
                                      GJS_ARGUMENT_RETURN_VALUE,
                                      GI_TRANSFER_NOTHING,
@@ -282,23 +306,19 @@ gjs_callback_closure(ffi_cif *cif,
                                      &argument))
             goto out;
 
-        set_return_ffi_arg_from_giargument(&ret_type,
+        set_return_ffi_arg_from_giargument(ret_type,
                                            result,
                                            &argument);
-    } else if (n_outargs == 1 && ret_type_is_void) {
+    } else if (n_outargs == 1 && trampoline->ret_type_is_void) {
         /* void return value, one out args. Should
          * be a single return value. */
         for (i = 0; i < n_args; i++) {
-            GIArgInfo arg_info;
-            GITypeInfo type_info;
-            g_callable_info_load_arg(trampoline->info, i, &arg_info);
-            if (g_arg_info_get_direction(&arg_info) == GI_DIRECTION_IN)
+            if (trampoline->args[i].direction == GI_DIRECTION_IN)
                 continue;
 
-            g_arg_info_load_type(&arg_info, &type_info);
             if (!gjs_value_to_g_argument(context,
                                          rval,
-                                         &type_info,
+                                         &trampoline->args[i].type_info,
                                          "callback",
                                          GJS_ARGUMENT_ARGUMENT,
                                          GI_TRANSFER_NOTHING,
@@ -314,7 +334,7 @@ gjs_callback_closure(ffi_cif *cif,
         /* more than one of a return value or an out argument.
          * Should be an array of output values. */
 
-        if (!ret_type_is_void) {
+        if (!trampoline->ret_type_is_void) {
             GIArgument argument;
 
             if (!JS_GetElement(context, JSVAL_TO_OBJECT(rval), elem_idx, &elem))
@@ -322,7 +342,7 @@ gjs_callback_closure(ffi_cif *cif,
 
             if (!gjs_value_to_g_argument(context,
                                          elem,
-                                         &ret_type,
+                                         ret_type,
                                          "callback",
                                          GJS_ARGUMENT_ARGUMENT,
                                          GI_TRANSFER_NOTHING,
@@ -330,7 +350,7 @@ gjs_callback_closure(ffi_cif *cif,
                                          &argument))
                 goto out;
 
-            set_return_ffi_arg_from_giargument(&ret_type,
+            set_return_ffi_arg_from_giargument(ret_type,
                                                result,
                                                &argument);
 
@@ -338,19 +358,15 @@ gjs_callback_closure(ffi_cif *cif,
         }
 
         for (i = 0; i < n_args; i++) {
-            GIArgInfo arg_info;
-            GITypeInfo type_info;
-            g_callable_info_load_arg(trampoline->info, i, &arg_info);
-            if (g_arg_info_get_direction(&arg_info) == GI_DIRECTION_IN)
+            if (trampoline->args[i].direction == GI_DIRECTION_IN)
                 continue;
 
-            g_arg_info_load_type(&arg_info, &type_info);
             if (!JS_GetElement(context, JSVAL_TO_OBJECT(rval), elem_idx, &elem))
                 goto out;
 
             if (!gjs_value_to_g_argument(context,
                                          elem,
-                                         &type_info,
+                                         &trampoline->args[i].type_info,
                                          "callback",
                                          GJS_ARGUMENT_ARGUMENT,
                                          GI_TRANSFER_NOTHING,
@@ -369,12 +385,22 @@ out:
         gjs_log_exception (context);
 
         /* Fill in the result with some hopefully neutral value */
-        g_callable_info_load_return_type(trampoline->info, &ret_type);
-        gjs_g_argument_init_default (context, &ret_type, result);
+        gjs_g_argument_init_default (context, ret_type, result);
     }
 
     if (trampoline->scope == GI_SCOPE_TYPE_ASYNC) {
-        completed_trampolines = g_slist_prepend(completed_trampolines, trampoline);
+        GjsWrapperState *state = gjs_runtime_get_wrapper_state(trampoline->runtime);
+
+        state->completed_trampolines = g_slist_prepend(state->completed_trampolines,
+                                                       trampoline);
+    }
+
+    gjs_runtime_pop_values(trampoline->runtime, frame, n_args + 1);
+
+    if (TRACE_ENABLED(CALLBACK_RETURN)) {
+        TRACE(GJS_CALLBACK_RETURN(trampoline,
+                                  (char *) g_base_info_get_name((GIBaseInfo *) trampoline->info),
+                                  success));
     }
 
     gjs_callback_trampoline_unref(trampoline);
@@ -474,6 +500,27 @@ gjs_callback_trampoline_new(JSContext      *context,
         }
     }
 
+    /* Marshalling plan for gjs_callback_closure() */
+    trampoline->n_args = n_args;
+    trampoline->n_outargs = 0;
+    trampoline->args = g_new(GjsCallbackArg, n_args);
+
+    for (i = 0; i < n_args; i++) {
+        GjsCallbackArg *arg = &trampoline->args[i];
+        GIArgInfo arg_info;
+
+        g_callable_info_load_arg(trampoline->info, i, &arg_info);
+        g_arg_info_load_type(&arg_info, &arg->type_info);
+        arg->direction = g_arg_info_get_direction(&arg_info);
+        arg->is_void = g_type_info_get_tag(&arg->type_info) == GI_TYPE_TAG_VOID;
+
+        if (!arg->is_void && arg->direction != GI_DIRECTION_IN)
+            trampoline->n_outargs++;
+    }
+
+    g_callable_info_load_return_type(trampoline->info, &trampoline->ret_type);
+    trampoline->ret_type_is_void = g_type_info_get_tag(&trampoline->ret_type) == GI_TYPE_TAG_VOID;
+
     trampoline->closure = g_callable_info_prepare_closure(callable_info, &trampoline->cif,
                                                           gjs_callback_closure, trampoline);
 
@@ -574,6 +621,20 @@ gjs_fill_method_instance (JSContext  *context,
     return JS_TRUE;
 }
 
+/* Strings that are only needed during the call are converted into the
+ * scratch memory of the runtime, which is released all at once after
+ * the call, rather than malloc()ed and freed one by one.
+ */
+static inline gboolean
+arg_in_scratch(GIDirection  direction,
+               GITransfer   transfer,
+               GITypeInfo  *type_info)
+{
+    return direction == GI_DIRECTION_IN &&
+        transfer == GI_TRANSFER_NOTHING &&
+        g_type_info_get_tag(type_info) == GI_TYPE_TAG_UTF8;
+}
+
 /*
  * This function can be called in 2 different ways. You can either use
  * it to create javascript objects by providing a @js_rval argument or
@@ -587,7 +648,8 @@ gjs_invoke_c_function(JSContext      *context,
                       unsigned        js_argc,
                       jsval          *js_argv,
                       jsval          *js_rval,
-                      GArgument      *r_value)
+                      GArgument      *r_value,
+                      GjsAsyncCall   *async_call)
 {
     /* These first four are arrays which hold argument pointers.
      * @in_arg_cvalues: C values which are passed on input (in or inout)
@@ -622,19 +684,22 @@ gjs_invoke_c_function(JSContext      *context,
     GITypeTag return_tag;
     jsval *return_values = NULL;
     guint8 next_rval = 0; /* index into return_values */
+    GjsWrapperState *state;
     GSList *iter;
+    gsize scratch_mark;
 
     /* Because we can't free a closure while we're in it, we defer
      * freeing until the next time a C function is invoked.  What
      * we should really do instead is queue it for a GC thread.
      */
-    if (completed_trampolines) {
-        for (iter = completed_trampolines; iter; iter = iter->next) {
+    state = gjs_runtime_get_wrapper_state(JS_GetRuntime(context));
+    if (state->completed_trampolines) {
+        for (iter = state->completed_trampolines; iter; iter = iter->next) {
             GjsCallbackTrampoline *trampoline = iter->data;
             gjs_callback_trampoline_unref(trampoline);
         }
-        g_slist_free(completed_trampolines);
-        completed_trampolines = NULL;
+        g_slist_free(state->completed_trampolines);
+        state->completed_trampolines = NULL;
     }
 
     is_method = g_callable_info_is_method(function->info);
@@ -653,10 +718,11 @@ gjs_invoke_c_function(JSContext      *context,
      * @js_argc is the number of arguments that were actually passed;
      * we allow this to be larger than @expected_js_argc for
      * convenience, and simply ignore the extra arguments. But we
-     * don't allow too few args, since that would break.
+     * don't allow too few args, since that would break, except for
+     * the callback of an @async_call, which is never read.
      */
 
-    if (js_argc < function->expected_js_argc) {
+    if (js_argc < function->expected_js_argc - (async_call ? 1 : 0)) {
         gjs_throw(context, "Too few arguments to %s %s.%s expected %d got %d",
                   is_method ? "method" : "function",
                   g_base_info_get_namespace( (GIBaseInfo*) function->info),
@@ -686,6 +752,8 @@ gjs_invoke_c_function(JSContext      *context,
         ++c_arg_pos;
     }
 
+    scratch_mark = gjs_runtime_scratch_mark(JS_GetRuntime(context));
+
     processed_c_args = c_arg_pos;
     for (gi_arg_pos = 0; gi_arg_pos < gi_argc; gi_arg_pos++, c_arg_pos++) {
         GIDirection direction;
@@ -762,8 +830,18 @@ gjs_invoke_c_function(JSContext      *context,
                 GIScopeType scope = g_arg_info_get_scope(&arg_info);
                 GjsCallbackTrampoline *trampoline;
                 ffi_closure *closure;
-                jsval value = js_argv[js_arg_pos];
+                jsval value;
+
+                if (async_call && gi_arg_pos == function->async_callback_pos) {
+                    gint closure_pos = g_arg_info_get_closure(&arg_info);
 
+                    if (closure_pos >= 0)
+                        in_arg_cvalues[is_method ? closure_pos + 1 : closure_pos].v_pointer = async_call;
+                    in_value->v_pointer = gjs_async_ready_callback;
+                    break;
+                }
+
+                value = js_argv[js_arg_pos];
                 if (JSVAL_IS_NULL(value) && g_arg_info_may_be_null(&arg_info)) {
                     closure = NULL;
                     trampoline = NULL;
@@ -853,8 +931,17 @@ gjs_invoke_c_function(JSContext      *context,
             case PARAM_NORMAL:
                 /* Ok, now just convert argument normally */
                 g_assert_cmpuint(js_arg_pos, <, js_argc);
-                if (!gjs_value_to_arg(context, js_argv[js_arg_pos], &arg_info,
-                                      in_value)) {
+                if (arg_in_scratch(direction, g_arg_info_get_ownership_transfer(&arg_info), &ainfo) &&
+                    JSVAL_IS_STRING(js_argv[js_arg_pos])) {
+                    char *utf8_str;
+
+                    if (!gjs_string_to_utf8_scratch(context, js_argv[js_arg_pos], &utf8_str)) {
+                        failed = TRUE;
+                        break;
+                    }
+                    in_value->v_pointer = utf8_str;
+                } else if (!gjs_value_to_arg(context, js_argv[js_arg_pos], &arg_info,
+                                             in_value)) {
                     failed = TRUE;
                     break;
                 }
@@ -909,8 +996,23 @@ gjs_invoke_c_function(JSContext      *context,
         return_value_p = &return_value.v_uint64;
     else
         return_value_p = &return_value.v_long;
+    if (TRACE_ENABLED(FUNCTION_INVOKE_ENTRY)) {
+        TRACE(GJS_FUNCTION_INVOKE_ENTRY((char *) g_base_info_get_namespace((GIBaseInfo *) function->info),
+                                        (char *) g_base_info_get_name((GIBaseInfo *) function->info)));
+    }
+
+    /* From now on the callback owns the async call, not our caller */
+    if (async_call)
+        async_call->started = TRUE;
+
     ffi_call(&(function->invoker.cif), function->invoker.native_address, return_value_p, ffi_arg_pointers);
 
+    if (TRACE_ENABLED(FUNCTION_INVOKE_RETURN)) {
+        TRACE(GJS_FUNCTION_INVOKE_RETURN((char *) g_base_info_get_namespace((GIBaseInfo *) function->info),
+                                         (char *) g_base_info_get_name((GIBaseInfo *) function->info),
+                                         local_error != NULL));
+    }
+
     /* Return value and out arguments are valid only if invocation doesn't
      * return error. In arguments need to be released always.
      */
@@ -1021,7 +1123,9 @@ release:
             }
             if (param_type == PARAM_CALLBACK) {
                 ffi_closure *closure = arg->v_pointer;
-                if (closure) {
+                if (async_call && gi_arg_pos == function->async_callback_pos) {
+                    arg->v_pointer = NULL;
+                } else if (closure) {
                     GjsCallbackTrampoline *trampoline = closure->user_data;
                     /* CallbackTrampolines are refcounted because for notified/async closures
                        it is possible to destroy it while in call, and therefore we cannot check
@@ -1052,7 +1156,8 @@ release:
                                                      arg)) {
                     postinvoke_release_failed = TRUE;
                 }
-            } else if (param_type == PARAM_NORMAL) {
+            } else if (param_type == PARAM_NORMAL &&
+                       !arg_in_scratch(direction, transfer, &arg_type_info)) {
                 if (!gjs_g_argument_release_in_arg(context,
                                                    transfer,
                                                    &arg_type_info,
@@ -1199,6 +1304,8 @@ release:
         }
     }
 
+    gjs_runtime_scratch_release(JS_GetRuntime(context), scratch_mark);
+
     if (!failed && did_throw_gerror) {
         gjs_throw_g_error(context, local_error);
         return JS_FALSE;
@@ -1209,6 +1316,324 @@ release:
     }
 }
 
+static Function *
+get_async_finish(JSContext *context,
+                 Function  *function)
+{
+    GIBaseInfo *container;
+    GIBaseInfo *finish_info = NULL;
+    const char *name;
+    char *finish_name;
+    Function *finish;
+
+    if (function->async_finish)
+        return function->async_finish;
+
+    /* foo_async() is paired with foo_finish(), g_bus_get() with
+     * g_bus_get_finish()
+     */
+    name = g_base_info_get_name((GIBaseInfo*) function->info);
+    if (g_str_has_suffix(name, "_async"))
+        finish_name = g_strdup_printf("%.*s_finish", (int) (strlen(name) - strlen("_async")), name);
+    else
+        finish_name = g_strdup_printf("%s_finish", name);
+
+    container = g_base_info_get_container((GIBaseInfo*) function->info);
+    if (container == NULL) {
+        finish_info = g_irepository_find_by_name(NULL,
+                                                 g_base_info_get_namespace((GIBaseInfo*) function->info),
+                                                 finish_name);
+        if (finish_info && g_base_info_get_type(finish_info) != GI_INFO_TYPE_FUNCTION)
+            g_clear_pointer(&finish_info, g_base_info_unref);
+    } else {
+        switch (g_base_info_get_type(container)) {
+        case GI_INFO_TYPE_OBJECT:
+            finish_info = g_object_info_find_method((GIObjectInfo*) container, finish_name);
+            break;
+        case GI_INFO_TYPE_INTERFACE:
+            finish_info = g_interface_info_find_method((GIInterfaceInfo*) container, finish_name);
+            break;
+        case GI_INFO_TYPE_STRUCT:
+            finish_info = g_struct_info_find_method((GIStructInfo*) container, finish_name);
+            break;
+        default:
+            break;
+        }
+    }
+    g_free(finish_name);
+
+    if (finish_info == NULL) {
+        /* don't look it up again, the callback is just required */
+        function->async_callback_pos = GJS_ARG_INDEX_INVALID;
+        return NULL;
+    }
+
+    finish = g_slice_new0(Function);
+    if (!init_cached_function_data(context, finish, 0, (GICallableInfo*) finish_info) ||
+        finish->expected_js_argc != 1) {
+        JS_ClearPendingException(context);
+        uninit_cached_function_data(finish);
+        g_slice_free(Function, finish);
+        finish = NULL;
+        function->async_callback_pos = GJS_ARG_INDEX_INVALID;
+    }
+    g_base_info_unref(finish_info);
+
+    function->async_finish = finish;
+    return finish;
+}
+
+static JSObject *
+new_promise(JSContext *context)
+{
+    jsval importer;
+    jsval module;
+    jsval constructor;
+
+    importer = gjs_get_global_slot(context, GJS_GLOBAL_SLOT_IMPORTS);
+    g_assert(JSVAL_IS_OBJECT(importer));
+
+    if (!gjs_object_get_property_const(context, JSVAL_TO_OBJECT(importer),
+                                       GJS_STRING_PROMISE_MODULE, &module) ||
+        !JSVAL_IS_OBJECT(module) ||
+        !gjs_object_get_property_const(context, JSVAL_TO_OBJECT(module),
+                                       GJS_STRING_PROMISE, &constructor) ||
+        !JSVAL_IS_OBJECT(constructor))
+        return NULL;
+
+    return JS_New(context, JSVAL_TO_OBJECT(constructor), 0, NULL);
+}
+
+static GjsAsyncCall *
+async_call_new(JSContext *context,
+               Function  *function,
+               JSObject  *callee,
+               JSObject  *this_obj,
+               JSObject  *promise)
+{
+    GjsAsyncCall *call;
+
+    call = g_slice_new0(GjsAsyncCall);
+    call->link.data = call;
+    call->runtime = JS_GetRuntime(context);
+    call->function = function;
+    call->callee = callee;
+    call->this_obj = this_obj;
+    call->promise = promise;
+
+    JS_AddObjectRoot(context, &call->callee);
+    JS_AddObjectRoot(context, &call->this_obj);
+    JS_AddObjectRoot(context, &call->promise);
+
+    g_queue_push_tail_link(&gjs_runtime_get_wrapper_state(call->runtime)->async_calls,
+                           &call->link);
+    return call;
+}
+
+/* Unlinks @call from whichever queue it's in before freeing it */
+static void
+async_call_free(JSContext    *context,
+                GjsAsyncCall *call)
+{
+    if (call->runtime) {
+        JS_RemoveObjectRoot(context, &call->callee);
+        JS_RemoveObjectRoot(context, &call->this_obj);
+        JS_RemoveObjectRoot(context, &call->promise);
+    }
+
+    if (call->result)
+        g_object_unref(call->result);
+    g_slice_free(GjsAsyncCall, call);
+}
+
+static void
+async_call_resolve(JSContext    *context,
+                   GjsAsyncCall *call)
+{
+    JSObject *result_obj;
+    GjsConstString method;
+    jsval *frame;
+
+    /* result, return value or error, putReturn() / putError() */
+    frame = gjs_runtime_push_values(call->runtime, 3);
+
+    result_obj = gjs_object_from_g_object(context, G_OBJECT(call->result));
+    if (result_obj != NULL) {
+        frame[0] = OBJECT_TO_JSVAL(result_obj);
+        if (gjs_invoke_c_function(context, call->function->async_finish,
+                                  call->this_obj, 1, &frame[0], &frame[1],
+                                  NULL, NULL))
+            method = GJS_STRING_PUT_RETURN;
+        else
+            method = GJS_STRING_PUT_ERROR;
+    } else {
+        method = GJS_STRING_PUT_ERROR;
+    }
+
+    if (method == GJS_STRING_PUT_ERROR) {
+        if (!JS_GetPendingException(context, &frame[1]))
+            frame[1] = JSVAL_VOID;
+        JS_ClearPendingException(context);
+    }
+
+    if (!gjs_object_get_property_const(context, call->promise, method, &frame[2]) ||
+        !JS_CallFunctionValue(context, call->promise, frame[2], 1, &frame[1], &frame[2]))
+        gjs_log_exception(context);
+
+    gjs_runtime_pop_values(call->runtime, frame, 3);
+}
+
+static gboolean
+flush_async_calls(gpointer user_data)
+{
+    JSRuntime *runtime = user_data;
+    JSContext *context;
+    GjsWrapperState *state;
+    GList *link;
+
+    context = gjs_runtime_get_context(runtime);
+    state = gjs_runtime_get_wrapper_state(runtime);
+
+    g_source_unref(state->async_flush_source);
+    state->async_flush_source = NULL;
+
+    JS_BeginRequest(context);
+    while ((link = g_queue_pop_head_link(&state->completed_async_calls))) {
+        GjsAsyncCall *call = link->data;
+
+        async_call_resolve(context, call);
+        async_call_free(context, call);
+    }
+    JS_EndRequest(context);
+
+    return FALSE;
+}
+
+/* The callback of all the _async() calls returning a promise. Calls
+ * completed during the same main loop iteration are resolved by
+ * a single idle, so that a burst of completions enters JS once.
+ */
+static void
+gjs_async_ready_callback(GObject      *source_object,
+                         GAsyncResult *result,
+                         gpointer      user_data)
+{
+    GjsAsyncCall *call = user_data;
+    GjsWrapperState *state;
+    GSource *source;
+
+    /* The runtime was destroyed while the operation was pending */
+    if (call->runtime == NULL) {
+        async_call_free(NULL, call);
+        return;
+    }
+
+    call->result = g_object_ref(result);
+
+    state = gjs_runtime_get_wrapper_state(call->runtime);
+    g_queue_unlink(&state->async_calls, &call->link);
+    g_queue_push_tail_link(&state->completed_async_calls, &call->link);
+
+    if (state->async_flush_source != NULL)
+        return;
+
+    source = g_idle_source_new();
+    g_source_set_callback(source, flush_async_calls, call->runtime, NULL);
+    g_source_attach(source, gjs_runtime_get_main_context(call->runtime));
+    state->async_flush_source = source;
+}
+
+/**
+ * gjs_function_drop_async_calls:
+ * @runtime: a #JSRuntime
+ *
+ * Drops the promises of the _async() calls of @runtime that are still
+ * pending, before its context is destroyed. Operations that complete
+ * afterwards are ignored.
+ */
+void
+gjs_function_drop_async_calls(JSRuntime *runtime)
+{
+    JSContext *context;
+    GjsWrapperState *state;
+    GList *link;
+
+    context = gjs_runtime_get_context(runtime);
+    state = gjs_runtime_get_wrapper_state(runtime);
+
+    if (state->async_flush_source) {
+        g_source_destroy(state->async_flush_source);
+        g_source_unref(state->async_flush_source);
+        state->async_flush_source = NULL;
+    }
+
+    JS_BeginRequest(context);
+    while ((link = g_queue_pop_head_link(&state->completed_async_calls)))
+        async_call_free(context, link->data);
+
+    while ((link = g_queue_pop_head_link(&state->async_calls))) {
+        GjsAsyncCall *call = link->data;
+
+        /* still owned by gjs_async_ready_callback() */
+        JS_RemoveObjectRoot(context, &call->callee);
+        JS_RemoveObjectRoot(context, &call->this_obj);
+        JS_RemoveObjectRoot(context, &call->promise);
+        call->runtime = NULL;
+    }
+    JS_EndRequest(context);
+}
+
+/* A callback for the last argument of an _async() can be left out,
+ * or passed as undefined, to get a promise instead.
+ */
+static gboolean
+wants_promise(Function *function,
+              unsigned  js_argc,
+              jsval    *js_argv)
+{
+    if (function->async_callback_pos == GJS_ARG_INDEX_INVALID)
+        return FALSE;
+
+    if (js_argc == (unsigned) function->expected_js_argc - 1)
+        return TRUE;
+
+    return js_argc >= function->expected_js_argc &&
+        JSVAL_IS_VOID(js_argv[function->expected_js_argc - 1]);
+}
+
+static JSBool
+function_call_async(JSContext *context,
+                    Function  *function,
+                    JSObject  *callee,
+                    JSObject  *object,
+                    unsigned   js_argc,
+                    jsval     *js_argv,
+                    jsval     *vp)
+{
+    GjsAsyncCall *call;
+    JSObject *promise;
+    jsval retval;
+    JSBool success;
+
+    promise = new_promise(context);
+    if (promise == NULL)
+        return JS_FALSE;
+
+    call = async_call_new(context, function, callee, object, promise);
+    success = gjs_invoke_c_function(context, function, object, js_argc, js_argv,
+                                    &retval, NULL, call);
+    if (!call->started) {
+        g_queue_unlink(&gjs_runtime_get_wrapper_state(call->runtime)->async_calls,
+                       &call->link);
+        async_call_free(context, call);
+    }
+
+    if (success)
+        JS_SET_RVAL(context, vp, OBJECT_TO_JSVAL(promise));
+
+    return success;
+}
+
 static JSBool
 function_call(JSContext *context,
               unsigned   js_argc,
@@ -1230,7 +1655,11 @@ function_call(JSContext *context,
         return JS_TRUE; /* we are the prototype, or have the wrong class */
 
 
-    success = gjs_invoke_c_function(context, priv, object, js_argc, js_argv, &retval, NULL);
+    if (wants_promise(priv, js_argc, js_argv) &&
+        get_async_finish(context, priv) != NULL)
+        return function_call_async(context, priv, callee, object, js_argc, js_argv, vp);
+
+    success = gjs_invoke_c_function(context, priv, object, js_argc, js_argv, &retval, NULL, NULL);
     if (success)
         JS_SET_RVAL(context, vp, retval);
 
@@ -1249,6 +1678,10 @@ uninit_cached_function_data (Function *function)
         g_base_info_unref( (GIBaseInfo*) function->info);
     if (function->param_types)
         g_free(function->param_types);
+    if (function->async_finish) {
+        uninit_cached_function_data(function->async_finish);
+        g_slice_free(Function, function->async_finish);
+    }
 
     g_function_invoker_destroy(&function->invoker);
 }
@@ -1430,6 +1863,7 @@ init_cached_function_data (JSContext      *context,
     GIInfoType info_type;
 
     info_type = g_base_info_get_type((GIBaseInfo *)info);
+    function->async_callback_pos = GJS_ARG_INDEX_INVALID;
 
     if (info_type == GI_INFO_TYPE_FUNCTION) {
         if (!g_function_info_prep_invoker((GIFunctionInfo *)info,
@@ -1501,6 +1935,13 @@ init_cached_function_data (JSContext      *context,
                     function->param_types[i] = PARAM_CALLBACK;
                     function->expected_js_argc += 1;
 
+                    if (info_type == GI_INFO_TYPE_FUNCTION &&
+                        strcmp(g_base_info_get_name(interface_info), "AsyncReadyCallback") == 0 &&
+                        strcmp(g_base_info_get_namespace(interface_info), "Gio") == 0)
+                        function->async_callback_pos = i;
+                    else
+                        function->async_callback_pos = GJS_ARG_INDEX_INVALID;
+
                     destroy = g_arg_info_get_destroy(&arg_info);
                     closure = g_arg_info_get_closure(&arg_info);
 
@@ -1551,8 +1992,13 @@ init_cached_function_data (JSContext      *context,
 
         if (function->param_types[i] == PARAM_NORMAL ||
             function->param_types[i] == PARAM_ARRAY) {
-            if (direction == GI_DIRECTION_IN || direction == GI_DIRECTION_INOUT)
+            if (direction == GI_DIRECTION_IN || direction == GI_DIRECTION_INOUT) {
+                /* The callback of an _async() can only be left out
+                 * if it is the last JS argument
+                 */
+                function->async_callback_pos = GJS_ARG_INDEX_INVALID;
                 function->expected_js_argc += 1;
+            }
             if (direction == GI_DIRECTION_OUT || direction == GI_DIRECTION_INOUT)
                 function->js_out_argc += 1;
         }
@@ -1704,7 +2150,7 @@ gjs_invoke_c_function_uncached (JSContext      *context,
   if (!init_cached_function_data (context, &function, 0, info))
     return JS_FALSE;
 
-  result = gjs_invoke_c_function (context, &function, obj, argc, argv, rval, NULL);
+  result = gjs_invoke_c_function (context, &function, obj, argc, argv, rval, NULL, NULL);
   uninit_cached_function_data (&function);
   return result;
 }
@@ -1721,5 +2167,5 @@ gjs_invoke_constructor_from_c (JSContext      *context,
 
     priv = priv_from_js(context, constructor);
 
-    return gjs_invoke_c_function(context, priv, obj, argc, argv, NULL, rvalue);
+    return gjs_invoke_c_function(context, priv, obj, argc, argv, NULL, rvalue, NULL);
 }
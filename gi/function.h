@@ -40,6 +40,15 @@ typedef enum {
     PARAM_CALLBACK
 } GjsParamType;
 
+/* Argument and return types of a callback are loaded once, when the
+ * trampoline is created, rather than on every invocation.
+ */
+typedef struct {
+    GITypeInfo type_info;
+    GIDirection direction;
+    gboolean is_void;
+} GjsCallbackArg;
+
 typedef struct {
     gint ref_count;
     JSRuntime *runtime;
@@ -50,6 +59,12 @@ typedef struct {
     GIScopeType scope;
     gboolean is_vfunc;
     GjsParamType *param_types;
+
+    gint n_args;
+    gint n_outargs;
+    GjsCallbackArg *args;
+    GITypeInfo ret_type;
+    gboolean ret_type_is_void;
 } GjsCallbackTrampoline;
 
 GjsCallbackTrampoline* gjs_callback_trampoline_new(JSContext      *context,
@@ -80,6 +95,8 @@ JSBool    gjs_invoke_constructor_from_c (JSContext      *context,
                                          jsval          *argv,
                                          GArgument      *rvalue);
 
+void     gjs_function_drop_async_calls (JSRuntime *runtime);
+
 void     gjs_init_cinvoke_profiling (void);
 
 G_END_DECLS
@@ -38,6 +38,7 @@
 #include "proxyutils.h"
 
 #include <gjs/gjs.h>
+#include <gjs/runtime.h>
 
 #include <util/log.h>
 
@@ -88,43 +89,36 @@ typedef struct {
     struct _Fundamental          *prototype;
 } FundamentalInstance;
 
-static GHashTable *fundamental_to_js_object = NULL;
-
 static struct JSClass gjs_fundamental_instance_class;
 
 GJS_DEFINE_PRIV_FROM_JS(FundamentalInstance, gjs_fundamental_instance_class)
 
-static GHashTable *
-_ensure_mapping_table(void)
+static inline GHashTable *
+_get_mapping_table(JSRuntime *runtime)
 {
-    if (G_UNLIKELY(fundamental_to_js_object == NULL))
-        fundamental_to_js_object = g_hash_table_new_full(g_direct_hash,
-                                                         g_direct_equal,
-                                                         NULL,
-                                                         NULL);
-    return fundamental_to_js_object;
+    return gjs_runtime_get_wrapper_state(runtime)->fundamental_objects;
 }
 
 static void
-_fundamental_add_object(void *native_object, JSObject *js_object)
+_fundamental_add_object(JSRuntime *runtime, void *native_object, JSObject *js_object)
 {
-    GHashTable *table = _ensure_mapping_table();
+    GHashTable *table = _get_mapping_table(runtime);
 
     g_hash_table_insert(table, native_object, js_object);
 }
 
 static void
-_fundamental_remove_object(void *native_object)
+_fundamental_remove_object(JSRuntime *runtime, void *native_object)
 {
-    GHashTable *table = _ensure_mapping_table();
+    GHashTable *table = _get_mapping_table(runtime);
 
     g_hash_table_remove(table, native_object);
 }
 
 static JSObject *
-_fundamental_lookup_object(void *native_object)
+_fundamental_lookup_object(JSRuntime *runtime, void *native_object)
 {
-    GHashTable *table = _ensure_mapping_table();
+    GHashTable *table = _get_mapping_table(runtime);
 
     return g_hash_table_lookup(table, native_object);
 }
@@ -179,8 +173,8 @@ associate_js_instance_to_fundamental(JSContext *context,
     priv = priv_from_js(context, object);
     priv->gfundamental = gfundamental;
 
-    g_assert(_fundamental_lookup_object(gfundamental) == NULL);
-    _fundamental_add_object(gfundamental, object);
+    g_assert(_fundamental_lookup_object(JS_GetRuntime(context), gfundamental) == NULL);
+    _fundamental_add_object(JS_GetRuntime(context), gfundamental, object);
 
     gjs_debug_lifecycle(GJS_DEBUG_GFUNDAMENTAL,
                         "associated JSObject %p with fundamental %p",
@@ -507,7 +501,7 @@ fundamental_finalize(JSFreeOp  *fop,
 
     if (priv->prototype) {
         if (priv->gfundamental) {
-            _fundamental_remove_object(priv->gfundamental);
+            _fundamental_remove_object(fop->runtime, priv->gfundamental);
             priv->prototype->unref_function(priv->gfundamental);
             priv->gfundamental = NULL;
         }
@@ -788,9 +782,11 @@ gjs_object_from_g_fundamental(JSContext    *context,
     if (gfundamental == NULL)
         return NULL;
 
-    object = _fundamental_lookup_object(gfundamental);
-    if (object)
+    object = _fundamental_lookup_object(JS_GetRuntime(context), gfundamental);
+    if (object) {
+        gjs_gc_read_barrier(object);
         return object;
+    }
 
     gjs_debug_marshal(GJS_DEBUG_GFUNDAMENTAL,
                       "Wrapping fundamental %s.%s %p with JSObject",
@@ -0,0 +1,782 @@
+/* -*- mode: C; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2013  Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include <gio/gio.h>
+
+#include <gjs/gjs-module.h>
+#include <gjs/compat.h>
+#include <gjs/runtime.h>
+#include "boxed.h"
+#include "closure.h"
+#include "gerror.h"
+#include "gvariant.h"
+#include "object.h"
+#include "gdbus.h"
+
+#include <libgjs-private/gjs-gdbus-wrapper.h>
+#include <util/log.h>
+
+/* Native halves of the D-Bus proxy wrappers and exported objects in
+ * the Gio overrides.
+ *
+ * The proxy wrappers compile the in signature of every method into a
+ * GLib.VariantType once, so that a call only packs its arguments into
+ * a single GVariant and deep-unpacks the reply, without going through
+ * GI for GDBusProxy itself.
+ *
+ * Exported objects skip the handle-* signals of GjsDBusImplementation:
+ * incoming calls are dispatched to the wrapped JS object directly, with
+ * the out signature of every method compiled when it is wrapped.
+ */
+
+static JSBool
+prepare_proxy_call(JSContext     *context,
+                   JSObject      *proxy_obj,
+                   JSObject      *type_obj,
+                   JSObject      *args_obj,
+                   JSObject      *cancellable_obj,
+                   GDBusProxy   **proxy_p,
+                   GVariant     **parameters_p,
+                   GCancellable **cancellable_p)
+{
+    const GVariantType *in_type;
+    GVariant *parameters;
+
+    if (!gjs_typecheck_object(context, proxy_obj, G_TYPE_DBUS_PROXY, JS_TRUE))
+        return JS_FALSE;
+
+    if (!gjs_typecheck_boxed(context, type_obj, NULL, G_TYPE_VARIANT_TYPE, JS_TRUE))
+        return JS_FALSE;
+
+    in_type = gjs_c_struct_from_boxed(context, type_obj);
+    if (!g_variant_type_is_tuple(in_type) ||
+        !g_variant_type_is_definite(in_type)) {
+        gjs_throw(context, "D-Bus method arguments must have a tuple type, not '%s'",
+                  g_variant_type_peek_string(in_type));
+        return JS_FALSE;
+    }
+
+    if (cancellable_obj != NULL) {
+        if (!gjs_typecheck_object(context, cancellable_obj, G_TYPE_CANCELLABLE, JS_TRUE))
+            return JS_FALSE;
+        *cancellable_p = G_CANCELLABLE(gjs_g_object_from_object(context, cancellable_obj));
+    } else {
+        *cancellable_p = NULL;
+    }
+
+    /* Extra elements in args (callback, flags...) are ignored */
+    parameters = gjs_variant_pack(context, in_type, OBJECT_TO_JSVAL(args_obj));
+    if (parameters == NULL)
+        return JS_FALSE;
+
+    *proxy_p = G_DBUS_PROXY(gjs_g_object_from_object(context, proxy_obj));
+    *parameters_p = parameters;
+    return JS_TRUE;
+}
+
+static JSBool
+gjs_dbus_proxy_call_sync(JSContext *context,
+                         unsigned   argc,
+                         jsval     *vp)
+{
+    jsval *argv = JS_ARGV(context, vp);
+    JSObject *proxy_obj, *type_obj, *args_obj, *cancellable_obj;
+    char *method_name;
+    guint32 flags;
+    GDBusProxy *proxy;
+    GVariant *parameters, *reply;
+    GCancellable *cancellable;
+    GError *error = NULL;
+    jsval retval;
+    JSBool ret = JS_FALSE;
+
+    if (!gjs_parse_args(context, "dbus_proxy_call_sync", "osoou?o", argc, argv,
+                        "proxy", &proxy_obj,
+                        "method", &method_name,
+                        "inType", &type_obj,
+                        "args", &args_obj,
+                        "flags", &flags,
+                        "cancellable", &cancellable_obj))
+        return JS_FALSE;
+
+    if (!prepare_proxy_call(context, proxy_obj, type_obj, args_obj, cancellable_obj,
+                            &proxy, &parameters, &cancellable))
+        goto out;
+
+    /* consumes the floating reference on parameters */
+    reply = g_dbus_proxy_call_sync(proxy, method_name, parameters,
+                                   (GDBusCallFlags) flags, -1,
+                                   cancellable, &error);
+    if (reply == NULL) {
+        gjs_throw_g_error(context, error);
+        goto out;
+    }
+
+    ret = gjs_variant_unpack(context, reply, TRUE, &retval);
+    g_variant_unref(reply);
+
+    if (ret)
+        JS_SET_RVAL(context, vp, retval);
+
+ out:
+    g_free(method_name);
+    return ret;
+}
+
+static void
+proxy_call_ready(GObject      *source,
+                 GAsyncResult *result,
+                 gpointer      user_data)
+{
+    GClosure *closure = user_data;
+    JSRuntime *runtime;
+    JSContext *context;
+    GVariant *reply;
+    GError *error = NULL;
+    jsval *argv;
+
+    reply = g_dbus_proxy_call_finish(G_DBUS_PROXY(source), result, &error);
+
+    /* The context went away while the call was in flight */
+    if (!gjs_closure_is_valid(closure))
+        goto out;
+
+    runtime = gjs_closure_get_runtime(closure);
+    context = gjs_runtime_get_context(runtime);
+    JS_BeginRequest(context);
+
+    /* the reply, the error and the return value */
+    argv = gjs_runtime_push_values(runtime, 3);
+
+    if (reply != NULL) {
+        if (!gjs_variant_unpack(context, reply, TRUE, &argv[0])) {
+            gjs_log_exception(context);
+            goto pop;
+        }
+        argv[1] = JSVAL_NULL;
+    } else {
+        JSObject *err_obj;
+
+        err_obj = gjs_error_from_gerror(context, error, TRUE);
+        argv[0] = JSVAL_NULL;
+        argv[1] = err_obj ? OBJECT_TO_JSVAL(err_obj) : JSVAL_NULL;
+    }
+
+    gjs_closure_invoke(closure, 2, argv, &argv[2]);
+
+ pop:
+    gjs_runtime_pop_values(runtime, argv, 3);
+    JS_EndRequest(context);
+
+ out:
+    if (reply != NULL)
+        g_variant_unref(reply);
+    g_clear_error(&error);
+
+    g_closure_invalidate(closure);
+    g_closure_unref(closure);
+}
+
+static JSBool
+gjs_dbus_proxy_call(JSContext *context,
+                    unsigned   argc,
+                    jsval     *vp)
+{
+    jsval *argv = JS_ARGV(context, vp);
+    JSObject *proxy_obj, *type_obj, *args_obj, *cancellable_obj, *callback_obj;
+    char *method_name;
+    guint32 flags;
+    GDBusProxy *proxy;
+    GVariant *parameters;
+    GCancellable *cancellable;
+    GClosure *closure;
+    JSBool ret = JS_FALSE;
+
+    if (!gjs_parse_args(context, "dbus_proxy_call", "osoou?oo", argc, argv,
+                        "proxy", &proxy_obj,
+                        "method", &method_name,
+                        "inType", &type_obj,
+                        "args", &args_obj,
+                        "flags", &flags,
+                        "cancellable", &cancellable_obj,
+                        "callback", &callback_obj))
+        return JS_FALSE;
+
+    if (!JS_ObjectIsFunction(context, callback_obj)) {
+        gjs_throw(context, "dbus_proxy_call: callback is not a function");
+        goto out;
+    }
+
+    if (!prepare_proxy_call(context, proxy_obj, type_obj, args_obj, cancellable_obj,
+                            &proxy, &parameters, &cancellable))
+        goto out;
+
+    closure = gjs_closure_new(context, callback_obj, "D-Bus method reply", TRUE);
+    g_closure_ref(closure);
+    g_closure_sink(closure);
+
+    g_dbus_proxy_call(proxy, method_name, parameters,
+                      (GDBusCallFlags) flags, -1, cancellable,
+                      proxy_call_ready, closure);
+
+    JS_SET_RVAL(context, vp, JSVAL_VOID);
+    ret = JS_TRUE;
+
+ out:
+    g_free(method_name);
+    return ret;
+}
+
+/* The wrapped object is stored on the JS wrapper of the implementation,
+ * like the signal handlers it replaces were; the wrapper stays alive as
+ * long as the object is exported.
+ */
+#define TARGET_PROPERTY "__gjsDBusTarget"
+
+typedef struct {
+    GVariantType *out_type;
+    gsize         n_out;
+} MethodPlan;
+
+typedef struct {
+    GList                  link; /* in the dbus_implementations of the runtime */
+    JSRuntime             *runtime; /* NULL once the context is gone */
+    GjsDBusImplementation *impl;
+    GHashTable            *methods; /* method name -> MethodPlan */
+} ImplementationData;
+
+static void
+method_plan_free(gpointer data)
+{
+    MethodPlan *plan = data;
+
+    g_variant_type_free(plan->out_type);
+    g_slice_free(MethodPlan, plan);
+}
+
+static void
+implementation_data_free(gpointer data)
+{
+    ImplementationData *impl_data = data;
+
+    if (impl_data->runtime != NULL) {
+        GjsWrapperState *state = gjs_runtime_get_wrapper_state(impl_data->runtime);
+
+        g_queue_unlink(&state->dbus_implementations, &impl_data->link);
+    }
+
+    g_hash_table_unref(impl_data->methods);
+    g_slice_free(ImplementationData, impl_data);
+}
+
+static JSObject *
+get_target(JSContext             *context,
+           GjsDBusImplementation *impl)
+{
+    JSObject *wrapper;
+    jsval value;
+
+    wrapper = gjs_object_from_g_object(context, G_OBJECT(impl));
+    if (wrapper == NULL ||
+        !JS_GetProperty(context, wrapper, TARGET_PROPERTY, &value) ||
+        !JSVAL_IS_OBJECT(value) || JSVAL_IS_NULL(value))
+        return NULL;
+
+    return JSVAL_TO_OBJECT(value);
+}
+
+static gboolean
+get_handler(JSContext  *context,
+            JSObject   *target,
+            const char *name,
+            jsval      *handler_p)
+{
+    if (!JS_GetProperty(context, target, name, handler_p)) {
+        gjs_log_exception(context);
+        return FALSE;
+    }
+
+    return JSVAL_IS_OBJECT(*handler_p) && !JSVAL_IS_NULL(*handler_p) &&
+        JS_ObjectIsCallable(context, JSVAL_TO_OBJECT(*handler_p));
+}
+
+static char *
+get_string_property(JSContext  *context,
+                    JSObject   *obj,
+                    const char *name)
+{
+    jsval value;
+    JSString *str;
+    char *ret;
+
+    if (!JS_GetProperty(context, obj, name, &value) ||
+        JSVAL_IS_VOID(value) ||
+        (str = JS_ValueToString(context, value)) == NULL ||
+        !gjs_string_to_utf8(context, STRING_TO_JSVAL(str), &ret)) {
+        JS_ClearPendingException(context);
+        return NULL;
+    }
+
+    return ret;
+}
+
+/* Turns the exception thrown by a method handler into a D-Bus error */
+static void
+return_exception(JSContext             *context,
+                 GDBusMethodInvocation *invocation)
+{
+    jsval exc;
+    JSObject *exc_obj;
+    char *name = NULL, *message = NULL, *error_name;
+
+    if (!JS_GetPendingException(context, &exc)) {
+        g_dbus_method_invocation_return_dbus_error(invocation,
+                                                   "org.gnome.gjs.JSError.Error",
+                                                   "Method handler failed");
+        return;
+    }
+
+    JS_ClearPendingException(context);
+
+    if (JSVAL_IS_OBJECT(exc) && !JSVAL_IS_NULL(exc)) {
+        exc_obj = JSVAL_TO_OBJECT(exc);
+
+        if (gjs_typecheck_gerror(context, exc_obj, JS_FALSE)) {
+            GError *error = gjs_gerror_from_error(context, exc_obj);
+
+            if (error != NULL) {
+                g_dbus_method_invocation_return_gerror(invocation, error);
+                return;
+            }
+            JS_ClearPendingException(context);
+        }
+
+        name = get_string_property(context, exc_obj, "name");
+        message = get_string_property(context, exc_obj, "message");
+    } else {
+        JSString *str = JS_ValueToString(context, exc);
+
+        if (str == NULL ||
+            !gjs_string_to_utf8(context, STRING_TO_JSVAL(str), &message))
+            JS_ClearPendingException(context);
+    }
+
+    if (name == NULL)
+        name = g_strdup("Error");
+
+    if (strchr(name, '.') == NULL) {
+        /* likely to be a normal JS error */
+        error_name = g_strconcat("org.gnome.gjs.JSError.", name, NULL);
+    } else {
+        error_name = name;
+        name = NULL;
+    }
+
+    g_dbus_method_invocation_return_dbus_error(invocation, error_name,
+                                               message ? message : "");
+
+    g_free(error_name);
+    g_free(name);
+    g_free(message);
+}
+
+static void
+return_value(JSContext             *context,
+             ImplementationData    *data,
+             const char            *method_name,
+             GDBusMethodInvocation *invocation,
+             jsval                  retval)
+{
+    MethodPlan *plan;
+    GVariant *variant;
+
+    if (JSVAL_IS_VOID(retval)) {
+        /* undefined (no return value) is the empty tuple */
+        g_dbus_method_invocation_return_value(invocation, NULL);
+        return;
+    }
+
+    if (JSVAL_IS_OBJECT(retval) && !JSVAL_IS_NULL(retval) &&
+        gjs_typecheck_boxed(context, JSVAL_TO_OBJECT(retval), NULL,
+                            G_TYPE_VARIANT, JS_FALSE)) {
+        variant = gjs_c_struct_from_boxed(context, JSVAL_TO_OBJECT(retval));
+        g_dbus_method_invocation_return_value(invocation, variant);
+        return;
+    }
+
+    plan = g_hash_table_lookup(data->methods, method_name);
+    variant = NULL;
+
+    if (plan != NULL) {
+        if (plan->n_out == 1) {
+            /* if one arg, we don't require the handler to wrap it
+             * into an Array */
+            GVariant *child;
+
+            child = gjs_variant_pack(context, g_variant_type_first(plan->out_type),
+                                     retval);
+            if (child != NULL)
+                variant = g_variant_new_tuple(&child, 1);
+        } else {
+            variant = gjs_variant_pack(context, plan->out_type, retval);
+        }
+    }
+
+    if (variant == NULL) {
+        /* if we don't do this, the other side will never see a reply */
+        JS_ClearPendingException(context);
+        g_dbus_method_invocation_return_dbus_error(invocation,
+                                                   "org.gnome.gjs.JSError.ValueError",
+                                                   "Service implementation returned an incorrect value type");
+        return;
+    }
+
+    g_dbus_method_invocation_return_value(invocation, variant);
+}
+
+static void
+call_sync_handler(JSContext             *context,
+                  ImplementationData    *data,
+                  JSObject              *target,
+                  jsval                  handler,
+                  const char            *method_name,
+                  GVariant              *parameters,
+                  GDBusMethodInvocation *invocation)
+{
+    gsize n_args, i;
+    jsval *argv;
+
+    /* The in arguments become the arguments of the handler, without
+     * going through an intermediate array */
+    n_args = g_variant_n_children(parameters);
+    argv = gjs_runtime_push_values(data->runtime, n_args + 1);
+
+    for (i = 0; i < n_args; i++) {
+        GVariant *child = g_variant_get_child_value(parameters, i);
+        JSBool ok;
+
+        ok = gjs_variant_unpack(context, child, TRUE, &argv[i]);
+        g_variant_unref(child);
+
+        if (!ok) {
+            gjs_log_exception(context);
+            g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+                                                  G_DBUS_ERROR_INVALID_ARGS,
+                                                  "Could not unpack the arguments of %s",
+                                                  method_name);
+            goto out;
+        }
+    }
+
+    if (!gjs_call_function_value(context, target, handler,
+                                 n_args, argv, &argv[n_args]))
+        return_exception(context, invocation);
+    else
+        return_value(context, data, method_name, invocation, argv[n_args]);
+
+ out:
+    gjs_runtime_pop_values(data->runtime, argv, n_args + 1);
+}
+
+static void
+call_async_handler(JSContext             *context,
+                   ImplementationData    *data,
+                   JSObject              *target,
+                   jsval                  handler,
+                   GVariant              *parameters,
+                   GDBusMethodInvocation *invocation)
+{
+    JSObject *invocation_obj;
+    jsval *argv;
+
+    /* the unpacked parameters, the invocation and the return value */
+    argv = gjs_runtime_push_values(data->runtime, 3);
+
+    if (!gjs_variant_unpack(context, parameters, TRUE, &argv[0]))
+        goto out;
+
+    invocation_obj = gjs_object_from_g_object(context, G_OBJECT(invocation));
+    if (invocation_obj == NULL)
+        goto out;
+    argv[1] = OBJECT_TO_JSVAL(invocation_obj);
+
+    gjs_call_function_value(context, target, handler, 2, argv, &argv[2]);
+
+ out:
+    gjs_log_exception(context);
+    gjs_runtime_pop_values(data->runtime, argv, 3);
+}
+
+static void
+implementation_method_call(GjsDBusImplementation *impl,
+                           const char            *method_name,
+                           GVariant              *parameters,
+                           GDBusMethodInvocation *invocation,
+                           gpointer               user_data)
+{
+    ImplementationData *data = user_data;
+    JSContext *context;
+    JSObject *target;
+    jsval handler;
+    char *async_name;
+
+    if (data->runtime == NULL) {
+        g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+                                              G_DBUS_ERROR_UNKNOWN_METHOD,
+                                              "Method %s is not implemented",
+                                              method_name);
+        return;
+    }
+
+    context = gjs_runtime_get_context(data->runtime);
+    JS_BeginRequest(context);
+
+    target = get_target(context, impl);
+    if (target == NULL) {
+        g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+                                              G_DBUS_ERROR_UNKNOWN_METHOD,
+                                              "Method %s is not implemented",
+                                              method_name);
+        goto out;
+    }
+
+    /* prefer a sync version if available */
+    if (get_handler(context, target, method_name, &handler)) {
+        call_sync_handler(context, data, target, handler, method_name,
+                          parameters, invocation);
+        goto out;
+    }
+
+    async_name = g_strconcat(method_name, "Async", NULL);
+    if (get_handler(context, target, async_name, &handler)) {
+        call_async_handler(context, data, target, handler,
+                           parameters, invocation);
+    } else {
+        gjs_debug(GJS_DEBUG_GOBJECT,
+                  "Missing handler for D-Bus method %s", method_name);
+        g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+                                              G_DBUS_ERROR_UNKNOWN_METHOD,
+                                              "Method %s is not implemented",
+                                              method_name);
+    }
+    g_free(async_name);
+
+ out:
+    JS_EndRequest(context);
+}
+
+static GVariant *
+implementation_get_property(GjsDBusImplementation *impl,
+                            const char            *property_name,
+                            gpointer               user_data)
+{
+    ImplementationData *data = user_data;
+    GDBusInterfaceInfo *info;
+    GDBusPropertyInfo *prop_info;
+    JSContext *context;
+    JSObject *target;
+    GVariant *variant = NULL;
+    jsval value;
+
+    info = g_dbus_interface_skeleton_get_info(G_DBUS_INTERFACE_SKELETON(impl));
+    prop_info = g_dbus_interface_info_lookup_property(info, property_name);
+    if (prop_info == NULL || data->runtime == NULL)
+        return NULL;
+
+    context = gjs_runtime_get_context(data->runtime);
+    JS_BeginRequest(context);
+
+    target = get_target(context, impl);
+    if (target == NULL)
+        goto out;
+
+    if (!JS_GetProperty(context, target, property_name, &value)) {
+        gjs_log_exception(context);
+        goto out;
+    }
+
+    if (JSVAL_IS_VOID(value) || JSVAL_IS_NULL(value))
+        goto out;
+
+    variant = gjs_variant_pack(context, G_VARIANT_TYPE(prop_info->signature), value);
+    if (variant == NULL)
+        gjs_log_exception(context);
+
+ out:
+    JS_EndRequest(context);
+    return variant;
+}
+
+static void
+implementation_set_property(GjsDBusImplementation *impl,
+                            const char            *property_name,
+                            GVariant              *value,
+                            gpointer               user_data)
+{
+    ImplementationData *data = user_data;
+    JSContext *context;
+    JSObject *target;
+    jsval *js_value;
+
+    if (data->runtime == NULL)
+        return;
+
+    context = gjs_runtime_get_context(data->runtime);
+    JS_BeginRequest(context);
+
+    target = get_target(context, impl);
+    if (target != NULL) {
+        js_value = gjs_runtime_push_values(data->runtime, 1);
+
+        if (!gjs_variant_unpack(context, value, TRUE, js_value) ||
+            !JS_SetProperty(context, target, property_name, js_value))
+            gjs_log_exception(context);
+
+        gjs_runtime_pop_values(data->runtime, js_value, 1);
+    }
+
+    JS_EndRequest(context);
+}
+
+static const GjsDBusImplementationHandlers implementation_handlers = {
+    implementation_method_call,
+    implementation_get_property,
+    implementation_set_property
+};
+
+static JSBool
+gjs_dbus_implementation_set_target(JSContext *context,
+                                   unsigned   argc,
+                                   jsval     *vp)
+{
+    jsval *argv = JS_ARGV(context, vp);
+    JSObject *impl_obj, *target;
+    GjsDBusImplementation *impl;
+    GDBusInterfaceInfo *info;
+    ImplementationData *data;
+    guint i;
+
+    if (!gjs_parse_args(context, "dbus_implementation_set_target", "oo", argc, argv,
+                        "implementation", &impl_obj,
+                        "target", &target))
+        return JS_FALSE;
+
+    if (!gjs_typecheck_object(context, impl_obj, GJS_TYPE_DBUS_IMPLEMENTATION, JS_TRUE))
+        return JS_FALSE;
+
+    impl = GJS_DBUS_IMPLEMENTATION(gjs_g_object_from_object(context, impl_obj));
+
+    if (!JS_DefineProperty(context, impl_obj, TARGET_PROPERTY,
+                           OBJECT_TO_JSVAL(target), NULL, NULL,
+                           JSPROP_PERMANENT | JSPROP_READONLY))
+        return JS_FALSE;
+
+    data = g_slice_new0(ImplementationData);
+    data->link.data = data;
+    data->runtime = JS_GetRuntime(context);
+    data->impl = impl;
+    data->methods = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                          NULL, method_plan_free);
+
+    info = g_dbus_interface_skeleton_get_info(G_DBUS_INTERFACE_SKELETON(impl));
+    for (i = 0; info->methods != NULL && info->methods[i] != NULL; i++) {
+        GDBusMethodInfo *method = info->methods[i];
+        MethodPlan *plan;
+        GString *signature;
+        guint j;
+
+        signature = g_string_new("(");
+        for (j = 0; method->out_args != NULL && method->out_args[j] != NULL; j++)
+            g_string_append(signature, method->out_args[j]->signature);
+        g_string_append_c(signature, ')');
+
+        plan = g_slice_new(MethodPlan);
+        plan->out_type = g_variant_type_new(signature->str);
+        plan->n_out = j;
+        g_string_free(signature, TRUE);
+
+        /* the names are owned by the interface info, which outlives us */
+        g_hash_table_insert(data->methods, method->name, plan);
+    }
+
+    gjs_dbus_implementation_set_handlers(impl, &implementation_handlers,
+                                         data, implementation_data_free);
+    g_queue_push_tail_link(&gjs_runtime_get_wrapper_state(data->runtime)->dbus_implementations,
+                           &data->link);
+
+    JS_SET_RVAL(context, vp, JSVAL_VOID);
+    return JS_TRUE;
+}
+
+/**
+ * gjs_dbus_drop_implementations:
+ * @runtime: a #JSRuntime
+ *
+ * Unexports the D-Bus objects implemented in @runtime, before its
+ * context is destroyed. Calls that were already dispatched get an
+ * error reply.
+ */
+void
+gjs_dbus_drop_implementations(JSRuntime *runtime)
+{
+    GjsWrapperState *state;
+    GList *link;
+
+    state = gjs_runtime_get_wrapper_state(runtime);
+
+    while ((link = g_queue_pop_head_link(&state->dbus_implementations))) {
+        ImplementationData *data = link->data;
+
+        data->runtime = NULL;
+        g_dbus_interface_skeleton_unexport(G_DBUS_INTERFACE_SKELETON(data->impl));
+    }
+}
+
+JSBool
+gjs_define_gdbus_stuff(JSContext *context,
+                       JSObject  *module_obj)
+{
+    if (!JS_DefineFunction(context, module_obj,
+                           "dbus_proxy_call",
+                           (JSNative)gjs_dbus_proxy_call,
+                           7, GJS_MODULE_PROP_FLAGS))
+        return JS_FALSE;
+
+    if (!JS_DefineFunction(context, module_obj,
+                           "dbus_proxy_call_sync",
+                           (JSNative)gjs_dbus_proxy_call_sync,
+                           6, GJS_MODULE_PROP_FLAGS))
+        return JS_FALSE;
+
+    if (!JS_DefineFunction(context, module_obj,
+                           "dbus_implementation_set_target",
+                           (JSNative)gjs_dbus_implementation_set_target,
+                           2, GJS_MODULE_PROP_FLAGS))
+        return JS_FALSE;
+
+    return JS_TRUE;
+}
@@ -37,10 +37,16 @@
 #include "gjs_gi_probes.h"
 #define TRACE(probe) probe
 
+/* Guards probes whose arguments cost something to compute; true only
+ * while a tracer is attached to the probe.
+ */
+#define TRACE_ENABLED(probe) G_UNLIKELY(GJS_##probe##_ENABLED())
+
 #else
 
 /* Wrap the probe to allow it to be removed when no systemtap available */
 #define TRACE(probe)
+#define TRACE_ENABLED(probe) 0
 
 #endif
 
@@ -95,7 +95,7 @@ get_name_func (JSContext *context,
 
     gtype = GPOINTER_TO_SIZE(priv_from_js(context, *obj));
 
-    ret = gjs_string_from_utf8(context, g_type_name(gtype), -1, &retval);
+    ret = gjs_string_from_static_utf8(context, g_type_name(gtype), &retval);
     if (ret)
         JS_SET_RVAL(context, vp, retval);
     return ret;
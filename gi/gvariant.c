@@ -0,0 +1,1195 @@
+/* -*- mode: C; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2013  Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include <gjs/gjs-module.h>
+#include <gjs/compat.h>
+#include <gjs/byteArray.h>
+#include <gjs/runtime.h>
+#include "boxed.h"
+#include "gvariant.h"
+
+#include <util/log.h>
+
+#include <girepository.h>
+
+/* Conversion between GVariant and JS values, done in one pass over the
+ * serialized data instead of going through GI for every element.
+ *
+ * The rules follow what GLib.Variant.new_*() and get_*() would do
+ * through gi/arg.c, so that the native engine is a drop-in replacement
+ * for the implementation that used to live in the GLib overrides.
+ */
+
+typedef union {
+    gboolean v_boolean;
+    guint8   v_byte;
+    gint16   v_int16;
+    guint16  v_uint16;
+    gint32   v_int32;
+    guint32  v_uint32;
+    gint64   v_int64;
+    guint64  v_uint64;
+    gdouble  v_double;
+} BasicValue;
+
+static GIStructInfo *
+get_variant_info(void)
+{
+    static gsize info = 0;
+
+    if (g_once_init_enter(&info)) {
+        GIBaseInfo *found;
+
+        found = g_irepository_find_by_gtype(NULL, G_TYPE_VARIANT);
+        g_assert(found != NULL);
+        g_once_init_leave(&info, (gsize) found);
+    }
+
+    return (GIStructInfo*) info;
+}
+
+static JSBool
+wrap_variant(JSContext *context,
+             GVariant  *variant,
+             jsval     *value_p)
+{
+    JSObject *obj;
+
+    obj = gjs_boxed_from_c_struct(context, get_variant_info(), variant,
+                                  GJS_BOXED_CREATION_NONE);
+    if (obj == NULL)
+        return JS_FALSE;
+
+    *value_p = OBJECT_TO_JSVAL(obj);
+    return JS_TRUE;
+}
+
+static void
+discard_variant(GVariant *variant)
+{
+    if (variant != NULL)
+        g_variant_unref(g_variant_ref_sink(variant));
+}
+
+/* Size in bytes of an element of a fixed-size numeric array, or 0 if
+ * elements of this type can't be handled as a flat C array. Booleans
+ * are left out on purpose since they are serialized as bytes but
+ * converted as gboolean.
+ */
+static gsize
+fixed_element_size(char type_char)
+{
+    switch (type_char) {
+    case 'y':
+        return 1;
+    case 'n':
+    case 'q':
+        return 2;
+    case 'i':
+    case 'u':
+    case 'h':
+        return 4;
+    case 'x':
+    case 't':
+    case 'd':
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+static gboolean
+typed_array_kind(char      type_char,
+                 guint    *size,
+                 gboolean *is_signed,
+                 gboolean *floating)
+{
+    *is_signed = FALSE;
+    *floating = FALSE;
+
+    switch (type_char) {
+    case 'y':
+        *size = 8;
+        return TRUE;
+    case 'n':
+        *is_signed = TRUE;
+        /* fall through */
+    case 'q':
+        *size = 16;
+        return TRUE;
+    case 'i':
+    case 'h':
+        *is_signed = TRUE;
+        /* fall through */
+    case 'u':
+        *size = 32;
+        return TRUE;
+    case 'd':
+        *floating = TRUE;
+        *size = 64;
+        return TRUE;
+    default:
+        /* no 64-bit integer typed arrays */
+        return FALSE;
+    }
+}
+
+static JSBool
+value_to_basic(JSContext  *context,
+               char        type_char,
+               jsval       value,
+               BasicValue *basic)
+{
+    gboolean out_of_range = FALSE;
+
+    switch (type_char) {
+    case 'b': {
+        JSBool b;
+        if (!JS_ValueToBoolean(context, value, &b))
+            return JS_FALSE;
+        basic->v_boolean = b;
+        break;
+    }
+    case 'y': {
+        guint32 i;
+        if (!JS_ValueToECMAUint32(context, value, &i))
+            return JS_FALSE;
+        out_of_range = i > G_MAXUINT8;
+        basic->v_byte = (guint8) i;
+        break;
+    }
+    case 'n': {
+        gint32 i;
+        if (!JS_ValueToInt32(context, value, &i))
+            return JS_FALSE;
+        out_of_range = i > G_MAXINT16 || i < G_MININT16;
+        basic->v_int16 = (gint16) i;
+        break;
+    }
+    case 'q': {
+        guint32 i;
+        if (!JS_ValueToECMAUint32(context, value, &i))
+            return JS_FALSE;
+        out_of_range = i > G_MAXUINT16;
+        basic->v_uint16 = (guint16) i;
+        break;
+    }
+    case 'i':
+    case 'h':
+        if (!JS_ValueToInt32(context, value, &basic->v_int32))
+            return JS_FALSE;
+        break;
+    case 'u': {
+        double v;
+        if (!JS_ValueToNumber(context, value, &v))
+            return JS_FALSE;
+        /* written so that NaN is out of range too; the cast is
+         * undefined for anything that doesn't fit
+         */
+        out_of_range = !(v >= 0 && v < 4294967296.0);
+        if (!out_of_range)
+            basic->v_uint32 = (guint32) v;
+        break;
+    }
+    case 'x': {
+        double v;
+        if (!JS_ValueToNumber(context, value, &v))
+            return JS_FALSE;
+        /* G_MAXINT64 rounds up to 2^63 as a double */
+        out_of_range = !(v >= -9223372036854775808.0 && v < 9223372036854775808.0);
+        if (!out_of_range)
+            basic->v_int64 = (gint64) v;
+        break;
+    }
+    case 't': {
+        double v;
+        if (!JS_ValueToNumber(context, value, &v))
+            return JS_FALSE;
+        out_of_range = !(v >= 0 && v < 18446744073709551616.0);
+        if (!out_of_range)
+            basic->v_uint64 = (guint64) v;
+        break;
+    }
+    case 'd':
+        if (!JS_ValueToNumber(context, value, &basic->v_double))
+            return JS_FALSE;
+        break;
+    default:
+        g_assert_not_reached();
+    }
+
+    if (out_of_range) {
+        gjs_throw(context, "value is out of range for GVariant type '%c'",
+                  type_char);
+        return JS_FALSE;
+    }
+
+    return JS_TRUE;
+}
+
+static GVariant *
+basic_to_variant(char        type_char,
+                 BasicValue *basic)
+{
+    switch (type_char) {
+    case 'b':
+        return g_variant_new_boolean(basic->v_boolean);
+    case 'y':
+        return g_variant_new_byte(basic->v_byte);
+    case 'n':
+        return g_variant_new_int16(basic->v_int16);
+    case 'q':
+        return g_variant_new_uint16(basic->v_uint16);
+    case 'i':
+        return g_variant_new_int32(basic->v_int32);
+    case 'h':
+        return g_variant_new_handle(basic->v_int32);
+    case 'u':
+        return g_variant_new_uint32(basic->v_uint32);
+    case 'x':
+        return g_variant_new_int64(basic->v_int64);
+    case 't':
+        return g_variant_new_uint64(basic->v_uint64);
+    case 'd':
+        return g_variant_new_double(basic->v_double);
+    default:
+        g_assert_not_reached();
+        return NULL;
+    }
+}
+
+/* Converts one element of a fixed-size array, read straight from the
+ * serialized data.
+ */
+static JSBool
+fixed_element_to_value(JSContext    *context,
+                       char          type_char,
+                       gconstpointer data,
+                       jsval        *value_p)
+{
+    BasicValue basic;
+
+    memcpy(&basic, data, fixed_element_size(type_char));
+
+    switch (type_char) {
+    case 'y':
+        *value_p = INT_TO_JSVAL(basic.v_byte);
+        return JS_TRUE;
+    case 'n':
+        *value_p = INT_TO_JSVAL(basic.v_int16);
+        return JS_TRUE;
+    case 'q':
+        *value_p = INT_TO_JSVAL(basic.v_uint16);
+        return JS_TRUE;
+    case 'i':
+    case 'h':
+        *value_p = INT_TO_JSVAL(basic.v_int32);
+        return JS_TRUE;
+    case 'u':
+        return JS_NewNumberValue(context, basic.v_uint32, value_p);
+    case 'x':
+        return JS_NewNumberValue(context, basic.v_int64, value_p);
+    case 't':
+        return JS_NewNumberValue(context, basic.v_uint64, value_p);
+    case 'd':
+        return JS_NewNumberValue(context, basic.v_double, value_p);
+    default:
+        g_assert_not_reached();
+        return JS_FALSE;
+    }
+}
+
+static JSBool
+get_length(JSContext *context,
+           JSObject  *obj,
+           guint32   *length_p)
+{
+    jsval length_value;
+
+    if (!gjs_object_require_property(context, obj, NULL,
+                                     gjs_runtime_get_const_string(JS_GetRuntime(context),
+                                                                  GJS_STRING_LENGTH),
+                                     &length_value))
+        return JS_FALSE;
+
+    return JS_ValueToECMAUint32(context, length_value, length_p);
+}
+
+static GVariant *
+pack_string(JSContext          *context,
+            const GVariantType *type,
+            jsval               value)
+{
+    char type_char = *g_variant_type_peek_string(type);
+    GVariant *variant = NULL;
+    char *str;
+
+    if (!JSVAL_IS_STRING(value)) {
+        gjs_throw(context, "Expected a string for GVariant type '%c'",
+                  type_char);
+        return NULL;
+    }
+
+    if (!gjs_string_to_utf8(context, value, &str))
+        return NULL;
+
+    switch (type_char) {
+    case 's':
+        variant = g_variant_new_string(str);
+        break;
+    case 'o':
+        if (g_variant_is_object_path(str))
+            variant = g_variant_new_object_path(str);
+        else
+            gjs_throw(context, "'%s' is not a valid D-Bus object path", str);
+        break;
+    case 'g':
+        if (g_variant_is_signature(str))
+            variant = g_variant_new_signature(str);
+        else
+            gjs_throw(context, "'%s' is not a valid D-Bus signature", str);
+        break;
+    default:
+        g_assert_not_reached();
+    }
+
+    g_free(str);
+    return variant;
+}
+
+/* Packs arrays of fixed-size numbers from typed arrays, ByteArrays and
+ * strings without converting each element. Returns FALSE with
+ * *variant_p unset if the value isn't one of those.
+ */
+static gboolean
+pack_fixed_array_direct(JSContext          *context,
+                        const GVariantType *element_type,
+                        jsval               value,
+                        GVariant          **variant_p)
+{
+    char type_char = *g_variant_type_peek_string(element_type);
+    guint size;
+    gboolean is_signed, floating;
+    JSObject *obj;
+
+    if (type_char == 'y' && JSVAL_IS_STRING(value)) {
+        char *str;
+
+        if (!gjs_string_to_utf8(context, value, &str)) {
+            *variant_p = NULL;
+            return TRUE;
+        }
+
+        *variant_p = g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE,
+                                               str, strlen(str), 1);
+        g_free(str);
+        return TRUE;
+    }
+
+    if (!JSVAL_IS_OBJECT(value) || JSVAL_IS_NULL(value))
+        return FALSE;
+
+    obj = JSVAL_TO_OBJECT(value);
+
+    if (type_char == 'y' && gjs_typecheck_bytearray(context, obj, JS_FALSE)) {
+        GBytes *bytes;
+
+        bytes = gjs_byte_array_get_bytes(context, obj);
+        *variant_p = g_variant_new_from_bytes(G_VARIANT_TYPE_BYTESTRING,
+                                              bytes, TRUE);
+        g_bytes_unref(bytes);
+        return TRUE;
+    }
+
+    if (typed_array_kind(type_char, &size, &is_signed, &floating) &&
+        gjs_is_typed_array_object(context, obj) &&
+        gjs_typed_array_is_compatible(context, obj, size, is_signed, floating)) {
+        *variant_p = g_variant_new_fixed_array(element_type,
+                                               gjs_typed_array_get_data(context, obj),
+                                               gjs_typed_array_get_length(context, obj),
+                                               size / 8);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static GVariant *
+pack_fixed_array(JSContext          *context,
+                 const GVariantType *type,
+                 JSObject           *obj,
+                 guint32             length)
+{
+    char type_char = *g_variant_type_peek_string(g_variant_type_element(type));
+    gsize size = fixed_element_size(type_char);
+    guint8 *data;
+    guint32 i;
+
+    data = g_malloc(size * length);
+
+    for (i = 0; i < length; i++) {
+        BasicValue basic;
+        jsval elem;
+
+        if (!JS_GetElement(context, obj, i, &elem) ||
+            !value_to_basic(context, type_char, elem, &basic)) {
+            g_free(data);
+            return NULL;
+        }
+
+        /* every member of the union starts at its beginning */
+        memcpy(data + i * size, &basic, size);
+    }
+
+    return g_variant_new_from_data(type, data, size * length, TRUE,
+                                   g_free, data);
+}
+
+static GVariant *
+pack_dict(JSContext          *context,
+          const GVariantType *type,
+          jsval               value)
+{
+    const GVariantType *entry_type = g_variant_type_element(type);
+    const GVariantType *key_type = g_variant_type_key(entry_type);
+    const GVariantType *value_type = g_variant_type_value(entry_type);
+    GVariantBuilder builder;
+    JSObject *props, *iter;
+    jsid prop_id;
+
+    if (!JSVAL_IS_OBJECT(value) || JSVAL_IS_NULL(value)) {
+        gjs_throw(context, "Expected an object for GVariant type '%s'",
+                  g_variant_type_peek_string(type));
+        return NULL;
+    }
+
+    props = JSVAL_TO_OBJECT(value);
+    iter = JS_NewPropertyIterator(context, props);
+    if (iter == NULL)
+        return NULL;
+
+    g_variant_builder_init(&builder, type);
+
+    prop_id = JSID_VOID;
+    if (!JS_NextProperty(context, iter, &prop_id))
+        goto fail;
+
+    while (!JSID_IS_VOID(prop_id)) {
+        jsval key_js, val_js;
+        GVariant *key, *child;
+
+        if (!JS_IdToValue(context, prop_id, &key_js))
+            goto fail;
+
+        /* Keys are always strings when seen from JS */
+        if (!JSVAL_IS_STRING(key_js)) {
+            JSString *str = JS_ValueToString(context, key_js);
+            if (str == NULL)
+                goto fail;
+            key_js = STRING_TO_JSVAL(str);
+        }
+
+        key = gjs_variant_pack(context, key_type, key_js);
+        if (key == NULL)
+            goto fail;
+
+        if (!JS_GetPropertyById(context, props, prop_id, &val_js)) {
+            discard_variant(key);
+            goto fail;
+        }
+
+        child = gjs_variant_pack(context, value_type, val_js);
+        if (child == NULL) {
+            discard_variant(key);
+            goto fail;
+        }
+
+        g_variant_builder_add_value(&builder,
+                                    g_variant_new_dict_entry(key, child));
+
+        prop_id = JSID_VOID;
+        if (!JS_NextProperty(context, iter, &prop_id))
+            goto fail;
+    }
+
+    return g_variant_builder_end(&builder);
+
+ fail:
+    g_variant_builder_clear(&builder);
+    return NULL;
+}
+
+static GVariant *
+pack_array(JSContext          *context,
+           const GVariantType *type,
+           jsval               value)
+{
+    const GVariantType *element_type = g_variant_type_element(type);
+    GVariantBuilder builder;
+    GVariant *variant;
+    JSObject *obj;
+    guint32 length, i;
+
+    if (g_variant_type_is_dict_entry(element_type))
+        return pack_dict(context, type, value);
+
+    if (fixed_element_size(*g_variant_type_peek_string(element_type)) > 0 &&
+        pack_fixed_array_direct(context, element_type, value, &variant))
+        return variant;
+
+    if (!JSVAL_IS_OBJECT(value) || JSVAL_IS_NULL(value)) {
+        gjs_throw(context, "Expected an array for GVariant type '%s'",
+                  g_variant_type_peek_string(type));
+        return NULL;
+    }
+
+    obj = JSVAL_TO_OBJECT(value);
+    if (!get_length(context, obj, &length))
+        return NULL;
+
+    if (fixed_element_size(*g_variant_type_peek_string(element_type)) > 0)
+        return pack_fixed_array(context, type, obj, length);
+
+    g_variant_builder_init(&builder, type);
+
+    for (i = 0; i < length; i++) {
+        jsval elem;
+        GVariant *child;
+
+        if (!JS_GetElement(context, obj, i, &elem))
+            goto fail;
+
+        child = gjs_variant_pack(context, element_type, elem);
+        if (child == NULL)
+            goto fail;
+
+        g_variant_builder_add_value(&builder, child);
+    }
+
+    return g_variant_builder_end(&builder);
+
+ fail:
+    g_variant_builder_clear(&builder);
+    return NULL;
+}
+
+/* Tuples and dictionary entries are both packed from JS arrays */
+static GVariant *
+pack_tuple(JSContext          *context,
+           const GVariantType *type,
+           jsval               value)
+{
+    const GVariantType *item_type;
+    GVariantBuilder builder;
+    JSObject *obj;
+    guint32 length, i;
+    gsize n_items;
+
+    n_items = g_variant_type_n_items(type);
+
+    if (!JSVAL_IS_OBJECT(value) || JSVAL_IS_NULL(value)) {
+        gjs_throw(context, "Expected an array for GVariant type '%s'",
+                  g_variant_type_peek_string(type));
+        return NULL;
+    }
+
+    obj = JSVAL_TO_OBJECT(value);
+    if (!get_length(context, obj, &length))
+        return NULL;
+
+    if (length < n_items) {
+        gjs_throw(context, "Expected %" G_GSIZE_FORMAT " elements for GVariant type '%s', got %u",
+                  n_items, g_variant_type_peek_string(type), length);
+        return NULL;
+    }
+
+    g_variant_builder_init(&builder, type);
+
+    for (item_type = g_variant_type_first(type), i = 0;
+         item_type != NULL;
+         item_type = g_variant_type_next(item_type), i++) {
+        jsval elem;
+        GVariant *child;
+
+        if (!JS_GetElement(context, obj, i, &elem))
+            goto fail;
+
+        child = gjs_variant_pack(context, item_type, elem);
+        if (child == NULL)
+            goto fail;
+
+        g_variant_builder_add_value(&builder, child);
+    }
+
+    return g_variant_builder_end(&builder);
+
+ fail:
+    g_variant_builder_clear(&builder);
+    return NULL;
+}
+
+/**
+ * gjs_variant_pack:
+ * @context: the #JSContext
+ * @type: a definite #GVariantType
+ * @value: the JS value to convert
+ *
+ * Converts @value to a #GVariant of type @type, recursing into
+ * containers. Arrays of fixed-size numbers are packed from typed arrays
+ * and ByteArrays without converting the elements one by one.
+ *
+ * Returns: a floating reference to the new #GVariant, or %NULL with an
+ * exception pending
+ */
+GVariant *
+gjs_variant_pack(JSContext          *context,
+                 const GVariantType *type,
+                 jsval               value)
+{
+    char type_char = *g_variant_type_peek_string(type);
+
+    switch (type_char) {
+    case 'b':
+    case 'y':
+    case 'n':
+    case 'q':
+    case 'i':
+    case 'u':
+    case 'x':
+    case 't':
+    case 'h':
+    case 'd': {
+        BasicValue basic;
+
+        if (!value_to_basic(context, type_char, value, &basic))
+            return NULL;
+        return basic_to_variant(type_char, &basic);
+    }
+
+    case 's':
+    case 'o':
+    case 'g':
+        return pack_string(context, type, value);
+
+    case 'v': {
+        GVariant *child;
+
+        if (!JSVAL_IS_OBJECT(value) || JSVAL_IS_NULL(value)) {
+            gjs_throw_custom(context, "TypeError",
+                             "Expected a GLib.Variant for type 'v'");
+            return NULL;
+        }
+
+        if (!gjs_typecheck_boxed(context, JSVAL_TO_OBJECT(value), NULL,
+                                 G_TYPE_VARIANT, JS_TRUE))
+            return NULL;
+
+        child = gjs_c_struct_from_boxed(context, JSVAL_TO_OBJECT(value));
+        return g_variant_new_variant(child);
+    }
+
+    case 'm': {
+        GVariant *child = NULL;
+
+        if (!JSVAL_IS_NULL(value) && !JSVAL_IS_VOID(value)) {
+            child = gjs_variant_pack(context, g_variant_type_element(type), value);
+            if (child == NULL)
+                return NULL;
+        }
+
+        return g_variant_new_maybe(g_variant_type_element(type), child);
+    }
+
+    case 'a':
+        return pack_array(context, type, value);
+
+    case '(':
+    case '{':
+        return pack_tuple(context, type, value);
+
+    default:
+        gjs_throw_custom(context, "TypeError",
+                         "Invalid GVariant signature (unexpected character %c)",
+                         type_char);
+        return NULL;
+    }
+}
+
+static JSBool
+unpack_children(JSContext *context,
+                GVariant  *variant,
+                gboolean   deep,
+                jsval     *value_p)
+{
+    JSRuntime *runtime = JS_GetRuntime(context);
+    gsize n_children, i;
+    jsval *values;
+    JSObject *array;
+    JSBool ret = JS_FALSE;
+
+    n_children = g_variant_n_children(variant);
+    values = gjs_runtime_push_values(runtime, n_children);
+
+    for (i = 0; i < n_children; i++) {
+        GVariant *child = g_variant_get_child_value(variant, i);
+        JSBool ok;
+
+        if (deep)
+            ok = gjs_variant_unpack(context, child, TRUE, &values[i]);
+        else
+            ok = wrap_variant(context, child, &values[i]);
+
+        g_variant_unref(child);
+        if (!ok)
+            goto out;
+    }
+
+    array = JS_NewArrayObject(context, n_children, values);
+    if (array == NULL)
+        goto out;
+
+    *value_p = OBJECT_TO_JSVAL(array);
+    ret = JS_TRUE;
+
+ out:
+    gjs_runtime_pop_values(runtime, values, n_children);
+    return ret;
+}
+
+static JSBool
+unpack_fixed_array(JSContext *context,
+                   GVariant  *variant,
+                   char       type_char,
+                   jsval     *value_p)
+{
+    JSRuntime *runtime = JS_GetRuntime(context);
+    gsize size = fixed_element_size(type_char);
+    gsize n_elements, i;
+    const guint8 *data;
+    jsval *values;
+    JSObject *array;
+    JSBool ret = JS_FALSE;
+
+    data = g_variant_get_fixed_array(variant, &n_elements, size);
+    values = gjs_runtime_push_values(runtime, n_elements);
+
+    for (i = 0; i < n_elements; i++) {
+        if (!fixed_element_to_value(context, type_char, data + i * size,
+                                    &values[i]))
+            goto out;
+    }
+
+    array = JS_NewArrayObject(context, n_elements, values);
+    if (array == NULL)
+        goto out;
+
+    *value_p = OBJECT_TO_JSVAL(array);
+    ret = JS_TRUE;
+
+ out:
+    gjs_runtime_pop_values(runtime, values, n_elements);
+    return ret;
+}
+
+static JSBool
+unpack_dict(JSContext *context,
+            GVariant  *variant,
+            gboolean   deep,
+            jsval     *value_p)
+{
+    GVariantIter iter;
+    GVariant *entry;
+    JSObject *obj;
+
+    obj = JS_NewObject(context, NULL, NULL, NULL);
+    if (obj == NULL)
+        return JS_FALSE;
+
+    /* Use the object as the return value right away so that it's
+     * rooted while we fill it. */
+    *value_p = OBJECT_TO_JSVAL(obj);
+
+    g_variant_iter_init(&iter, variant);
+    while ((entry = g_variant_iter_next_value(&iter)) != NULL) {
+        GVariant *key, *child;
+        jsval key_js, val_js;
+        jsid id;
+        JSBool ok;
+
+        key = g_variant_get_child_value(entry, 0);
+        child = g_variant_get_child_value(entry, 1);
+        g_variant_unref(entry);
+
+        /* always unpack the key, or it can't be used as a property name */
+        ok = gjs_variant_unpack(context, key, TRUE, &key_js);
+        if (ok) {
+            if (deep)
+                ok = gjs_variant_unpack(context, child, TRUE, &val_js);
+            else
+                ok = wrap_variant(context, child, &val_js);
+        }
+
+        g_variant_unref(key);
+        g_variant_unref(child);
+
+        if (!ok ||
+            !JS_ValueToId(context, key_js, &id) ||
+            !JS_SetPropertyById(context, obj, id, &val_js))
+            return JS_FALSE;
+    }
+
+    return JS_TRUE;
+}
+
+static JSBool
+unpack_array(JSContext *context,
+             GVariant  *variant,
+             gboolean   deep,
+             jsval     *value_p)
+{
+    const GVariantType *element_type;
+    char type_char;
+
+    element_type = g_variant_type_element(g_variant_get_type(variant));
+    type_char = *g_variant_type_peek_string(element_type);
+
+    if (g_variant_type_is_dict_entry(element_type))
+        return unpack_dict(context, variant, deep, value_p);
+
+    if (type_char == 'y') {
+        /* byte arrays share the serialized data */
+        GBytes *bytes;
+        JSObject *obj;
+
+        bytes = g_variant_get_data_as_bytes(variant);
+        obj = gjs_byte_array_from_bytes(context, bytes);
+        g_bytes_unref(bytes);
+
+        if (obj == NULL)
+            return JS_FALSE;
+
+        *value_p = OBJECT_TO_JSVAL(obj);
+        return JS_TRUE;
+    }
+
+    if (deep && fixed_element_size(type_char) > 0)
+        return unpack_fixed_array(context, variant, type_char, value_p);
+
+    return unpack_children(context, variant, deep, value_p);
+}
+
+/**
+ * gjs_variant_unpack:
+ * @context: the #JSContext
+ * @variant: the #GVariant to convert
+ * @deep: whether to unpack nested containers as well
+ * @value_p: return location for the JS value
+ *
+ * Converts @variant to a JS value. If @deep is %FALSE, the children of
+ * containers are returned as GLib.Variant wrappers; variants nested in a
+ * 'v' are never unpacked. Dictionaries become plain objects and byte
+ * arrays become ByteArrays sharing the variant data.
+ */
+JSBool
+gjs_variant_unpack(JSContext *context,
+                   GVariant  *variant,
+                   gboolean   deep,
+                   jsval     *value_p)
+{
+    switch (g_variant_classify(variant)) {
+    case G_VARIANT_CLASS_BOOLEAN:
+        *value_p = BOOLEAN_TO_JSVAL(g_variant_get_boolean(variant));
+        return JS_TRUE;
+    case G_VARIANT_CLASS_BYTE:
+        *value_p = INT_TO_JSVAL(g_variant_get_byte(variant));
+        return JS_TRUE;
+    case G_VARIANT_CLASS_INT16:
+        *value_p = INT_TO_JSVAL(g_variant_get_int16(variant));
+        return JS_TRUE;
+    case G_VARIANT_CLASS_UINT16:
+        *value_p = INT_TO_JSVAL(g_variant_get_uint16(variant));
+        return JS_TRUE;
+    case G_VARIANT_CLASS_INT32:
+        *value_p = INT_TO_JSVAL(g_variant_get_int32(variant));
+        return JS_TRUE;
+    case G_VARIANT_CLASS_HANDLE:
+        *value_p = INT_TO_JSVAL(g_variant_get_handle(variant));
+        return JS_TRUE;
+    case G_VARIANT_CLASS_UINT32:
+        return JS_NewNumberValue(context, g_variant_get_uint32(variant), value_p);
+    case G_VARIANT_CLASS_INT64:
+        return JS_NewNumberValue(context, g_variant_get_int64(variant), value_p);
+    case G_VARIANT_CLASS_UINT64:
+        return JS_NewNumberValue(context, g_variant_get_uint64(variant), value_p);
+    case G_VARIANT_CLASS_DOUBLE:
+        return JS_NewNumberValue(context, g_variant_get_double(variant), value_p);
+
+    case G_VARIANT_CLASS_STRING:
+    case G_VARIANT_CLASS_OBJECT_PATH:
+    case G_VARIANT_CLASS_SIGNATURE: {
+        const char *str;
+        gsize len;
+
+        str = g_variant_get_string(variant, &len);
+        return gjs_string_from_utf8(context, str, len, value_p);
+    }
+
+    case G_VARIANT_CLASS_VARIANT: {
+        GVariant *child;
+        JSBool ret;
+
+        child = g_variant_get_variant(variant);
+        ret = wrap_variant(context, child, value_p);
+        g_variant_unref(child);
+        return ret;
+    }
+
+    case G_VARIANT_CLASS_MAYBE: {
+        GVariant *child;
+        JSBool ret;
+
+        child = g_variant_get_maybe(variant);
+        if (child == NULL) {
+            *value_p = JSVAL_NULL;
+            return JS_TRUE;
+        }
+
+        if (deep)
+            ret = gjs_variant_unpack(context, child, TRUE, value_p);
+        else
+            ret = wrap_variant(context, child, value_p);
+        g_variant_unref(child);
+        return ret;
+    }
+
+    case G_VARIANT_CLASS_ARRAY:
+        return unpack_array(context, variant, deep, value_p);
+
+    case G_VARIANT_CLASS_TUPLE:
+    case G_VARIANT_CLASS_DICT_ENTRY:
+        return unpack_children(context, variant, deep, value_p);
+    }
+
+    g_assert_not_reached();
+    return JS_FALSE;
+}
+
+static GVariant *
+variant_from_value(JSContext *context,
+                   jsval      value)
+{
+    if (!JSVAL_IS_OBJECT(value) || JSVAL_IS_NULL(value)) {
+        gjs_throw_custom(context, "TypeError", "Expected a GLib.Variant");
+        return NULL;
+    }
+
+    if (!gjs_typecheck_boxed(context, JSVAL_TO_OBJECT(value), NULL,
+                             G_TYPE_VARIANT, JS_TRUE))
+        return NULL;
+
+    return gjs_c_struct_from_boxed(context, JSVAL_TO_OBJECT(value));
+}
+
+static JSBool
+gjs_pack_variant(JSContext *context,
+                 unsigned   argc,
+                 jsval     *vp)
+{
+    jsval *argv = JS_ARGV(context, vp);
+    char *signature;
+    const char *end;
+    GVariantType *type;
+    GVariant *variant;
+    jsval retval;
+    JSBool ret = JS_FALSE;
+
+    if (argc < 2) {
+        gjs_throw(context, "Error invoking pack_variant: Expected 2 arguments, got %d",
+                  argc);
+        return JS_FALSE;
+    }
+
+    if (!gjs_string_to_utf8(context, argv[0], &signature))
+        return JS_FALSE;
+
+    if (*signature == '\0') {
+        gjs_throw_custom(context, "TypeError", "GVariant signature cannot be empty");
+        goto out;
+    }
+
+    if (!g_variant_type_string_scan(signature, NULL, &end)) {
+        gjs_throw_custom(context, "TypeError", "Invalid GVariant signature '%s'",
+                         signature);
+        goto out;
+    }
+
+    if (*end != '\0') {
+        gjs_throw_custom(context, "TypeError",
+                         "Invalid GVariant signature (more than one single complete type)");
+        goto out;
+    }
+
+    type = g_variant_type_new(signature);
+    if (!g_variant_type_is_definite(type)) {
+        gjs_throw_custom(context, "TypeError",
+                         "Invalid GVariant signature '%s' (not a definite type)",
+                         signature);
+        g_variant_type_free(type);
+        goto out;
+    }
+
+    variant = gjs_variant_pack(context, type, argv[1]);
+    g_variant_type_free(type);
+    if (variant == NULL)
+        goto out;
+
+    /* the wrapper takes the floating reference */
+    if (!wrap_variant(context, variant, &retval)) {
+        discard_variant(variant);
+        goto out;
+    }
+
+    JS_SET_RVAL(context, vp, retval);
+    ret = JS_TRUE;
+
+ out:
+    g_free(signature);
+    return ret;
+}
+
+static JSBool
+gjs_unpack_variant(JSContext *context,
+                   unsigned   argc,
+                   jsval     *vp)
+{
+    jsval *argv = JS_ARGV(context, vp);
+    GVariant *variant;
+    JSBool deep;
+    jsval retval;
+
+    if (argc < 2) {
+        gjs_throw(context, "Error invoking unpack_variant: Expected 2 arguments, got %d",
+                  argc);
+        return JS_FALSE;
+    }
+
+    variant = variant_from_value(context, argv[0]);
+    if (variant == NULL)
+        return JS_FALSE;
+
+    if (!JS_ValueToBoolean(context, argv[1], &deep))
+        return JS_FALSE;
+
+    if (!gjs_variant_unpack(context, variant, deep, &retval))
+        return JS_FALSE;
+
+    JS_SET_RVAL(context, vp, retval);
+    return JS_TRUE;
+}
+
+/* Copies an array of fixed-size numbers into a typed array with a
+ * single memcpy. SpiderMonkey can't create an ArrayBuffer over memory
+ * it doesn't own, so this is as close to zero-copy as we can get; byte
+ * arrays unpacked with unpack() share the GVariant data instead.
+ */
+static JSBool
+gjs_unpack_variant_typed_array(JSContext *context,
+                               unsigned   argc,
+                               jsval     *vp)
+{
+    jsval *argv = JS_ARGV(context, vp);
+    GVariant *variant;
+    const GVariantType *type;
+    char type_char;
+    guint size;
+    gboolean is_signed, floating;
+    gconstpointer data;
+    gsize n_elements;
+    JSObject *array;
+
+    if (argc < 1) {
+        gjs_throw(context, "Error invoking unpack_variant_typed_array: Expected 1 argument, got %d",
+                  argc);
+        return JS_FALSE;
+    }
+
+    variant = variant_from_value(context, argv[0]);
+    if (variant == NULL)
+        return JS_FALSE;
+
+    type = g_variant_get_type(variant);
+    type_char = g_variant_type_is_array(type) ?
+        *g_variant_type_peek_string(g_variant_type_element(type)) : '\0';
+
+    if (!typed_array_kind(type_char, &size, &is_signed, &floating)) {
+        gjs_throw(context, "Can't unpack a GVariant of type '%s' into a typed array",
+                  g_variant_get_type_string(variant));
+        return JS_FALSE;
+    }
+
+    data = g_variant_get_fixed_array(variant, &n_elements, size / 8);
+    if (n_elements > G_MAXUINT32) {
+        gjs_throw(context, "GVariant array too large for a typed array");
+        return JS_FALSE;
+    }
+
+    array = gjs_typed_array_new(context, size, is_signed, floating, n_elements);
+    if (array == NULL)
+        return JS_FALSE;
+
+    if (n_elements > 0)
+        memcpy(gjs_typed_array_get_data(context, array), data,
+               n_elements * (size / 8));
+
+    JS_SET_RVAL(context, vp, OBJECT_TO_JSVAL(array));
+    return JS_TRUE;
+}
+
+JSBool
+gjs_define_gvariant_stuff(JSContext *context,
+                          JSObject  *module_obj)
+{
+    if (!JS_DefineFunction(context, module_obj,
+                           "pack_variant",
+                           (JSNative)gjs_pack_variant,
+                           2, GJS_MODULE_PROP_FLAGS))
+        return JS_FALSE;
+
+    if (!JS_DefineFunction(context, module_obj,
+                           "unpack_variant",
+                           (JSNative)gjs_unpack_variant,
+                           2, GJS_MODULE_PROP_FLAGS))
+        return JS_FALSE;
+
+    if (!JS_DefineFunction(context, module_obj,
+                           "unpack_variant_typed_array",
+                           (JSNative)gjs_unpack_variant_typed_array,
+                           1, GJS_MODULE_PROP_FLAGS))
+        return JS_FALSE;
+
+    return JS_TRUE;
+}
@@ -38,45 +38,157 @@ typedef struct {
     void *data;
 } Child;
 
+/* Children are kept in an open-addressing table with linear probing,
+ * so that keep_alive_trace() is a sequential walk over one array
+ * instead of a hash table foreach over slice-allocated nodes.
+ *
+ * An all-NULL slot is empty. A removal leaves a tombstone behind
+ * (child == TOMBSTONE) to keep probe sequences intact; tombstones are
+ * dropped on the next resize.
+ */
 typedef struct {
-    GHashTable *children;
+    Child *children;
+    guint capacity; /* always a power of two */
+    guint n_children;
+    guint n_tombstones;
     unsigned int inside_finalize : 1;
     unsigned int inside_trace : 1;
 } KeepAlive;
 
+#define MIN_CAPACITY 16
+
+static char tombstone_marker;
+#define TOMBSTONE ((JSObject*) &tombstone_marker)
+
 static struct JSClass gjs_keep_alive_class;
 
 GJS_DEFINE_PRIV_FROM_JS(KeepAlive, gjs_keep_alive_class)
 
-static guint
-child_hash(gconstpointer  v)
+static inline gboolean
+slot_is_empty(const Child *slot)
 {
-    const Child *child = v;
+    return slot->child == NULL && slot->data == NULL && slot->notify == NULL;
+}
 
-    return
-        GPOINTER_TO_UINT(child->notify) ^
-        GPOINTER_TO_UINT(child->child) ^
-        GPOINTER_TO_UINT(child->data);
+static inline gboolean
+slot_is_free(const Child *slot)
+{
+    return slot->child == TOMBSTONE || slot_is_empty(slot);
 }
 
+static inline guint
+child_hash(GjsUnrootedFunc  notify,
+           JSObject        *obj,
+           void            *data)
+{
+    gsize h;
+
+    /* Objects and data are at least 8-byte aligned, so drop the low
+     * bits before mixing; the multiplier spreads them over the table.
+     */
+    h = (GPOINTER_TO_SIZE(obj) >> 3) ^
+        (GPOINTER_TO_SIZE(data) >> 3) ^
+        GPOINTER_TO_SIZE(notify);
+
+    return (guint) ((h * G_GUINT64_CONSTANT(0x9E3779B97F4A7C15)) >> 32);
+}
+
+static Child *
+find_child(KeepAlive       *priv,
+           GjsUnrootedFunc  notify,
+           JSObject        *obj,
+           void            *data)
+{
+    guint mask = priv->capacity - 1;
+    guint i;
+
+    for (i = child_hash(notify, obj, data) & mask; ; i = (i + 1) & mask) {
+        Child *slot = &priv->children[i];
+
+        if (slot_is_empty(slot))
+            return NULL;
+
+        /* notify is most likely to be equal, so check it last */
+        if (slot->data == data &&
+            slot->child == obj &&
+            slot->notify == notify)
+            return slot;
+    }
+}
+
+/* Returns TRUE if the child took the place of a tombstone */
 static gboolean
-child_equal (gconstpointer  v1,
-             gconstpointer  v2)
+insert_child_unchecked(Child       *children,
+                       guint        capacity,
+                       const Child *child)
 {
-    const Child *child1 = v1;
-    const Child *child2 = v2;
+    guint mask = capacity - 1;
+    guint i;
+    gboolean was_tombstone;
+
+    for (i = child_hash(child->notify, child->child, child->data) & mask;
+         !slot_is_free(&children[i]);
+         i = (i + 1) & mask)
+        ;
+
+    was_tombstone = children[i].child == TOMBSTONE;
+    children[i] = *child;
 
-    /* notify is most likely to be equal, so check it last */
-    return child1->data == child2->data &&
-        child1->child == child2->child &&
-        child1->notify == child2->notify;
+    return was_tombstone;
 }
 
 static void
-child_free(void *data)
+resize_children(KeepAlive *priv,
+                guint      capacity)
 {
-    Child *child = data;
-    g_slice_free(Child, child);
+    Child *old_children = priv->children;
+    guint old_capacity = priv->capacity;
+    guint i;
+
+    priv->children = g_new0(Child, capacity);
+    priv->capacity = capacity;
+    priv->n_tombstones = 0;
+
+    for (i = 0; i < old_capacity; i++) {
+        if (!slot_is_free(&old_children[i]))
+            insert_child_unchecked(priv->children, capacity, &old_children[i]);
+    }
+
+    g_free(old_children);
+}
+
+static void
+maybe_grow(KeepAlive *priv)
+{
+    guint capacity;
+
+    /* Keep the load, including tombstones, under 3/4 so that probe
+     * sequences stay short and always find an empty slot.
+     */
+    if ((priv->n_children + priv->n_tombstones + 1) * 4 < priv->capacity * 3)
+        return;
+
+    capacity = priv->capacity;
+    while ((priv->n_children + 1) * 2 >= capacity)
+        capacity *= 2;
+
+    resize_children(priv, capacity);
+}
+
+static void
+maybe_shrink(KeepAlive *priv)
+{
+    guint capacity;
+
+    if (priv->capacity <= MIN_CAPACITY ||
+        priv->n_children * 8 >= priv->capacity)
+        return;
+
+    capacity = priv->capacity;
+    while (capacity > MIN_CAPACITY && priv->n_children * 4 < capacity / 2)
+        capacity /= 2;
+
+    resize_children(priv, capacity);
 }
 
 GJS_NATIVE_CONSTRUCTOR_DEFINE_ABSTRACT(keep_alive)
@@ -86,8 +198,7 @@ keep_alive_finalize(JSFreeOp *fop,
                     JSObject *obj)
 {
     KeepAlive *priv;
-    void *key;
-    void *value;
+    guint i;
 
     priv = JS_GetPrivate(obj);
 
@@ -99,33 +210,21 @@ keep_alive_finalize(JSFreeOp *fop,
 
     priv->inside_finalize = TRUE;
 
-    while (gjs_g_hash_table_steal_one(priv->children,
-                                      &key, &value)) {
-        Child *child = value;
-        if (child->notify)
-            (* child->notify) (child->child, child->data);
+    for (i = 0; i < priv->capacity; i++) {
+        Child child = priv->children[i];
 
-        child_free(child);
-    }
+        if (slot_is_free(&child))
+            continue;
 
-    g_hash_table_destroy(priv->children);
-    g_slice_free(KeepAlive, priv);
-}
+        priv->children[i].child = TOMBSTONE;
+        priv->n_children--;
 
-static void
-trace_foreach(void *key,
-              void *value,
-              void *data)
-{
-    Child *child = value;
-    JSTracer *tracer = data;
-
-    if (child->child != NULL) {
-        jsval val;
-        JS_SET_TRACING_DETAILS(tracer, NULL, "keep-alive", 0);
-        val = OBJECT_TO_JSVAL(child->child);
-        JS_CallTracer(tracer, JSVAL_TO_TRACEABLE (val), JSTRACE_OBJECT);
+        if (child.notify)
+            (* child.notify) (child.child, child.data);
     }
+
+    g_free(priv->children);
+    g_slice_free(KeepAlive, priv);
 }
 
 static void
@@ -133,6 +232,7 @@ keep_alive_trace(JSTracer *tracer,
                  JSObject *obj)
 {
     KeepAlive *priv;
+    Child *slot, *end;
 
     priv = JS_GetPrivate(obj);
 
@@ -141,7 +241,13 @@ keep_alive_trace(JSTracer *tracer,
 
     g_assert(!priv->inside_trace);
     priv->inside_trace = TRUE;
-    g_hash_table_foreach(priv->children, trace_foreach, tracer);
+
+    end = priv->children + priv->capacity;
+    for (slot = priv->children; slot < end; slot++) {
+        if (slot->child != NULL && slot->child != TOMBSTONE)
+            JS_CALL_OBJECT_TRACER(tracer, slot->child, "keep-alive");
+    }
+
     priv->inside_trace = FALSE;
 }
 
@@ -151,7 +257,8 @@ keep_alive_trace(JSTracer *tracer,
  */
 static struct JSClass gjs_keep_alive_class = {
     "__private_GjsKeepAlive", /* means "new __private_GjsKeepAlive()" works */
-    JSCLASS_HAS_PRIVATE,
+    JSCLASS_HAS_PRIVATE |
+    JSCLASS_IMPLEMENTS_BARRIERS,
     JS_PropertyStub,
     JS_PropertyStub,
     JS_PropertyStub,
@@ -247,7 +354,8 @@ gjs_keep_alive_new(JSContext *context)
     }
 
     priv = g_slice_new0(KeepAlive);
-    priv->children = g_hash_table_new_full(child_hash, child_equal, NULL, child_free);
+    priv->children = g_new0(Child, MIN_CAPACITY);
+    priv->capacity = MIN_CAPACITY;
 
     g_assert(priv_from_js(context, keep_alive) == NULL);
     JS_SetPrivate(keep_alive, priv);
@@ -269,7 +377,7 @@ gjs_keep_alive_add_child(JSContext         *context,
                          void              *data)
 {
     KeepAlive *priv;
-    Child *child;
+    Child child;
 
     g_assert(keep_alive != NULL);
 
@@ -282,18 +390,18 @@ gjs_keep_alive_add_child(JSContext         *context,
     g_return_if_fail(!priv->inside_trace);
     g_return_if_fail(!priv->inside_finalize);
 
-    child = g_slice_new0(Child);
-    child->notify = notify;
-    child->child = obj;
-    child->data = data;
+    g_return_if_fail(notify != NULL || obj != NULL || data != NULL);
 
-    /* this is sort of an expensive check, probably */
-    g_return_if_fail(g_hash_table_lookup(priv->children, child) == NULL);
+    g_return_if_fail(find_child(priv, notify, obj, data) == NULL);
 
-    /* this overwrites any identical-by-value previous child,
-     * but there should not be one.
-     */
-    g_hash_table_replace(priv->children, child, child);
+    maybe_grow(priv);
+
+    child.notify = notify;
+    child.child = obj;
+    child.data = data;
+    if (insert_child_unchecked(priv->children, priv->capacity, &child))
+        priv->n_tombstones--;
+    priv->n_children++;
 }
 
 void
@@ -304,7 +412,7 @@ gjs_keep_alive_remove_child(JSContext         *context,
                             void              *data)
 {
     KeepAlive *priv;
-    Child child;
+    Child *slot;
 
     JS_BeginRequest(context);
     priv = priv_from_js(context, keep_alive);
@@ -315,12 +423,19 @@ gjs_keep_alive_remove_child(JSContext         *context,
     g_return_if_fail(!priv->inside_trace);
     g_return_if_fail(!priv->inside_finalize);
 
-    child.notify = notify;
-    child.child = obj;
-    child.data = data;
+    slot = find_child(priv, notify, obj, data);
+    if (slot == NULL)
+        return;
+
+    gjs_gc_write_barrier(slot->child);
+
+    slot->notify = NULL;
+    slot->child = TOMBSTONE;
+    slot->data = NULL;
+    priv->n_children--;
+    priv->n_tombstones++;
 
-    g_hash_table_remove(priv->children,
-                        &child);
+    maybe_shrink(priv);
 }
 
 static JSObject*
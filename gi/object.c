@@ -37,6 +37,8 @@
 #include "value.h"
 #include "keep-alive.h"
 #include "closure.h"
+#include "gvariant.h"
+#include "gdbus.h"
 #include "gjs_gi_trace.h"
 
 #include <gjs/gjs-module.h>
@@ -64,6 +66,8 @@
 /* #define gjs_debug_jsprop(arg1,args...) g_message(#arg1 ": " args) */
 
 
+typedef struct _ConnectData ConnectData;
+
 typedef struct {
     GIObjectInfo *info;
     GObject *gobj; /* NULL if we are the prototype and not an instance */
@@ -71,18 +75,22 @@ typedef struct {
     GType gtype;
 
     /* a list of all signal connections, used when tracing */
-    GList *signals;
+    ConnectData *signals;
 
     /* the GObjectClass wrapped by this JS Object (only used for
        prototypes) */
     GTypeClass *klass;
 } ObjectInstance;
 
-typedef struct {
+/* Linked in place, so connecting and disconnecting cost no list
+ * nodes of their own.
+ */
+struct _ConnectData {
     ObjectInstance *obj;
-    GList *link;
+    ConnectData *prev;
+    ConnectData *next;
     GClosure *closure;
-} ConnectData;
+};
 
 typedef enum
 {
@@ -103,12 +111,8 @@ enum {
     PROP_JS_HANDLED,
 };
 
-static GSList *object_init_list;
-static GHashTable *class_init_properties;
-
 static struct JSClass gjs_object_instance_class;
-static GThread *gjs_eval_thread;
-static volatile gint pending_idle_toggles;
+static GMutex type_module_lock;
 
 GJS_DEFINE_PRIV_FROM_JS(ObjectInstance, gjs_object_instance_class)
 
@@ -152,6 +156,16 @@ gjs_object_priv_quark (void)
     return val;
 }
 
+static GQuark
+gjs_object_runtime_quark (void)
+{
+    static GQuark val = 0;
+    if (G_UNLIKELY (!val))
+        val = g_quark_from_static_string ("gjs::runtime");
+
+    return val;
+}
+
 static GQuark
 gjs_toggle_down_quark (void)
 {
@@ -439,6 +453,72 @@ find_vfunc_on_parent(GIObjectInfo *info,
     return vfunc;
 }
 
+/* Lookups of vfuncs by name on introspected classes and interfaces,
+ * for gjs_hook_up_vfunc(); maps GType to a table of name to
+ * GIVFuncInfo, where NULL records a miss. Types are process-wide, so
+ * this is shared by all runtimes; the lock is recursive because
+ * lookups fall back to the parent type.
+ */
+static GRecMutex vfunc_cache_lock;
+static GHashTable *vfunc_cache = NULL;
+
+static void
+vfunc_cache_value_free(gpointer data)
+{
+    if (data != NULL)
+        g_base_info_unref((GIBaseInfo*) data);
+}
+
+static GIVFuncInfo *
+lookup_vfunc_cached(GType  gtype,
+                    gchar *name)
+{
+    GHashTable *by_name;
+    GIBaseInfo *info;
+    GIVFuncInfo *vfunc;
+    gpointer cached;
+
+    g_rec_mutex_lock(&vfunc_cache_lock);
+
+    if (vfunc_cache == NULL)
+        vfunc_cache = gjs_hash_table_new_for_gsize((GDestroyNotify) g_hash_table_unref);
+
+    by_name = gjs_hash_table_for_gsize_lookup(vfunc_cache, gtype);
+    if (by_name == NULL) {
+        by_name = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                        g_free, vfunc_cache_value_free);
+        gjs_hash_table_for_gsize_insert(vfunc_cache, gtype, by_name);
+    }
+
+    if (g_hash_table_lookup_extended(by_name, name, NULL, &cached)) {
+        vfunc = cached ? g_base_info_ref((GIBaseInfo*) cached) : NULL;
+        goto out;
+    }
+
+    vfunc = NULL;
+
+    info = g_irepository_find_by_gtype(g_irepository_get_default(), gtype);
+    if (info != NULL) {
+        if (g_base_info_get_type(info) == GI_INFO_TYPE_OBJECT)
+            vfunc = find_vfunc_on_parent((GIObjectInfo*) info, name);
+        else if (g_base_info_get_type(info) == GI_INFO_TYPE_INTERFACE)
+            vfunc = g_interface_info_find_vfunc((GIInterfaceInfo*) info, name);
+
+        g_base_info_unref(info);
+    } else if (G_TYPE_IS_OBJECT(gtype) && gtype != G_TYPE_OBJECT) {
+        /* use the first class that actually has repository information;
+         * interfaces don't have to exist, they could be private or dynamic */
+        vfunc = lookup_vfunc_cached(g_type_parent(gtype), name);
+    }
+
+    g_hash_table_insert(by_name, g_strdup(name),
+                        vfunc ? g_base_info_ref((GIBaseInfo*) vfunc) : NULL);
+
+ out:
+    g_rec_mutex_unlock(&vfunc_cache_lock);
+    return vfunc;
+}
+
 static JSBool
 object_instance_new_resolve_no_info(JSContext       *context,
                                     JSObject        *obj,
@@ -851,6 +931,8 @@ handle_toggle_down(JSContext *context,
     ObjectInstance *priv;
     JSObject *obj;
 
+    TRACE(GJS_TOGGLE_DOWN(gobj));
+
     obj = peek_js_obj(gobj);
 
     priv = priv_from_js(context, obj);
@@ -890,8 +972,10 @@ handle_toggle_up(JSContext *context,
      * to check if the associated JSObject was reaped. If it was we need to
      * abort mission.
      */
+    TRACE(GJS_TOGGLE_UP(gobj));
+
     if (!gc_already_blocked)
-        gjs_block_gc();
+        gjs_block_gc(JS_GetRuntime(context));
 
     obj = peek_js_obj(gobj);
 
@@ -900,6 +984,9 @@ handle_toggle_up(JSContext *context,
         goto out;
     }
 
+    /* The wrapper is only weakly referenced until it's in the keep alive */
+    gjs_gc_read_barrier(obj);
+
     priv = priv_from_js(context, obj);
 
     gjs_debug_lifecycle(GJS_DEBUG_GOBJECT,
@@ -920,7 +1007,7 @@ handle_toggle_up(JSContext *context,
 
 out:
     if (!gc_already_blocked)
-        gjs_unblock_gc();
+        gjs_unblock_gc(JS_GetRuntime(context));
 }
 
 static gboolean
@@ -951,10 +1038,14 @@ out:
 static void
 toggle_ref_notify_operation_free(ToggleRefNotifyOperation *operation)
 {
+    GjsWrapperState *state;
+
+    state = gjs_runtime_get_wrapper_state(JS_GetRuntime(operation->context));
+
     if (operation->needs_unref)
         g_object_unref (operation->gobj);
     g_slice_free(ToggleRefNotifyOperation, operation);
-    g_atomic_int_add(&pending_idle_toggles, -1);
+    g_atomic_int_add(&state->pending_idle_toggles, -1);
 }
 
 static void
@@ -963,9 +1054,12 @@ queue_toggle_idle(GObject         *gobj,
                   ToggleDirection  direction)
 {
     ToggleRefNotifyOperation *operation;
+    GjsWrapperState *state;
     GQuark qdata_key;
     GSource *source;
 
+    state = gjs_runtime_get_wrapper_state(JS_GetRuntime(context));
+
     operation = g_slice_new0(ToggleRefNotifyOperation);
     operation->context = context;
     operation->direction = direction;
@@ -1004,9 +1098,10 @@ queue_toggle_idle(GObject         *gobj,
                           operation,
                           (GDestroyNotify) toggle_ref_notify_operation_free);
 
-    g_atomic_int_inc(&pending_idle_toggles);
+    g_atomic_int_inc(&state->pending_idle_toggles);
     g_object_set_qdata (gobj, qdata_key, source);
-    g_source_attach (source, NULL);
+    g_source_attach (source,
+                     gjs_runtime_get_main_context(JS_GetRuntime(context)));
 
     /* object qdata is piggy-backing off the main loop's ref of the source */
     g_source_unref (source);
@@ -1043,8 +1138,8 @@ wrapped_gobj_toggle_notify(gpointer      data,
      * is already queued (to maintain ordering constraints) but handle
      * the toggle notify directly when we can (for efficiency reasons)
      */
-    if (gjs_eval_thread == g_thread_self())
-        gc_blocked = gjs_try_block_gc();
+    if (gjs_runtime_get_thread(runtime) == g_thread_self())
+        gc_blocked = gjs_try_block_gc(runtime);
 
     toggle_up_queued = toggle_idle_source_is_queued(gobj, TOGGLE_UP);
     toggle_down_queued = toggle_idle_source_is_queued(gobj, TOGGLE_DOWN);
@@ -1085,18 +1180,21 @@ wrapped_gobj_toggle_notify(gpointer      data,
     }
 
     if (gc_blocked)
-        gjs_unblock_gc();
+        gjs_unblock_gc(runtime);
 }
 
 /* At shutdown, we need to ensure we've cleared the context of any
  * pending toggle references.
  */
 void
-gjs_object_process_pending_toggles (void)
+gjs_object_process_pending_toggles (JSRuntime *runtime)
 {
-    while (g_main_context_pending (NULL) &&
-           g_atomic_int_get (&pending_idle_toggles) > 0) {
-        g_main_context_iteration (NULL, FALSE);
+    GMainContext *main_context = gjs_runtime_get_main_context(runtime);
+    GjsWrapperState *state = gjs_runtime_get_wrapper_state(runtime);
+
+    while (g_main_context_pending (main_context) &&
+           g_atomic_int_get (&state->pending_idle_toggles) > 0) {
+        g_main_context_iteration (main_context, FALSE);
     }
 }
 
@@ -1131,6 +1229,43 @@ init_object_private (JSContext *context,
     return priv;
 }
 
+/* A GObject has a wrapper in at most one runtime at a time, recorded
+ * on it so that it can be found from any thread. Each wrapper needs a
+ * toggle ref, and GObject stops notifying toggle refs as soon as there
+ * are several, which would keep every wrapper rooted for good.
+ *
+ * Returns JS_FALSE, with an exception, if another runtime has @gobj.
+ */
+static JSBool
+claim_gobject(JSContext *context,
+              GObject   *gobj)
+{
+    JSRuntime *runtime = JS_GetRuntime(context);
+    JSRuntime *owner;
+
+    do {
+        if (g_object_replace_qdata(gobj, gjs_object_runtime_quark(),
+                                   NULL, runtime, NULL, NULL))
+            return JS_TRUE;
+
+        /* retry if the other wrapper went away in the meantime */
+        owner = g_object_get_qdata(gobj, gjs_object_runtime_quark());
+    } while (owner == NULL);
+
+    if (owner == runtime)
+        return JS_TRUE;
+
+    gjs_throw(context, "%s %p is already wrapped in the runtime of another thread",
+              G_OBJECT_TYPE_NAME(gobj), gobj);
+    return JS_FALSE;
+}
+
+static void
+release_gobject(GObject *gobj)
+{
+    g_object_set_qdata(gobj, gjs_object_runtime_quark(), NULL);
+}
+
 static void
 associate_js_gobject (JSContext      *context,
                       JSObject       *object,
@@ -1141,6 +1276,7 @@ associate_js_gobject (JSContext      *context,
     priv = priv_from_js(context, object);
     priv->gobj = gobj;
 
+    g_assert(g_object_get_qdata(gobj, gjs_object_runtime_quark()) == JS_GetRuntime(context));
     g_assert(peek_js_obj(gobj) == NULL);
     set_js_obj(gobj, object);
 
@@ -1184,6 +1320,7 @@ object_instance_init (JSContext *context,
     GTypeQuery query;
     JSObject *old_jsobj;
     GObject *gobj;
+    GjsWrapperState *state;
 
     priv = init_object_private(context, *object);
 
@@ -1200,13 +1337,19 @@ object_instance_init (JSContext *context,
        will be popped in gjs_object_custom_init() later
        down.
     */
+    state = gjs_runtime_get_wrapper_state(JS_GetRuntime(context));
     if (g_type_get_qdata(gtype, gjs_is_custom_type_quark()))
-        object_init_list = g_slist_prepend(object_init_list, *object);
+        state->object_init_list = g_slist_prepend(state->object_init_list, *object);
 
     gobj = g_object_newv(gtype, n_params, params);
 
     free_g_params(params, n_params);
 
+    if (!claim_gobject(context, gobj)) {
+        g_object_unref(gobj);
+        return JS_FALSE;
+    }
+
     old_jsobj = peek_js_obj(gobj);
     if (old_jsobj != NULL && old_jsobj != *object) {
         /* g_object_newv returned an object that's already tracked by a JS
@@ -1218,6 +1361,7 @@ object_instance_init (JSContext *context,
          * we're not actually using it, so just let it get collected. Avoiding
          * this would require a non-trivial amount of work.
          * */
+        gjs_gc_read_barrier(old_jsobj);
         *object = old_jsobj;
         g_object_unref(gobj); /* We already own a reference */
         gobj = NULL;
@@ -1291,17 +1435,16 @@ GJS_NATIVE_CONSTRUCTOR_DECLARE(object_instance)
 static void
 invalidate_all_signals(ObjectInstance *priv)
 {
-    GList *iter, *next;
+    ConnectData *cd, *next;
 
-    for (iter = priv->signals; iter; ) {
-        ConnectData *cd = iter->data;
-        next = iter->next;
+    for (cd = priv->signals; cd; ) {
+        next = cd->next;
 
-        /* This will also free cd and iter, through
+        /* This will also free cd, through
            the closure invalidation mechanism */
         g_closure_invalidate(cd->closure);
 
-        iter = next;
+        cd = next;
     }
 }
 
@@ -1310,15 +1453,12 @@ object_instance_trace(JSTracer *tracer,
                       JSObject *obj)
 {
     ObjectInstance *priv;
-    GList *iter;
+    ConnectData *cd;
 
     priv = JS_GetPrivate(obj);
 
-    for (iter = priv->signals; iter; iter = iter->next) {
-        ConnectData *cd = iter->data;
-
+    for (cd = priv->signals; cd; cd = cd->next)
         gjs_closure_trace(cd->closure, tracer);
-    }
 }
 
 static void
@@ -1358,6 +1498,8 @@ object_instance_finalize(JSFreeOp  *fop,
         }
 
         set_js_obj(priv->gobj, NULL);
+        /* before the toggle ref goes, which may finalize gobj */
+        release_gobject(priv->gobj);
         g_object_remove_toggle_ref(priv->gobj, wrapped_gobj_toggle_notify,
                                    fop->runtime);
         priv->gobj = NULL;
@@ -1472,8 +1614,13 @@ signal_connection_invalidated (gpointer  user_data,
 {
     ConnectData *connect_data = user_data;
 
-    connect_data->obj->signals = g_list_delete_link(connect_data->obj->signals,
-                                                    connect_data->link);
+    if (connect_data->prev)
+        connect_data->prev->next = connect_data->next;
+    else
+        connect_data->obj->signals = connect_data->next;
+    if (connect_data->next)
+        connect_data->next->prev = connect_data->prev;
+
     g_slice_free(ConnectData, connect_data);
 }
 
@@ -1545,9 +1692,12 @@ real_connect_func(JSContext *context,
         goto out;
 
     connect_data = g_slice_new(ConnectData);
-    priv->signals = g_list_prepend(priv->signals, connect_data);
     connect_data->obj = priv;
-    connect_data->link = priv->signals;
+    connect_data->prev = NULL;
+    connect_data->next = priv->signals;
+    if (priv->signals)
+        priv->signals->prev = connect_data;
+    priv->signals = connect_data;
     /* This is a weak reference, and will be cleared when the closure is invalidated */
     connect_data->closure = closure;
     g_closure_add_invalidate_notifier(closure, connect_data, signal_connection_invalidated);
@@ -1726,6 +1876,8 @@ emit_func(JSContext *context,
     }
 
     if (!failed) {
+        TRACE(GJS_SIGNAL_EMIT(priv->gobj, (char *) signal_query.signal_name));
+
         g_signal_emitv(instance_and_args, signal_id, signal_detail,
                        &rvalue);
     }
@@ -1787,7 +1939,8 @@ to_string_func(JSContext *context,
 static struct JSClass gjs_object_instance_class = {
     "GObject_Object",
     JSCLASS_HAS_PRIVATE |
-    JSCLASS_NEW_RESOLVE,
+    JSCLASS_NEW_RESOLVE |
+    JSCLASS_IMPLEMENTS_BARRIERS,
     JS_PropertyStub,
     JS_PropertyStub,
     object_instance_get_prop,
@@ -2011,6 +2164,9 @@ gjs_object_from_g_object(JSContext    *context,
     if (gobj == NULL)
         return NULL;
 
+    if (!claim_gobject(context, gobj))
+        return NULL;
+
     obj = peek_js_obj(gobj);
 
     if (obj == NULL) {
@@ -2033,8 +2189,10 @@ gjs_object_from_g_object(JSContext    *context,
 
         JS_EndRequest(context);
 
-        if (obj == NULL)
+        if (obj == NULL) {
+            release_gobject(gobj);
             goto out;
+        }
 
         init_object_private(context, obj);
 
@@ -2045,6 +2203,8 @@ gjs_object_from_g_object(JSContext    *context,
         g_object_unref(gobj);
 
         g_assert(peek_js_obj(gobj) == obj);
+    } else {
+        gjs_gc_read_barrier(obj);
     }
 
  out:
@@ -2230,8 +2390,7 @@ gjs_hook_up_vfunc(JSContext *cx,
     JSObject *object;
     JSObject *function;
     ObjectInstance *priv;
-    GType gtype, info_gtype;
-    GIObjectInfo *info;
+    GType gtype;
     GIVFuncInfo *vfunc;
     gpointer implementor_vtable;
     GIFieldInfo *field_info;
@@ -2248,41 +2407,19 @@ gjs_hook_up_vfunc(JSContext *cx,
 
     priv = priv_from_js(cx, object);
     gtype = priv->gtype;
-    info = priv->info;
-
-    /* find the first class that actually has repository information */
-    info_gtype = gtype;
-    while (!info && info_gtype != G_TYPE_OBJECT) {
-        info_gtype = g_type_parent(info_gtype);
-
-        info = g_irepository_find_by_gtype(g_irepository_get_default(), info_gtype);
-    }
-
-    /* If we don't have 'info', we don't have the base class (GObject).
-     * This is awful, so abort now. */
-    g_assert(info != NULL);
 
     JS_SET_RVAL(cx, vp, JSVAL_VOID);
 
-    vfunc = find_vfunc_on_parent(info, name);
+    vfunc = lookup_vfunc_cached(gtype, name);
 
     if (!vfunc) {
         guint i, n_interfaces;
         GType *interface_list;
-        GIInterfaceInfo *interface;
 
         interface_list = g_type_interfaces(gtype, &n_interfaces);
 
         for (i = 0; i < n_interfaces; i++) {
-            interface = (GIInterfaceInfo*)g_irepository_find_by_gtype(g_irepository_get_default(),
-                                                                      interface_list[i]);
-
-            /* The interface doesn't have to exist -- it could be private
-             * or dynamic. */
-            if (interface)
-                vfunc = g_interface_info_find_vfunc(interface, name);
-
-            g_base_info_unref((GIBaseInfo*)interface);
+            vfunc = lookup_vfunc_cached(interface_list[i], name);
             if (vfunc)
                 break;
         }
@@ -2341,26 +2478,82 @@ hyphen_to_underscore (gchar *string)
     return s;
 }
 
+/* The name a JS-implemented property is stored under on the JS object
+ * is interned on the first access to the property from C, and cached
+ * per runtime so that later accesses don't allocate. Interned strings
+ * are never collected, but they belong to the runtime that interned
+ * them, while the GParamSpec is shared by all of them.
+ */
+static jsid
+get_property_id(JSContext  *context,
+                GParamSpec *pspec)
+{
+    GjsWrapperState *state;
+    jsid *id_p;
+    gchar *underscore_name;
+
+    state = gjs_runtime_get_wrapper_state(JS_GetRuntime(context));
+
+    if (G_UNLIKELY(state->property_ids == NULL))
+        state->property_ids = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+
+    id_p = g_hash_table_lookup(state->property_ids, pspec);
+    if (G_LIKELY(id_p != NULL))
+        return *id_p;
+
+    underscore_name = hyphen_to_underscore((gchar *)pspec->name);
+    id_p = g_new(jsid, 1);
+    *id_p = gjs_intern_string_to_id(context, underscore_name);
+    g_free(underscore_name);
+
+    g_hash_table_insert(state->property_ids, pspec, id_p);
+
+    return *id_p;
+}
+
+/* The context of the runtime wrapping @object, if JS can be called
+ * into for it from this thread.
+ */
+static JSContext *
+get_owner_context(GObject    *object,
+                  GParamSpec *pspec)
+{
+    JSRuntime *runtime;
+
+    runtime = g_object_get_qdata(object, gjs_object_runtime_quark());
+    if (G_UNLIKELY(runtime == NULL)) {
+        g_critical("Property %s of %s accessed while it has no JS object",
+                   pspec->name, G_OBJECT_TYPE_NAME(object));
+        return NULL;
+    }
+
+    if (G_UNLIKELY(gjs_runtime_get_thread(runtime) != g_thread_self())) {
+        g_critical("Property %s of %s accessed from a thread other than the one of its JS object",
+                   pspec->name, G_OBJECT_TYPE_NAME(object));
+        return NULL;
+    }
+
+    return gjs_runtime_get_context(runtime);
+}
+
 static void
 gjs_object_get_gproperty (GObject    *object,
                           guint       property_id,
                           GValue     *value,
                           GParamSpec *pspec)
 {
-    GjsContext *gjs_context;
     JSContext *context;
     JSObject *js_obj;
     jsval jsvalue;
-    gchar *underscore_name;
 
-    gjs_context = gjs_context_get_current();
-    context = gjs_context_get_native_context(gjs_context);
+    context = get_owner_context(object, pspec);
+    if (context == NULL)
+        return;
 
     js_obj = peek_js_obj(object);
+    gjs_gc_read_barrier(js_obj);
 
-    underscore_name = hyphen_to_underscore((gchar *)pspec->name);
-    JS_GetProperty(context, js_obj, underscore_name, &jsvalue);
-    g_free (underscore_name);
+    JS_GetPropertyById(context, js_obj, get_property_id(context, pspec), &jsvalue);
 
     if (!gjs_value_to_g_value(context, jsvalue, value))
         return;
@@ -2372,23 +2565,21 @@ gjs_object_set_gproperty (GObject      *object,
                           const GValue *value,
                           GParamSpec   *pspec)
 {
-    GjsContext *gjs_context;
     JSContext *context;
     JSObject *js_obj;
     jsval jsvalue;
-    gchar *underscore_name;
 
-    gjs_context = gjs_context_get_current();
-    context = gjs_context_get_native_context(gjs_context);
+    context = get_owner_context(object, pspec);
+    if (context == NULL)
+        return;
 
     js_obj = peek_js_obj(object);
+    gjs_gc_read_barrier(js_obj);
 
     if (!gjs_value_from_g_value(context, &jsvalue, value))
         return;
 
-    underscore_name = hyphen_to_underscore((gchar *)pspec->name);
-    JS_SetProperty(context, js_obj, underscore_name, &jsvalue);
-    g_free (underscore_name);
+    JS_SetPropertyById(context, js_obj, get_property_id(context, pspec), &jsvalue);
 }
 
 static void
@@ -2397,24 +2588,30 @@ gjs_object_class_init(GObjectClass *class,
 {
     GPtrArray *properties;
     GType gtype;
+    JSContext *context;
+    GjsWrapperState *state;
     gint i;
 
     gtype = G_OBJECT_CLASS_TYPE (class);
+    context = gjs_context_get_native_context(gjs_context_get_current());
+    state = gjs_runtime_get_wrapper_state(JS_GetRuntime(context));
 
     class->set_property = gjs_object_set_gproperty;
     class->get_property = gjs_object_get_gproperty;
 
-    gjs_eval_thread = g_thread_self();
-
-    properties = gjs_hash_table_for_gsize_lookup (class_init_properties, gtype);
+    /* class_init runs from gjs_register_type(), on the same runtime */
+    properties = NULL;
+    if (state->class_init_properties != NULL)
+        properties = gjs_hash_table_for_gsize_lookup (state->class_init_properties, gtype);
     if (properties != NULL) {
         for (i = 0; i < properties->len; i++) {
             GParamSpec *pspec = properties->pdata[i];
             g_param_spec_set_qdata(pspec, gjs_is_custom_property_quark(), GINT_TO_POINTER(1));
+            get_property_id(context, pspec);
             g_object_class_install_property (class, i+1, pspec);
         }
         
-        gjs_hash_table_for_gsize_remove (class_init_properties, gtype);
+        gjs_hash_table_for_gsize_remove (state->class_init_properties, gtype);
     }
 }
 
@@ -2424,10 +2621,15 @@ gjs_object_custom_init(GTypeInstance *instance,
 {
     GjsContext *gjs_context;
     JSContext *context;
+    GjsWrapperState *state;
     JSObject *object;
     ObjectInstance *priv;
 
-    object = object_init_list->data;
+    gjs_context = gjs_context_get_current();
+    context = gjs_context_get_native_context(gjs_context);
+    state = gjs_runtime_get_wrapper_state(JS_GetRuntime(context));
+
+    object = state->object_init_list->data;
     priv = JS_GetPrivate(object);
 
     if (priv->gtype != G_TYPE_FROM_INSTANCE (instance)) {
@@ -2437,12 +2639,12 @@ gjs_object_custom_init(GTypeInstance *instance,
         return;
     }
 
-    object_init_list = g_slist_delete_link(object_init_list,
-                                           object_init_list);
-
-    gjs_context = gjs_context_get_current();
-    context = gjs_context_get_native_context(gjs_context);
+    state->object_init_list = g_slist_delete_link(state->object_init_list,
+                                                  state->object_init_list);
 
+    /* nothing else can know about an instance being initialized */
+    if (!claim_gobject(context, G_OBJECT (instance)))
+        g_assert_not_reached();
     associate_js_gobject(context, object, G_OBJECT (instance));
 }
 
@@ -2486,6 +2688,7 @@ gjs_register_type(JSContext *cx,
     guint32 i, n_interfaces, n_properties;
     GPtrArray *properties_native = NULL;
     GType *iface_types;
+    GjsWrapperState *state;
     JSBool retval = JS_FALSE;
 
     JS_BeginRequest(cx);
@@ -2562,19 +2765,25 @@ gjs_register_type(JSContext *cx,
     type_info.class_size = query.class_size;
     type_info.instance_size = query.instance_size;
 
+    /* GTypeModule has no locking of its own, and contexts on other
+     * threads may be registering types too.
+     */
     type_module = G_TYPE_MODULE (gjs_type_module_get());
+    g_mutex_lock(&type_module_lock);
     instance_type = g_type_module_register_type(type_module,
                                                 parent_type,
                                                 name,
                                                 &type_info,
                                                 0);
+    g_mutex_unlock(&type_module_lock);
 
     g_free(name);
 
     g_type_set_qdata (instance_type, gjs_is_custom_type_quark(), GINT_TO_POINTER (1));
 
-    if (!class_init_properties)
-        class_init_properties = gjs_hash_table_new_for_gsize ((GDestroyNotify)g_ptr_array_unref);
+    state = gjs_runtime_get_wrapper_state(JS_GetRuntime(cx));
+    if (!state->class_init_properties)
+        state->class_init_properties = gjs_hash_table_new_for_gsize ((GDestroyNotify)g_ptr_array_unref);
     properties_native = g_ptr_array_new_with_free_func ((GDestroyNotify)g_param_spec_unref);
     for (i = 0; i < n_properties; i++) {
         jsval prop_val;
@@ -2592,7 +2801,7 @@ gjs_register_type(JSContext *cx,
             goto out;
         g_ptr_array_add (properties_native, g_param_spec_ref (gjs_g_param_from_param (cx, prop_obj)));
     }
-    gjs_hash_table_for_gsize_insert (class_init_properties, (gsize)instance_type,
+    gjs_hash_table_for_gsize_insert (state->class_init_properties, (gsize)instance_type,
                                      g_ptr_array_ref (properties_native));
 
     for (i = 0; i < n_interfaces; i++)
@@ -2730,5 +2939,11 @@ gjs_define_private_gi_stuff(JSContext *context,
                            6, GJS_MODULE_PROP_FLAGS))
         return JS_FALSE;
 
+    if (!gjs_define_gvariant_stuff(context, module_obj))
+        return JS_FALSE;
+
+    if (!gjs_define_gdbus_stuff(context, module_obj))
+        return JS_FALSE;
+
     return JS_TRUE;
 }
@@ -47,7 +47,7 @@ JSBool    gjs_typecheck_is_object       (JSContext     *context,
                                          JSObject      *obj,
                                          JSBool         throw);
 
-void      gjs_object_process_pending_toggles (void);
+void      gjs_object_process_pending_toggles (JSRuntime *runtime);
 
 G_END_DECLS
 
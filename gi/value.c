@@ -36,6 +36,7 @@
 #include "union.h"
 #include "gtype.h"
 #include "gerror.h"
+#include "gjs_gi_trace.h"
 #include <gjs/gjs-module.h>
 #include <gjs/compat.h>
 #include <gjs/runtime.h>
@@ -49,21 +50,54 @@ static JSBool gjs_value_from_g_value_internal(JSContext    *context,
                                               GSignalQuery *signal_query,
                                               gint          arg_n);
 
+/* Signal closures for the same signal share one GSignalQuery, looked
+ * up at connect time; signal nodes are never freed, so neither are
+ * these.
+ */
+static GMutex signal_queries_lock;
+static GHashTable *signal_queries = NULL;
+
+static GSignalQuery *
+get_signal_query(guint signal_id)
+{
+    GSignalQuery *query;
+
+    g_mutex_lock(&signal_queries_lock);
+
+    if (signal_queries == NULL)
+        signal_queries = g_hash_table_new(NULL, NULL);
+
+    query = g_hash_table_lookup(signal_queries, GUINT_TO_POINTER(signal_id));
+    if (query == NULL) {
+        query = g_new0(GSignalQuery, 1);
+        g_signal_query(signal_id, query);
+
+        if (query->signal_id == 0) {
+            g_free(query);
+            query = NULL;
+        } else {
+            g_hash_table_insert(signal_queries, GUINT_TO_POINTER(signal_id), query);
+        }
+    }
+
+    g_mutex_unlock(&signal_queries_lock);
+
+    return query;
+}
+
 static void
-closure_marshal(GClosure        *closure,
-                GValue          *return_value,
-                guint            n_param_values,
-                const GValue    *param_values,
-                gpointer         invocation_hint,
-                gpointer         marshal_data)
+closure_marshal_internal(GClosure     *closure,
+                         GValue       *return_value,
+                         guint         n_param_values,
+                         const GValue *param_values,
+                         GSignalQuery *signal_query)
 {
     JSRuntime *runtime;
     JSContext *context;
     int argc;
     jsval *argv;
-    jsval rval;
+    jsval *rval;
     int i;
-    GSignalQuery signal_query = { 0, };
 
     gjs_debug_marshal(GJS_DEBUG_GCLOSURE,
                       "Marshal closure %p",
@@ -78,34 +112,16 @@ closure_marshal(GClosure        *closure,
     context = gjs_runtime_get_context(runtime);
     JS_BeginRequest(context);
 
+    /* The arguments and the return value share one traced frame on
+     * the runtime's value stack; the last slot is the return value.
+     */
     argc = n_param_values;
-    rval = JSVAL_VOID;
-    if (argc > 0) {
-        argv = g_newa(jsval, n_param_values);
+    argv = gjs_runtime_push_values(runtime, argc + 1);
+    rval = &argv[argc];
 
-        gjs_set_values(context, argv, argc, JSVAL_VOID);
-        gjs_root_value_locations(context, argv, argc);
-    } else {
-        /* squash a compiler warning */
-        argv = NULL;
-    }
-    JS_AddValueRoot(context, &rval);
-
-    if (marshal_data) {
+    if (signal_query->signal_id) {
         /* we are used for a signal handler */
-        guint signal_id;
-
-        signal_id = GPOINTER_TO_UINT(marshal_data);
-
-        g_signal_query(signal_id, &signal_query);
-
-        if (!signal_query.signal_id) {
-            gjs_debug(GJS_DEBUG_GCLOSURE,
-                      "Signal handler being called on invalid signal");
-            goto cleanup;
-        }
-
-        if (signal_query.n_params + 1 != n_param_values) {
+        if (signal_query->n_params + 1 != n_param_values) {
             gjs_debug(GJS_DEBUG_GCLOSURE,
                       "Signal handler being called with wrong number of parameters");
             goto cleanup;
@@ -118,11 +134,11 @@ closure_marshal(GClosure        *closure,
 
         no_copy = FALSE;
 
-        if (i >= 1 && signal_query.signal_id) {
-            no_copy = (signal_query.param_types[i - 1] & G_SIGNAL_TYPE_STATIC_SCOPE) != 0;
+        if (i >= 1 && signal_query->signal_id) {
+            no_copy = (signal_query->param_types[i - 1] & G_SIGNAL_TYPE_STATIC_SCOPE) != 0;
         }
 
-        if (!gjs_value_from_g_value_internal(context, &argv[i], gval, no_copy, &signal_query, i)) {
+        if (!gjs_value_from_g_value_internal(context, &argv[i], gval, no_copy, signal_query, i)) {
             gjs_debug(GJS_DEBUG_GCLOSURE,
                       "Unable to convert arg %d in order to invoke closure",
                       i);
@@ -131,15 +147,15 @@ closure_marshal(GClosure        *closure,
         }
     }
 
-    gjs_closure_invoke(closure, argc, argv, &rval);
+    gjs_closure_invoke(closure, argc, argv, rval);
 
     if (return_value != NULL) {
-        if (JSVAL_IS_VOID(rval)) {
+        if (JSVAL_IS_VOID(*rval)) {
             /* something went wrong invoking, error should be set already */
             goto cleanup;
         }
 
-        if (!gjs_value_to_g_value(context, rval, return_value)) {
+        if (!gjs_value_to_g_value(context, *rval, return_value)) {
             gjs_debug(GJS_DEBUG_GCLOSURE,
                       "Unable to convert return value when invoking closure");
             gjs_log_exception(context);
@@ -148,12 +164,51 @@ closure_marshal(GClosure        *closure,
     }
 
  cleanup:
-    if (argc > 0)
-        gjs_unroot_value_locations(context, argv, argc);
-    JS_RemoveValueRoot(context, &rval);
+    gjs_runtime_pop_values(runtime, argv, argc + 1);
     JS_EndRequest(context);
 }
 
+static void
+closure_marshal(GClosure        *closure,
+                GValue          *return_value,
+                guint            n_param_values,
+                const GValue    *param_values,
+                gpointer         invocation_hint,
+                gpointer         marshal_data)
+{
+    GSignalQuery no_signal = { 0, };
+
+    closure_marshal_internal(closure, return_value,
+                             n_param_values, param_values,
+                             &no_signal);
+}
+
+/* The shared GSignalQuery rides in closure->data rather than in a meta
+ * marshal, which would cost every connection another notifier.
+ */
+static void
+signal_closure_marshal(GClosure        *closure,
+                       GValue          *return_value,
+                       guint            n_param_values,
+                       const GValue    *param_values,
+                       gpointer         invocation_hint,
+                       gpointer         marshal_data)
+{
+    GSignalQuery *signal_query = closure->data;
+
+    TRACE(GJS_SIGNAL_MARSHAL_ENTRY(closure,
+                                   n_param_values > 0 ? g_value_peek_pointer(&param_values[0]) : NULL,
+                                   (char *) signal_query->signal_name));
+
+    closure_marshal_internal(closure, return_value,
+                             n_param_values, param_values,
+                             signal_query);
+
+    TRACE(GJS_SIGNAL_MARSHAL_RETURN(closure,
+                                    n_param_values > 0 ? g_value_peek_pointer(&param_values[0]) : NULL,
+                                    (char *) signal_query->signal_name));
+}
+
 GClosure*
 gjs_closure_new_for_signal(JSContext  *context,
                            JSObject   *callable,
@@ -161,10 +216,18 @@ gjs_closure_new_for_signal(JSContext  *context,
                            guint       signal_id)
 {
     GClosure *closure;
+    GSignalQuery *signal_query;
+
+    signal_query = get_signal_query(signal_id);
+    if (signal_query == NULL) {
+        gjs_throw(context, "Invalid signal id %u", signal_id);
+        return NULL;
+    }
 
     closure = gjs_closure_new(context, callable, description, FALSE);
 
-    g_closure_set_meta_marshal(closure, GUINT_TO_POINTER(signal_id), closure_marshal);
+    closure->data = signal_query;
+    g_closure_set_marshal(closure, signal_closure_marshal);
 
     return closure;
 }
@@ -33,13 +33,13 @@
 
 G_BEGIN_DECLS
 
-JSBool    gjs_typecheck_bytearray        (JSContext     *context,
-                                          JSObject      *obj,
-                                          JSBool         throw);
-
 JSBool        gjs_define_byte_array_stuff    (JSContext  *context,
                                               JSObject   *in_object);
 
+JSBool        gjs_typecheck_bytearray        (JSContext  *context,
+                                              JSObject   *obj,
+                                              JSBool      throw);
+
 JSObject *    gjs_byte_array_from_byte_array (JSContext  *context,
                                               GByteArray *array);
 JSObject *    gjs_byte_array_from_bytes (JSContext  *context,
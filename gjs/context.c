@@ -34,8 +34,12 @@
 
 #include "gi.h"
 #include "gi/object.h"
+#include "gi/function.h"
+#include "gi/gdbus.h"
+#include "gi/gjs_gi_trace.h"
 
 #include <modules/modules.h>
+#include <modules/worker.h>
 
 #include <util/log.h>
 #include <util/glib.h>
@@ -60,6 +64,8 @@ static void     gjs_context_set_property      (GObject               *object,
                                                   GParamSpec            *pspec);
 static void gjs_on_context_gc (JSRuntime *rt,
                                JSGCStatus status);
+static void gjs_on_context_gc_slice (JSRuntime *rt,
+                                     gboolean   slice_begin);
 
 struct _GjsContext {
     GObject parent;
@@ -382,19 +388,25 @@ gjs_context_dispose(GObject *object)
         gjs_debug(GJS_DEBUG_CONTEXT,
                   "Destroying JS context");
 
+        /* The workers keep their JS object rooted while they run */
+        gjs_worker_terminate_all(js_context->runtime);
+
         /* Do a full GC here before tearing down, since once we do
          * that we may not have the JS_GetPrivate() to access the
          * context
          */
         JS_GC(js_context->runtime);
 
-        gjs_object_process_pending_toggles();
+        gjs_object_process_pending_toggles(js_context->runtime);
+        gjs_function_drop_async_calls(js_context->runtime);
+        gjs_dbus_drop_implementations(js_context->runtime);
 
         JS_DestroyContext(js_context->context);
         js_context->context = NULL;
     }
 
     if (js_context->runtime != NULL) {
+        gjs_gc_set_slice_callback(js_context->runtime, NULL);
         gjs_runtime_deinit(js_context->runtime);
 
         /* Cleans up data as well as destroying the runtime. */
@@ -572,6 +584,16 @@ gjs_context_constructor (GType                  type,
         g_error("Failed to create javascript runtime");
     JS_SetGCParameter(js_context->runtime, JSGC_MAX_BYTES, 0xffffffff);
 
+    /* The wrapper classes with native-to-JS edges (object proxies and
+     * keep-alives) implement write barriers, so marking can be split
+     * into slices and pause times no longer grow with the number of
+     * wrappers that are alive.
+     */
+    if (!g_getenv("GJS_DISABLE_INCREMENTAL_GC")) {
+        JS_SetGCParameter(js_context->runtime, JSGC_MODE, JSGC_MODE_INCREMENTAL);
+        JS_SetGCParameter(js_context->runtime, JSGC_SLICE_TIME_BUDGET, 10);
+    }
+
     js_context->context = JS_NewContext(js_context->runtime, 8192 /* stack chunk size */);
     if (js_context->context == NULL)
         g_error("Failed to create javascript context");
@@ -679,6 +701,7 @@ gjs_context_constructor (GType                  type,
     js_context->profiler = gjs_profiler_new(js_context->runtime);
 
     JS_SetGCCallback(js_context->runtime, gjs_on_context_gc);
+    gjs_gc_set_slice_callback(js_context->runtime, gjs_on_context_gc_slice);
 
     JS_EndRequest(js_context->context);
 
@@ -915,10 +938,10 @@ gjs_on_context_gc (JSRuntime *rt,
 
     switch (status) {
         case JSGC_BEGIN:
-            gjs_enter_gc();
+            TRACE(GJS_GC_BEGIN(rt));
             break;
         case JSGC_END:
-            gjs_leave_gc();
+            TRACE(GJS_GC_END(rt));
             if (gjs_context->gc_notifications_enabled) {
                 g_mutex_lock(&gc_idle_lock);
                 if (gjs_context->idle_emit_gc_id == 0)
@@ -932,6 +955,20 @@ gjs_on_context_gc (JSRuntime *rt,
     }
 }
 
+/* With incremental GC, JSGC_BEGIN and JSGC_END bracket the whole
+ * collection while JS (and so toggle notifications) runs between the
+ * slices, so the GC lock is only held for the duration of each slice.
+ */
+static void
+gjs_on_context_gc_slice (JSRuntime *rt,
+                         gboolean   slice_begin)
+{
+    if (slice_begin)
+        gjs_enter_gc(rt);
+    else
+        gjs_leave_gc(rt);
+}
+
 /**
  * gjs_context_get_all:
  *
@@ -1113,18 +1150,21 @@ gjs_context_define_string_array(GjsContext  *js_context,
     return TRUE;
 }
 
-static GjsContext *current_context;
+/* Each thread can have one context of its own, so that workers can
+ * run a separate runtime next to the one of the main thread.
+ */
+static GPrivate current_context;
 
 GjsContext *
 gjs_context_get_current (void)
 {
-    return current_context;
+    return g_private_get(&current_context);
 }
 
 void
 gjs_context_make_current (GjsContext *context)
 {
-    g_assert (context == NULL || current_context == NULL);
+    g_assert (context == NULL || g_private_get(&current_context) == NULL);
 
-    current_context = context;
+    g_private_set(&current_context, context);
 }
@@ -31,14 +31,35 @@
 #include <gjs/compat.h>
 #include <gjs/runtime.h>
 
+#include "gi/gjs_gi_trace.h"
+
+#include <gio/gio.h>
 #include <string.h>
 
 #define MODULE_INIT_FILENAME "__init__.js"
 
 static char **gjs_search_path = NULL;
 
+/* What a name in the search path resolves to; the rules are the same
+ * as the path walk that do_import() used to do for every new name:
+ * directories of that name are merged into one sub-importer, unless a
+ * NAME.js file was found in an earlier (or the same) path element
+ * before any directory.
+ */
+typedef struct {
+    char *file_path;
+    GPtrArray *directories;
+    guint is_native : 1; /* a NAME.so exists, only used for enumeration */
+} ImportEntry;
+
 typedef struct {
     gboolean is_root;
+
+    /* Resolution index, built from one listing of each directory
+     * in search_path; see importer_ensure_index().
+     */
+    char **search_path;
+    GHashTable *index;
 } Importer;
 
 typedef struct {
@@ -251,6 +272,8 @@ import_native_file(JSContext  *context,
     if (!define_import(context, obj, module_obj, name))
         return JS_FALSE;
 
+    TRACE(GJS_IMPORT_BEGIN((char *) name));
+
     if (!define_meta_properties(context, module_obj, NULL, name, obj))
         goto out;
 
@@ -266,6 +289,8 @@ import_native_file(JSContext  *context,
     retval = JS_TRUE;
 
  out:
+    TRACE(GJS_IMPORT_END((char *) name, retval));
+
     if (!retval)
         cancel_import(context, obj, name);
 
@@ -428,6 +453,8 @@ import_file(JSContext  *context,
     if (!define_import(context, obj, module_obj, name))
         return JS_FALSE;
 
+    TRACE(GJS_IMPORT_BEGIN((char *) full_path));
+
     if (!define_meta_properties(context, module_obj, full_path, name, obj))
         goto out;
 
@@ -484,28 +511,453 @@ import_file(JSContext  *context,
     retval = JS_TRUE;
 
  out:
+    TRACE(GJS_IMPORT_END((char *) full_path, retval));
+
     if (!retval)
         cancel_import(context, obj, name);
 
     return retval;
 }
 
+/* Lazy imports
+ *
+ * With GJS_LAZY_IMPORTS set in the environment, importing a NAME.js file
+ * does not evaluate it. The importer property is defined right away to
+ * a stub module object, the file contents are read on a worker thread,
+ * and the module body is evaluated into the stub the first time one of
+ * its properties is looked up or it is enumerated. Since the stub is
+ * the module object itself, references taken before evaluation stay
+ * valid. Errors from loading or evaluating the module are thrown at
+ * that first use instead of at import time.
+ *
+ * This changes what an import means for modules that are only imported
+ * for their side effects: a module none of whose properties is ever
+ * used is never evaluated at all, so such imports must touch the module
+ * (or not be made with GJS_LAZY_IMPORTS set) for the side effects to
+ * happen.
+ *
+ * Only the read is moved off the JS thread: SpiderMonkey 17 can't
+ * compile a script outside of the runtime that will run it.
+ */
+
+typedef enum {
+    LAZY_MODULE_INITIALIZING,
+    LAZY_MODULE_PENDING,
+    LAZY_MODULE_EVALUATING,
+    LAZY_MODULE_EVALUATED,
+    LAZY_MODULE_FAILED
+} LazyModuleState;
+
+typedef struct {
+    volatile gint ref_count;
+
+    char *name;
+    char *full_path;
+    LazyModuleState state; /* only touched on the JS thread */
+
+    /* Written by the reader thread */
+    GMutex lock;
+    GCond cond;
+    gboolean read_done;
+    char *script;
+    gsize script_len;
+    GError *error;
+} LazyModule;
+
+static struct JSClass gjs_lazy_module_class;
+static GThreadPool *lazy_module_read_pool = NULL;
+
+static gboolean
+lazy_imports_enabled(void)
+{
+    static gsize enabled = 0;
+
+    if (g_once_init_enter(&enabled))
+        g_once_init_leave(&enabled, g_getenv("GJS_LAZY_IMPORTS") ? 2 : 1);
+
+    return enabled == 2;
+}
+
+static LazyModule *
+lazy_module_ref(LazyModule *lazy)
+{
+    g_atomic_int_inc(&lazy->ref_count);
+    return lazy;
+}
+
+static void
+lazy_module_unref(LazyModule *lazy)
+{
+    if (!g_atomic_int_dec_and_test(&lazy->ref_count))
+        return;
+
+    g_free(lazy->name);
+    g_free(lazy->full_path);
+    g_free(lazy->script);
+    g_clear_error(&lazy->error);
+    g_mutex_clear(&lazy->lock);
+    g_cond_clear(&lazy->cond);
+    g_slice_free(LazyModule, lazy);
+}
+
+static void
+lazy_module_read_thread(gpointer data,
+                        gpointer user_data)
+{
+    LazyModule *lazy = data;
+    char *script = NULL;
+    gsize script_len = 0;
+    GError *error = NULL;
+
+    g_file_get_contents(lazy->full_path, &script, &script_len, &error);
+
+    g_mutex_lock(&lazy->lock);
+    lazy->script = script;
+    lazy->script_len = script_len;
+    lazy->error = error;
+    lazy->read_done = TRUE;
+    g_cond_signal(&lazy->cond);
+    g_mutex_unlock(&lazy->lock);
+
+    lazy_module_unref(lazy);
+}
+
 static JSBool
-do_import(JSContext  *context,
-          JSObject   *obj,
-          Importer   *priv,
-          const char *name)
+lazy_module_evaluate(JSContext  *context,
+                     JSObject   *module_obj,
+                     LazyModule *lazy)
+{
+    char *script;
+    gsize script_len;
+    GError *error;
+    jsval script_retval;
+
+    if (lazy->state == LAZY_MODULE_FAILED) {
+        gjs_throw(context, "Module '%s' failed to load", lazy->name);
+        return JS_FALSE;
+    }
+
+    if (lazy->state != LAZY_MODULE_PENDING)
+        return JS_TRUE;
+
+    lazy->state = LAZY_MODULE_EVALUATING;
+
+    g_mutex_lock(&lazy->lock);
+    while (!lazy->read_done)
+        g_cond_wait(&lazy->cond, &lazy->lock);
+    script = lazy->script;
+    script_len = lazy->script_len;
+    error = lazy->error;
+    lazy->script = NULL;
+    lazy->error = NULL;
+    g_mutex_unlock(&lazy->lock);
+
+    if (script == NULL) {
+        lazy->state = LAZY_MODULE_FAILED;
+        gjs_throw_g_error(context, error);
+        return JS_FALSE;
+    }
+
+    gjs_debug(GJS_DEBUG_IMPORTER,
+              "Evaluating lazily imported '%s'", lazy->full_path);
+
+    TRACE(GJS_IMPORT_BEGIN(lazy->full_path));
+
+    if (!JS_EvaluateScript(context,
+                           module_obj,
+                           script,
+                           script_len,
+                           lazy->full_path,
+                           1, /* line number */
+                           &script_retval)) {
+        g_free(script);
+        lazy->state = LAZY_MODULE_FAILED;
+        TRACE(GJS_IMPORT_END(lazy->full_path, FALSE));
+
+        if (JS_IsExceptionPending(context)) {
+            gjs_debug(GJS_DEBUG_IMPORTER,
+                      "Module '%s' left an exception set",
+                      lazy->name);
+            gjs_log_and_keep_exception(context);
+        } else {
+            gjs_throw(context,
+                      "JS_EvaluateScript() returned FALSE but did not set exception");
+        }
+
+        return JS_FALSE;
+    }
+
+    g_free(script);
+    lazy->state = LAZY_MODULE_EVALUATED;
+    TRACE(GJS_IMPORT_END(lazy->full_path, TRUE));
+
+    return JS_TRUE;
+}
+
+static JSBool
+lazy_module_new_resolve(JSContext *context,
+                        JSObject **obj,
+                        jsid      *id,
+                        unsigned   flags,
+                        JSObject **objp)
+{
+    LazyModule *lazy;
+    JSBool found;
+
+    *objp = NULL;
+
+    lazy = JS_GetPrivate(*obj);
+
+    /* Lookups made by the module body itself while it is being
+     * evaluated must fall through to the global.
+     */
+    if (lazy == NULL ||
+        lazy->state == LAZY_MODULE_INITIALIZING ||
+        lazy->state == LAZY_MODULE_EVALUATING ||
+        lazy->state == LAZY_MODULE_EVALUATED)
+        return JS_TRUE;
+
+    if (!lazy_module_evaluate(context, *obj, lazy))
+        return JS_FALSE;
+
+    if (!JS_AlreadyHasOwnPropertyById(context, *obj, *id, &found))
+        return JS_FALSE;
+
+    if (found)
+        *objp = *obj;
+
+    return JS_TRUE;
+}
+
+static JSBool
+lazy_module_enumerate(JSContext *context,
+                      JSObject  *obj)
+{
+    LazyModule *lazy;
+
+    lazy = JS_GetPrivate(obj);
+
+    if (lazy == NULL || lazy->state != LAZY_MODULE_PENDING)
+        return JS_TRUE;
+
+    return lazy_module_evaluate(context, obj, lazy);
+}
+
+static void
+lazy_module_finalize(JSFreeOp *fop,
+                     JSObject *obj)
+{
+    LazyModule *lazy;
+
+    lazy = JS_GetPrivate(obj);
+    if (lazy == NULL)
+        return;
+
+    lazy_module_unref(lazy);
+}
+
+static struct JSClass gjs_lazy_module_class = {
+    "GjsLazyModule",
+    JSCLASS_HAS_PRIVATE |
+    JSCLASS_NEW_RESOLVE,
+    JS_PropertyStub,
+    JS_PropertyStub,
+    JS_PropertyStub,
+    JS_StrictPropertyStub,
+    lazy_module_enumerate,
+    (JSResolveOp) lazy_module_new_resolve, /* needs cast since it's the new resolve signature */
+    JS_ConvertStub,
+    lazy_module_finalize,
+    JSCLASS_NO_OPTIONAL_MEMBERS
+};
+
+static JSBool
+import_file_lazy(JSContext  *context,
+                 JSObject   *obj,
+                 const char *name,
+                 const char *full_path)
+{
+    JSObject *module_obj;
+    LazyModule *lazy;
+    JSBool retval = JS_FALSE;
+
+    gjs_debug(GJS_DEBUG_IMPORTER,
+              "Lazily importing '%s'", full_path);
+
+    module_obj = JS_NewObject(context, &gjs_lazy_module_class, NULL,
+                              gjs_get_import_global(context));
+    if (module_obj == NULL)
+        return JS_FALSE;
+
+    lazy = g_slice_new0(LazyModule);
+    lazy->ref_count = 1;
+    lazy->name = g_strdup(name);
+    lazy->full_path = g_strdup(full_path);
+    lazy->state = LAZY_MODULE_INITIALIZING;
+    g_mutex_init(&lazy->lock);
+    g_cond_init(&lazy->cond);
+    JS_SetPrivate(module_obj, lazy);
+
+    if (!define_import(context, obj, module_obj, name))
+        return JS_FALSE;
+
+    if (!define_meta_properties(context, module_obj, full_path, name, obj))
+        goto out;
+
+    /* shared by the contexts of all threads */
+    if (g_once_init_enter(&lazy_module_read_pool))
+        g_once_init_leave(&lazy_module_read_pool,
+                          g_thread_pool_new(lazy_module_read_thread, NULL,
+                                            4, FALSE, NULL));
+
+    g_thread_pool_push(lazy_module_read_pool, lazy_module_ref(lazy), NULL);
+    lazy->state = LAZY_MODULE_PENDING;
+
+    if (!seal_import(context, obj, name))
+        goto out;
+
+    retval = JS_TRUE;
+
+ out:
+    if (!retval)
+        cancel_import(context, obj, name);
+
+    return retval;
+}
+
+static void
+import_entry_free(gpointer data)
+{
+    ImportEntry *entry = data;
+
+    g_free(entry->file_path);
+    if (entry->directories)
+        g_ptr_array_free(entry->directories, TRUE);
+    g_slice_free(ImportEntry, entry);
+}
+
+static ImportEntry *
+index_get_entry(GHashTable *index,
+                const char *name)
+{
+    ImportEntry *entry;
+
+    entry = g_hash_table_lookup(index, name);
+    if (entry == NULL) {
+        entry = g_slice_new0(ImportEntry);
+        g_hash_table_insert(index, g_strdup(name), entry);
+    }
+
+    return entry;
+}
+
+static void
+index_add_directory(GHashTable *index,
+                    const char *dirname)
+{
+    GFile *dir;
+    GFileEnumerator *enumerator;
+    GFileInfo *info;
+    GPtrArray *infos;
+    guint i;
+
+    /* Only ask for name and type, so that the type can come from
+     * readdir() instead of a stat() per entry.
+     */
+    dir = g_file_new_for_path(dirname);
+    enumerator = g_file_enumerate_children(dir,
+                                           G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                                           G_FILE_ATTRIBUTE_STANDARD_TYPE,
+                                           G_FILE_QUERY_INFO_NONE,
+                                           NULL, NULL);
+    g_object_unref(dir);
+
+    if (enumerator == NULL) {
+        gjs_debug(GJS_DEBUG_IMPORTER,
+                  "Search path element '%s' can't be listed, skipping",
+                  dirname);
+        return;
+    }
+
+    infos = g_ptr_array_new_with_free_func(g_object_unref);
+    while ((info = g_file_enumerator_next_file(enumerator, NULL, NULL)) != NULL) {
+        /* skip hidden files and directories (.svn, .git, ...) */
+        if (g_file_info_get_name(info)[0] == '.')
+            g_object_unref(info);
+        else
+            g_ptr_array_add(infos, info);
+    }
+
+    /* Directories first: within one path element, a directory shadows
+     * a file of the same name.
+     */
+    for (i = 0; i < infos->len; i++) {
+        const char *filename;
+        ImportEntry *entry;
+
+        info = g_ptr_array_index(infos, i);
+        if (g_file_info_get_file_type(info) != G_FILE_TYPE_DIRECTORY)
+            continue;
+
+        filename = g_file_info_get_name(info);
+        entry = index_get_entry(index, filename);
+
+        if (entry->file_path == NULL) {
+            if (entry->directories == NULL)
+                entry->directories = g_ptr_array_new_with_free_func(g_free);
+            g_ptr_array_add(entry->directories,
+                            g_build_filename(dirname, filename, NULL));
+        }
+    }
+
+    for (i = 0; i < infos->len; i++) {
+        const char *filename;
+        ImportEntry *entry;
+        char *name;
+
+        info = g_ptr_array_index(infos, i);
+        if (g_file_info_get_file_type(info) == G_FILE_TYPE_DIRECTORY)
+            continue;
+
+        filename = g_file_info_get_name(info);
+
+        if (g_str_has_suffix(filename, ".js") &&
+            strcmp(filename, MODULE_INIT_FILENAME) != 0) {
+            name = g_strndup(filename, strlen(filename) - 3);
+
+            entry = index_get_entry(index, name);
+            if (entry->file_path == NULL && entry->directories == NULL)
+                entry->file_path = g_build_filename(dirname, filename, NULL);
+
+            g_free(name);
+        } else if (g_str_has_suffix(filename, "."G_MODULE_SUFFIX)) {
+            name = g_strndup(filename,
+                             strlen(filename) - strlen("."G_MODULE_SUFFIX));
+
+            entry = index_get_entry(index, name);
+            entry->is_native = TRUE;
+
+            g_free(name);
+        }
+    }
+
+    g_ptr_array_free(infos, TRUE);
+    g_object_unref(enumerator);
+}
+
+/* Reads the importer's searchPath property into a newly-allocated
+ * string vector, skipping holes and empty elements.
+ */
+static JSBool
+get_search_path(JSContext  *context,
+                JSObject   *obj,
+                char     ***search_path_p)
 {
-    char *filename;
-    char *full_path;
-    char *dirname = NULL;
     jsval search_path_val;
     JSObject *search_path;
-    JSObject *module_obj = NULL;
     guint32 search_path_len;
     guint32 i;
-    JSBool result;
-    GPtrArray *directories;
+    GPtrArray *dirs;
     jsid search_path_name;
 
     search_path_name = gjs_runtime_get_const_string(JS_GetRuntime(context),
@@ -531,23 +983,10 @@ do_import(JSContext  *context,
         return JS_FALSE;
     }
 
-    result = JS_FALSE;
-
-    filename = g_strdup_printf("%s.js", name);
-    full_path = NULL;
-    directories = NULL;
-
-    /* First try importing an internal module like byteArray */
-    if (priv->is_root &&
-        gjs_is_registered_native_module(context, obj, name) &&
-        import_native_file(context, obj, name)) {
-        gjs_debug(GJS_DEBUG_IMPORTER,
-                  "successfully imported module '%s'", name);
-        result = JS_TRUE;
-        goto out;
-    }
+    dirs = g_ptr_array_new();
 
     for (i = 0; i < search_path_len; ++i) {
+        char *dirname;
         jsval elem;
 
         elem = JSVAL_VOID;
@@ -555,7 +994,7 @@ do_import(JSContext  *context,
             /* this means there was an exception, while elem == JSVAL_VOID
              * means no element found
              */
-            goto out;
+            goto fail;
         }
 
         if (JSVAL_IS_VOID(elem))
@@ -563,125 +1002,213 @@ do_import(JSContext  *context,
 
         if (!JSVAL_IS_STRING(elem)) {
             gjs_throw(context, "importer searchPath contains non-string");
-            goto out;
+            goto fail;
         }
 
-        g_free(dirname);
-        dirname = NULL;
-
         if (!gjs_string_to_utf8(context, elem, &dirname))
-            goto out; /* Error message already set */
+            goto fail; /* Error message already set */
 
         /* Ignore empty path elements */
-        if (dirname[0] == '\0')
+        if (dirname[0] == '\0') {
+            g_free(dirname);
             continue;
+        }
 
-        /* Try importing __init__.js and loading the symbol from it */
-        if (full_path)
-            g_free(full_path);
-        full_path = g_build_filename(dirname, MODULE_INIT_FILENAME,
-                                     NULL);
+        g_ptr_array_add(dirs, dirname);
+    }
 
-        module_obj = load_module_init(context, obj, full_path);
-        if (module_obj != NULL) {
-            jsval obj_val;
-
-            if (JS_GetProperty(context,
-                               module_obj,
-                               name,
-                               &obj_val)) {
-                if (!JSVAL_IS_VOID(obj_val) &&
-                    JS_DefineProperty(context, obj,
-                                      name, obj_val,
-                                      NULL, NULL,
-                                      GJS_MODULE_PROP_FLAGS & ~JSPROP_PERMANENT)) {
-                    result = JS_TRUE;
-                    goto out;
-                }
-            }
-        }
+    g_ptr_array_add(dirs, NULL);
+    *search_path_p = (char**) g_ptr_array_free(dirs, FALSE);
+    return JS_TRUE;
 
-        /* Second try importing a directory (a sub-importer) */
-        if (full_path)
-            g_free(full_path);
-        full_path = g_build_filename(dirname, name,
-                                     NULL);
+ fail:
+    g_ptr_array_add(dirs, NULL);
+    g_strfreev((char**) g_ptr_array_free(dirs, FALSE));
+    return JS_FALSE;
+}
 
-        if (g_file_test(full_path, G_FILE_TEST_IS_DIR)) {
-            gjs_debug(GJS_DEBUG_IMPORTER,
-                      "Adding directory '%s' to child importer '%s'",
-                      full_path, name);
-            if (directories == NULL) {
-                directories = g_ptr_array_new();
-            }
-            g_ptr_array_add(directories, full_path);
-            /* don't free it twice - pass ownership to ptr array */
-            full_path = NULL;
-        }
+static gboolean
+search_path_equal(char **a,
+                  char **b)
+{
+    if (a == NULL || b == NULL)
+        return a == b;
 
-        /* If we just added to directories, we know we don't need to
-         * check for a file.  If we added to directories on an earlier
-         * iteration, we want to ignore any files later in the
-         * path. So, always skip the rest of the loop block if we have
-         * directories.
-         */
-        if (directories != NULL) {
-            continue;
-        }
+    for (; *a != NULL && *b != NULL; a++, b++) {
+        if (strcmp(*a, *b) != 0)
+            return FALSE;
+    }
 
-        /* Third, if it's not a directory, try importing a file */
-        g_free(full_path);
-        full_path = g_build_filename(dirname, filename,
+    return *a == NULL && *b == NULL;
+}
+
+static void
+importer_drop_index(Importer *priv)
+{
+    if (priv->index != NULL) {
+        g_hash_table_destroy(priv->index);
+        priv->index = NULL;
+    }
+
+    g_strfreev(priv->search_path);
+    priv->search_path = NULL;
+}
+
+/* Makes sure the resolution index matches @search_path, which is taken
+ * over by the importer. Returns TRUE if the index had to be (re)built.
+ * Directories are listed once when the index is built, so lookups do
+ * no file system access; the index is rebuilt when searchPath changes,
+ * or explicitly by the caller when a name can't be found in it.
+ */
+static gboolean
+importer_ensure_index(Importer  *priv,
+                      char     **search_path,
+                      gboolean   force)
+{
+    char **dir;
+
+    if (!force && priv->index != NULL &&
+        search_path_equal(priv->search_path, search_path)) {
+        g_strfreev(search_path);
+        return FALSE;
+    }
+
+    importer_drop_index(priv);
+
+    priv->search_path = search_path;
+    priv->index = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                        g_free, import_entry_free);
+
+    for (dir = search_path; *dir != NULL; dir++)
+        index_add_directory(priv->index, *dir);
+
+    gjs_debug(GJS_DEBUG_IMPORTER,
+              "Built import index with %u names",
+              g_hash_table_size(priv->index));
+
+    return TRUE;
+}
+
+static JSBool
+do_import(JSContext  *context,
+          JSObject   *obj,
+          Importer   *priv,
+          const char *name)
+{
+    char **search_path;
+    char *full_path;
+    JSObject *module_obj = NULL;
+    ImportEntry *entry;
+    gboolean index_is_fresh;
+    JSBool result;
+
+    if (!get_search_path(context, obj, &search_path))
+        return JS_FALSE;
+
+    result = JS_FALSE;
+
+    /* First try importing an internal module like byteArray */
+    if (priv->is_root &&
+        gjs_is_registered_native_module(context, obj, name) &&
+        import_native_file(context, obj, name)) {
+        gjs_debug(GJS_DEBUG_IMPORTER,
+                  "successfully imported module '%s'", name);
+        g_strfreev(search_path);
+        return JS_TRUE;
+    }
+
+    /* Try loading the symbol from __init__.js; the module object is
+     * cached on the importer, so only the first path element is ever
+     * read.
+     */
+    if (search_path[0] != NULL) {
+        full_path = g_build_filename(search_path[0], MODULE_INIT_FILENAME,
                                      NULL);
+        module_obj = load_module_init(context, obj, full_path);
+        g_free(full_path);
+    }
 
-        if (g_file_test(full_path, G_FILE_TEST_EXISTS)) {
-            if (import_file(context, obj, name, full_path)) {
-                gjs_debug(GJS_DEBUG_IMPORTER,
-                          "successfully imported module '%s'", name);
-                result = JS_TRUE;
-            }
+    if (module_obj != NULL) {
+        jsval obj_val;
 
-            /* Don't keep searching path if we fail to load the file for
-             * reasons other than it doesn't exist... i.e. broken files
-             * block searching for nonbroken ones
-             */
-            goto out;
+        if (JS_GetProperty(context,
+                           module_obj,
+                           name,
+                           &obj_val)) {
+            if (!JSVAL_IS_VOID(obj_val) &&
+                JS_DefineProperty(context, obj,
+                                  name, obj_val,
+                                  NULL, NULL,
+                                  GJS_MODULE_PROP_FLAGS & ~JSPROP_PERMANENT)) {
+                g_strfreev(search_path);
+                return JS_TRUE;
+            }
         }
+    }
 
-        gjs_debug(GJS_DEBUG_IMPORTER,
-                  "JS import '%s' not found in %s",
-                  name, dirname);
+    if (JS_IsExceptionPending(context)) {
+        g_strfreev(search_path);
+        return JS_FALSE;
     }
 
-    if (directories != NULL) {
-        /* NULL-terminate the char** */
+    index_is_fresh = importer_ensure_index(priv, search_path, FALSE);
+    entry = g_hash_table_lookup(priv->index, name);
+
+    if ((entry == NULL ||
+         (entry->file_path == NULL && entry->directories == NULL)) &&
+        !index_is_fresh) {
+        /* The module may have been installed after the index was
+         * built; look again before giving up.
+         */
+        importer_ensure_index(priv, g_strdupv(priv->search_path), TRUE);
+        entry = g_hash_table_lookup(priv->index, name);
+    }
+
+    if (entry != NULL && entry->directories != NULL) {
+        GPtrArray *directories;
+        guint i;
+
+        /* gjs_define_importer() may run arbitrary JS that changes our
+         * searchPath and drops the index, so don't hand it our copy.
+         */
+        directories = g_ptr_array_new();
+        for (i = 0; i < entry->directories->len; i++)
+            g_ptr_array_add(directories, g_strdup(g_ptr_array_index(entry->directories, i)));
         g_ptr_array_add(directories, NULL);
 
+        gjs_debug(GJS_DEBUG_IMPORTER,
+                  "Adding %u directories to child importer '%s'",
+                  entry->directories->len, name);
+
         if (import_directory(context, obj, name,
                              (const char**) directories->pdata)) {
             gjs_debug(GJS_DEBUG_IMPORTER,
                       "successfully imported directory '%s'", name);
             result = JS_TRUE;
         }
-    }
 
- out:
-    if (directories != NULL) {
-        char **str_array;
+        g_strfreev((char**) g_ptr_array_free(directories, FALSE));
+    } else if (entry != NULL && entry->file_path != NULL) {
+        full_path = g_strdup(entry->file_path);
 
-        /* NULL-terminate the char**
-         * (maybe for a second time, but doesn't matter)
+        /* Don't keep searching path if we fail to load the file for
+         * reasons other than it doesn't exist... i.e. broken files
+         * block searching for nonbroken ones
          */
-        g_ptr_array_add(directories, NULL);
+        if (lazy_imports_enabled())
+            result = import_file_lazy(context, obj, name, full_path);
+        else
+            result = import_file(context, obj, name, full_path);
 
-        str_array = (char**) directories->pdata;
-        g_ptr_array_free(directories, FALSE);
-        g_strfreev(str_array);
-    }
+        if (result)
+            gjs_debug(GJS_DEBUG_IMPORTER,
+                      "successfully imported module '%s'", name);
 
-    g_free(full_path);
-    g_free(filename);
-    g_free(dirname);
+        g_free(full_path);
+    } else {
+        gjs_debug(GJS_DEBUG_IMPORTER,
+                  "JS import '%s' not found in search path", name);
+    }
 
     if (!result &&
         !JS_IsExceptionPending(context)) {
@@ -741,11 +1268,9 @@ importer_new_enumerate(JSContext  *context,
     case JSENUMERATE_INIT_ALL:
     case JSENUMERATE_INIT: {
         Importer *priv;
-        JSObject *search_path;
-        jsval search_path_val;
-        guint32 search_path_len;
-        guint32 i;
-        jsid search_path_name;
+        char **search_path;
+        GHashTableIter hash_iter;
+        gpointer key, value;
 
         if (state_p)
             *state_p = JSVAL_NULL;
@@ -759,102 +1284,35 @@ importer_new_enumerate(JSContext  *context,
             /* we are enumerating the prototype properties */
             return JS_TRUE;
 
-        search_path_name = gjs_runtime_get_const_string(JS_GetRuntime(context),
-                                                        GJS_STRING_SEARCH_PATH);
-        if (!gjs_object_require_property(context, *object, "importer", search_path_name, &search_path_val))
-            return JS_FALSE;
-
-        if (!JSVAL_IS_OBJECT(search_path_val)) {
-            gjs_throw(context, "searchPath property on importer is not an object");
+        if (!get_search_path(context, *object, &search_path))
             return JS_FALSE;
-        }
-
-        search_path = JSVAL_TO_OBJECT(search_path_val);
-
-        if (!JS_IsArrayObject(context, search_path)) {
-            gjs_throw(context, "searchPath property on importer is not an array");
-            return JS_FALSE;
-        }
-
-        if (!JS_GetArrayLength(context, search_path, &search_path_len)) {
-            gjs_throw(context, "searchPath array has no length");
-            return JS_FALSE;
-        }
 
         iter = importer_iterator_new();
 
-        for (i = 0; i < search_path_len; ++i) {
-            char *dirname = NULL;
+        if (search_path[0] != NULL) {
             char *init_path;
-            const char *filename;
-            jsval elem;
-            GDir *dir = NULL;
-
-            elem = JSVAL_VOID;
-            if (!JS_GetElement(context, search_path, i, &elem)) {
-                /* this means there was an exception, while elem == JSVAL_VOID
-                 * means no element found
-                 */
-                importer_iterator_free(iter);
-                return JS_FALSE;
-            }
-
-            if (JSVAL_IS_VOID(elem))
-                continue;
 
-            if (!JSVAL_IS_STRING(elem)) {
-                gjs_throw(context, "importer searchPath contains non-string");
-                importer_iterator_free(iter);
-                return JS_FALSE;
-            }
-
-            if (!gjs_string_to_utf8(context, elem, &dirname)) {
-                importer_iterator_free(iter);
-                return JS_FALSE; /* Error message already set */
-            }
-
-            init_path = g_build_filename(dirname, MODULE_INIT_FILENAME,
+            init_path = g_build_filename(search_path[0], MODULE_INIT_FILENAME,
                                          NULL);
 
             load_module_elements(context, *object, iter, init_path);
 
             g_free(init_path);
+        }
 
-            dir = g_dir_open(dirname, 0, NULL);
-
-            if (!dir) {
-                g_free(dirname);
-                continue;
-            }
-
-            while ((filename = g_dir_read_name(dir))) {
-                char *full_path;
-
-                /* skip hidden files and directories (.svn, .git, ...) */
-                if (filename[0] == '.')
-                    continue;
-
-                /* skip module init file */
-                if (strcmp(filename, MODULE_INIT_FILENAME) == 0)
-                    continue;
-
-                full_path = g_build_filename(dirname, filename, NULL);
+        /* Enumeration is expected to reflect the file system, so
+         * always start from fresh directory listings.
+         */
+        importer_ensure_index(priv, search_path, TRUE);
 
-                if (g_file_test(full_path, G_FILE_TEST_IS_DIR)) {
-                    g_ptr_array_add(iter->elements, g_strdup(filename));
-                } else {
-                    if (g_str_has_suffix(filename, "."G_MODULE_SUFFIX) ||
-                        g_str_has_suffix(filename, ".js")) {
-                        g_ptr_array_add(iter->elements,
-                                        g_strndup(filename, strlen(filename) - 3));
-                    }
-                }
+        g_hash_table_iter_init(&hash_iter, priv->index);
+        while (g_hash_table_iter_next(&hash_iter, &key, &value)) {
+            ImportEntry *entry = value;
 
-                g_free(full_path);
-            }
-            g_dir_close(dir);
-
-            g_free(dirname);
+            if (entry->directories != NULL ||
+                entry->file_path != NULL ||
+                entry->is_native)
+                g_ptr_array_add(iter->elements, g_strdup(key));
         }
 
         if (state_p)
@@ -982,6 +1440,7 @@ importer_finalize(JSFreeOp *fop,
         return; /* we are the prototype, not a real instance */
 
     GJS_DEC_COUNTER(importer);
+    importer_drop_index(priv);
     g_slice_free(Importer, priv);
 }
 
@@ -1081,9 +1540,9 @@ gjs_get_search_path(void)
 {
     char **search_path;
 
-    /* not thread safe */
+    /* computed once, for the contexts of all threads */
 
-    if (!gjs_search_path) {
+    if (g_once_init_enter(&gjs_search_path)) {
         G_CONST_RETURN gchar* G_CONST_RETURN * system_data_dirs;
         const char *envstr;
         GPtrArray *path;
@@ -1119,7 +1578,7 @@ gjs_get_search_path(void)
 
         search_path = (char**)g_ptr_array_free(path, FALSE);
 
-        gjs_search_path = search_path;
+        g_once_init_leave(&gjs_search_path, search_path);
     } else {
         search_path = gjs_search_path;
     }
@@ -76,6 +76,79 @@ gjs_error_reporter(JSContext     *context,
     g_log(G_LOG_DOMAIN, level, "JS %s: [%s %d]: %s", warning, report->filename, report->lineno, message);
 }
 
+/* Incremental GC */
+
+/* Must be called before a native-to-JS edge traced from a class with
+ * JSCLASS_IMPLEMENTS_BARRIERS is overwritten or dropped, so that an
+ * incremental GC in progress still marks the old target.
+ */
+void
+gjs_gc_write_barrier(JSObject *object)
+{
+    if (object != NULL)
+        js::IncrementalReferenceBarrier(object);
+}
+
+/* Must be called when a wrapper held only weakly from native code (qdata,
+ * a hash table) is handed back to JS or rooted: if an incremental GC is
+ * marking, the wrapper may not have been reached yet and would otherwise be
+ * swept while still in use.
+ */
+void
+gjs_gc_read_barrier(JSObject *object)
+{
+    if (object != NULL)
+        js::IncrementalReferenceBarrier(object);
+}
+
+static void
+gc_slice_callback(JSRuntime                *runtime,
+                  js::GCProgress            progress,
+                  const js::GCDescription  &desc)
+{
+    GjsGCSliceFunc func = gjs_runtime_get_gc_slice_func(runtime);
+
+    if (func == NULL)
+        return;
+
+    switch (progress) {
+    case js::GC_CYCLE_BEGIN:
+    case js::GC_SLICE_BEGIN:
+        func(runtime, TRUE);
+        break;
+    case js::GC_SLICE_END:
+    case js::GC_CYCLE_END:
+        func(runtime, FALSE);
+        break;
+    }
+}
+
+/* @func is called at the start and at the end of every GC slice; unlike
+ * JSGC_BEGIN/JSGC_END, JS code runs between two calls. It is kept with
+ * the runtime, so each runtime can have its own.
+ */
+void
+gjs_gc_set_slice_callback(JSRuntime      *runtime,
+                          GjsGCSliceFunc  func)
+{
+    gjs_runtime_set_gc_slice_func(runtime, func);
+    js::SetGCSliceCallback(runtime, func != NULL ? gc_slice_callback : NULL);
+}
+
+gboolean
+gjs_gc_slice(JSRuntime *runtime,
+             gint64     budget_ms)
+{
+    if (js::IsIncrementalGCInProgress(runtime))
+        js::PrepareForIncrementalGC(runtime);
+    else
+        js::PrepareForFullGC(runtime);
+
+    js::IncrementalGC(runtime, js::gcreason::API, budget_ms);
+
+    return js::IsIncrementalGCInProgress(runtime);
+}
+
 /* ArrayBuffer */
 
 gboolean
@@ -171,6 +244,55 @@ gjs_typed_array_get_length(JSContext *context,
     return (gsize) JS_GetTypedArrayLength(object, context);
 }
 
+gpointer
+gjs_typed_array_get_data(JSContext *context,
+                         JSObject  *object)
+{
+    return JS_GetArrayBufferViewData(object, context);
+}
+
+/* Creates a zero-filled typed array of @length elements whose type is
+ * described like in gjs_typed_array_is_compatible().
+ */
+JSObject *
+gjs_typed_array_new(JSContext *context,
+                    guint      size,
+                    gboolean   is_signed,
+                    gboolean   floating,
+                    guint32    length)
+{
+    if (floating) {
+        switch (size) {
+        case 32:
+            return JS_NewFloat32Array(context, length);
+        case 64:
+            return JS_NewFloat64Array(context, length);
+        default:
+            break;
+        }
+    } else {
+        switch (size) {
+        case 8:
+            return is_signed ?
+                JS_NewInt8Array(context, length) :
+                JS_NewUint8Array(context, length);
+        case 16:
+            return is_signed ?
+                JS_NewInt16Array(context, length) :
+                JS_NewUint16Array(context, length);
+        case 32:
+            return is_signed ?
+                JS_NewInt32Array(context, length) :
+                JS_NewUint32Array(context, length);
+        default:
+            break;
+        }
+    }
+
+    g_assert_not_reached();
+    return NULL;
+}
+
 gboolean
 gjs_typed_array_is_compatible(JSContext *context,
                               JSObject  *object,
@@ -28,37 +28,184 @@
 #include "jsapi-util.h"
 #include "compat.h"
 
-gboolean
-gjs_string_to_utf8 (JSContext  *context,
-                    const jsval value,
-                    char      **utf8_string_p)
+/* Strings are converted a machine word at a time while they're ASCII,
+ * which most strings going through the GI layer are (names, paths,
+ * identifiers); only the others go through the full encoder/decoder.
+ */
+#define ASCII_MASK_8   G_GUINT64_CONSTANT(0x8080808080808080)
+#define ASCII_MASK_16  G_GUINT64_CONSTANT(0xff80ff80ff80ff80)
+
+/* Strings up to this length are widened on the stack */
+#define STACK_STRING_LENGTH 256
+
+static gboolean
+chars_are_ascii(const jschar *chars,
+                gsize         len)
 {
-    JSString *str;
-    gsize len;
-    char *bytes;
+    gsize i = 0;
+    guint64 word;
 
-    JS_BeginRequest(context);
+    for (; i + 4 <= len; i += 4) {
+        memcpy(&word, chars + i, sizeof(word));
+        if (word & ASCII_MASK_16)
+            return FALSE;
+    }
+    for (; i < len; i++) {
+        if (chars[i] >= 0x80)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+bytes_are_ascii(const char *bytes,
+                gsize       len)
+{
+    gsize i = 0;
+    guint64 word;
+
+    for (; i + 8 <= len; i += 8) {
+        memcpy(&word, bytes + i, sizeof(word));
+        if (word & ASCII_MASK_8)
+            return FALSE;
+    }
+    for (; i < len; i++) {
+        if ((guchar) bytes[i] >= 0x80)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* The most UTF-8 bytes @len UTF-16 code units can encode to: three
+ * per unit, surrogate pairs taking four for two.
+ */
+#define UTF8_MAX_LENGTH(len) ((len) * 3)
+
+/* Encodes @chars into @dest, which has room for UTF8_MAX_LENGTH(@len)
+ * bytes, in one pass; returns the length of the result, or -1 and
+ * throws on an unpaired surrogate.
+ */
+static gssize
+encode_utf8(JSContext    *context,
+            const jschar *chars,
+            gsize         len,
+            char         *dest)
+{
+    guchar *out = (guchar *) dest;
+    gsize i;
+
+    for (i = 0; i < len; i++) {
+        gunichar c = chars[i];
+
+        if (c < 0x80) {
+            *out++ = c;
+        } else if (c < 0x800) {
+            *out++ = 0xc0 | (c >> 6);
+            *out++ = 0x80 | (c & 0x3f);
+        } else if (c < 0xd800 || c > 0xdfff) {
+            *out++ = 0xe0 | (c >> 12);
+            *out++ = 0x80 | ((c >> 6) & 0x3f);
+            *out++ = 0x80 | (c & 0x3f);
+        } else if (c < 0xdc00 && i + 1 < len &&
+                   chars[i + 1] >= 0xdc00 && chars[i + 1] <= 0xdfff) {
+            c = 0x10000 + ((c - 0xd800) << 10) + (chars[++i] - 0xdc00);
+            *out++ = 0xf0 | (c >> 18);
+            *out++ = 0x80 | ((c >> 12) & 0x3f);
+            *out++ = 0x80 | ((c >> 6) & 0x3f);
+            *out++ = 0x80 | (c & 0x3f);
+        } else {
+            gjs_throw(context, "Invalid surrogate character 0x%04x in string", c);
+            return -1;
+        }
+    }
+
+    return out - (guchar *) dest;
+}
+
+/* Converts @value into @bytes, allocated with @alloc_func for the
+ * worst case, and returns its length, or -1 with an exception.
+ */
+static gssize
+string_to_utf8_internal(JSContext   *context,
+                        jsval        value,
+                        char       **bytes_p,
+                        gpointer   (*alloc_func) (gpointer, gsize),
+                        gpointer     alloc_data)
+{
+    const jschar *chars;
+    gsize len, i;
+    gssize written;
+    char *bytes;
 
     if (!JSVAL_IS_STRING(value)) {
         gjs_throw(context,
                   "Value is not a string, cannot convert to UTF-8");
-        JS_EndRequest(context);
-        return JS_FALSE;
+        return -1;
+    }
+
+    chars = JS_GetStringCharsAndLength(context, JSVAL_TO_STRING(value), &len);
+    if (chars == NULL)
+        return -1;
+
+    if (chars_are_ascii(chars, len)) {
+        bytes = alloc_func(alloc_data, len + 1);
+        for (i = 0; i < len; i++)
+            bytes[i] = chars[i];
+        written = len;
+    } else {
+        bytes = alloc_func(alloc_data, UTF8_MAX_LENGTH(len) + 1);
+        written = encode_utf8(context, chars, len, bytes);
+        if (written < 0) {
+            *bytes_p = bytes;
+            return -1;
+        }
     }
 
-    str = JSVAL_TO_STRING(value);
+    bytes[written] = '\0';
+    *bytes_p = bytes;
+    return written;
+}
 
-    len = JS_GetStringEncodingLength(context, str);
-    if (len == (gsize)(-1)) {
+static gpointer
+heap_alloc(gpointer data,
+           gsize    size)
+{
+    return g_malloc(size);
+}
+
+static gpointer
+scratch_alloc(gpointer data,
+              gsize    size)
+{
+    return gjs_runtime_scratch_alloc(data, size);
+}
+
+gboolean
+gjs_string_to_utf8 (JSContext  *context,
+                    const jsval value,
+                    char      **utf8_string_p)
+{
+    char *bytes = NULL;
+    gssize len;
+
+    JS_BeginRequest(context);
+
+    len = string_to_utf8_internal(context, value, &bytes, heap_alloc, NULL);
+    if (len < 0) {
+        g_free(bytes);
         JS_EndRequest(context);
         return JS_FALSE;
     }
 
     if (utf8_string_p) {
-        bytes = g_malloc((len + 1) * sizeof(char));
-        JS_EncodeStringToBuffer(str, bytes, len);
-        bytes[len] = '\0';
+        /* Give back what the worst case estimate didn't need */
+        if ((gsize) len > JS_GetStringLength(JSVAL_TO_STRING(value)))
+            bytes = g_realloc(bytes, len + 1);
         *utf8_string_p = bytes;
+    } else {
+        g_free(bytes);
     }
 
     JS_EndRequest(context);
@@ -66,6 +213,34 @@ gjs_string_to_utf8 (JSContext  *context,
     return JS_TRUE;
 }
 
+/**
+ * gjs_string_to_utf8_scratch:
+ * @context: a #JSContext
+ * @value: a string jsval
+ * @utf8_string_p: return location for the UTF-8 string
+ *
+ * Like gjs_string_to_utf8(), but the result is allocated with
+ * gjs_runtime_scratch_alloc() instead of malloc(), for strings that
+ * are only needed for the duration of a call and can be released
+ * with everything else the call allocated. It must not be freed.
+ *
+ * Returns: JS_FALSE if exception thrown
+ */
+JSBool
+gjs_string_to_utf8_scratch(JSContext  *context,
+                           jsval       value,
+                           char      **utf8_string_p)
+{
+    JSBool ret;
+
+    JS_BeginRequest(context);
+    ret = string_to_utf8_internal(context, value, utf8_string_p,
+                                  scratch_alloc, JS_GetRuntime(context)) >= 0;
+    JS_EndRequest(context);
+
+    return ret;
+}
+
 JSBool
 gjs_string_from_utf8(JSContext  *context,
                      const char *utf8_string,
@@ -78,7 +253,35 @@ gjs_string_from_utf8(JSContext  *context,
 
     if (n_bytes < 0)
         n_bytes = strlen(utf8_string);
-    str = JS_NewStringCopyN(context, utf8_string, n_bytes);
+
+    if (!bytes_are_ascii(utf8_string, n_bytes)) {
+        /* Decoded by SpiderMonkey, which validates it as well */
+        str = JS_NewStringCopyN(context, utf8_string, n_bytes);
+    } else if (n_bytes <= STACK_STRING_LENGTH) {
+        jschar chars[STACK_STRING_LENGTH];
+        gssize i;
+
+        for (i = 0; i < n_bytes; i++)
+            chars[i] = (guchar) utf8_string[i];
+        str = JS_NewUCStringCopyN(context, chars, n_bytes);
+    } else {
+        jschar *chars;
+        gssize i;
+
+        /* Handed over to the string, no second copy */
+        chars = JS_malloc(context, (n_bytes + 1) * sizeof(jschar));
+        if (chars == NULL) {
+            str = NULL;
+        } else {
+            for (i = 0; i < n_bytes; i++)
+                chars[i] = (guchar) utf8_string[i];
+            chars[n_bytes] = 0;
+
+            str = JS_NewUCString(context, chars, n_bytes);
+            if (str == NULL)
+                JS_free(context, chars);
+        }
+    }
 
     if (str && value_p)
         *value_p = STRING_TO_JSVAL(str);
@@ -87,6 +290,34 @@ gjs_string_from_utf8(JSContext  *context,
     return str != NULL;
 }
 
+/**
+ * gjs_string_from_static_utf8:
+ * @context: a #JSContext
+ * @static_string: a UTF-8 string that is never freed
+ * @value_p: return location for the string jsval
+ *
+ * Like gjs_string_from_utf8(), for constant strings that come back
+ * over and over, like type names; the string is converted once per
+ * runtime and shared afterwards. See gjs_runtime_get_static_string().
+ *
+ * Returns: JS_FALSE if exception thrown
+ */
+JSBool
+gjs_string_from_static_utf8(JSContext  *context,
+                            const char *static_string,
+                            jsval      *value_p)
+{
+    JSString *str;
+
+    JS_BeginRequest(context);
+    str = gjs_runtime_get_static_string(context, static_string);
+    if (str && value_p)
+        *value_p = STRING_TO_JSVAL(str);
+    JS_EndRequest(context);
+
+    return str != NULL;
+}
+
 gboolean
 gjs_string_to_filename(JSContext    *context,
                        const jsval   filename_val,
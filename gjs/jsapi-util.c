@@ -36,8 +36,6 @@
 #include <string.h>
 #include <math.h>
 
-static GMutex gc_lock;
-
 GQuark
 gjs_util_error_quark (void)
 {
@@ -802,6 +800,32 @@ gjs_value_to_int64  (JSContext  *context,
     }
 }
 
+/* Out-of-line error paths shared by gjs_parse_args() and the inline
+ * GJS_PARSE_ARG() converters, so the messages stay identical.
+ */
+JSBool
+gjs_throw_wrong_n_args(JSContext  *context,
+                       const char *function_name,
+                       unsigned    n_required,
+                       unsigned    argc)
+{
+    gjs_throw(context, "Error invoking %s: Expected %d arguments, got %d", function_name,
+              n_required, argc);
+    return JS_FALSE;
+}
+
+JSBool
+gjs_throw_invalid_arg(JSContext  *context,
+                      const char *function_name,
+                      unsigned    position,
+                      const char *argname,
+                      const char *message)
+{
+    gjs_throw(context, "Error invoking %s, at argument %d (%s): %s", function_name,
+              position, argname, message);
+    return JS_FALSE;
+}
+
 /**
  * gjs_parse_args:
  * @context:
@@ -883,8 +907,7 @@ gjs_parse_args (JSContext  *context,
 
     if (argc < n_required || (argc > n_total && !ignore_trailing_args)) {
         if (n_required == n_total) {
-            gjs_throw(context, "Error invoking %s: Expected %d arguments, got %d", function_name,
-                      n_required, argc);
+            gjs_throw_wrong_n_args(context, function_name, n_required, argc);
         } else {
             gjs_throw(context, "Error invoking %s: Expected minimum %d arguments (and %d optional), got %d", function_name,
                       n_required, n_total - n_required, argc);
@@ -1021,8 +1044,8 @@ gjs_parse_args (JSContext  *context,
 
     got_value:
         if (arg_error_message != NULL) {
-            gjs_throw(context, "Error invoking %s, at argument %d (%s): %s", function_name,
-                      consumed_args+1, argname, arg_error_message);
+            gjs_throw_invalid_arg(context, function_name, consumed_args + 1,
+                                  argname, arg_error_message);
             goto error_unwind;
         }
 
@@ -1117,33 +1140,3 @@ gjs_maybe_gc (JSContext *context)
     }
 #endif
 }
-
-void
-gjs_enter_gc(void)
-{
-    g_mutex_lock(&gc_lock);
-}
-
-void
-gjs_leave_gc(void)
-{
-    g_mutex_unlock(&gc_lock);
-}
-
-gboolean
-gjs_try_block_gc(void)
-{
-    return g_mutex_trylock(&gc_lock);
-}
-
-void
-gjs_block_gc(void)
-{
-    g_mutex_lock(&gc_lock);
-}
-
-void
-gjs_unblock_gc(void)
-{
-    g_mutex_unlock(&gc_lock);
-}
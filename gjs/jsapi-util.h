@@ -307,6 +307,12 @@ JSBool      gjs_string_from_utf8             (JSContext       *context,
                                               const char      *utf8_string,
                                               gssize           n_bytes,
                                               jsval           *value_p);
+JSBool      gjs_string_to_utf8_scratch       (JSContext       *context,
+                                              jsval            value,
+                                              char           **utf8_string_p);
+JSBool      gjs_string_from_static_utf8      (JSContext       *context,
+                                              const char      *static_string,
+                                              jsval           *value_p);
 JSBool      gjs_string_to_filename           (JSContext       *context,
                                               const jsval      string_val,
                                               char           **filename_string_p);
@@ -343,6 +349,148 @@ JSBool      gjs_parse_args                   (JSContext  *context,
                                               jsval     *argv,
                                               ...);
 
+JSBool      gjs_throw_wrong_n_args           (JSContext  *context,
+                                              const char *function_name,
+                                              unsigned    n_required,
+                                              unsigned    argc);
+JSBool      gjs_throw_invalid_arg            (JSContext  *context,
+                                              const char *function_name,
+                                              unsigned    position,
+                                              const char *argname,
+                                              const char *message);
+
+/*
+ * Compile-time counterparts of gjs_parse_args(), for hot native
+ * functions taking a fixed list of arguments.  The format character
+ * is pasted into the name of an inline converter instead of being
+ * interpreted at runtime, so a "ff" signature turns into two number
+ * conversions with no va_list and no format walk:
+ *
+ *   if (!GJS_CHECK_N_ARGS(context, "lineTo", argc, 2) ||
+ *       !GJS_PARSE_ARG(context, "lineTo", f, argv, 0, "x", &x) ||
+ *       !GJS_PARSE_ARG(context, "lineTo", f, argv, 1, "y", &y))
+ *       return JS_FALSE;
+ *
+ * Only b, o, i, u and f are supported; anything that allocates or is
+ * optional goes through gjs_parse_args().  Error messages are the same
+ * as the ones gjs_parse_args() produces.
+ */
+#define GJS_CHECK_N_ARGS(context, function_name, argc, n)                     \
+    (G_LIKELY((argc) == (n)) ||                                               \
+     gjs_throw_wrong_n_args((context), (function_name), (n), (argc)))
+
+#define GJS_PARSE_ARG(context, function_name, fmt, argv, i, argname, location) \
+    _gjs_parse_arg_##fmt((context), (function_name), (argv)[i], (i),          \
+                         (argname), (location))
+
+#define GJS_ARG_CTYPE(fmt) _GJS_ARG_CTYPE_##fmt
+#define _GJS_ARG_CTYPE_b gboolean
+#define _GJS_ARG_CTYPE_o JSObject *
+#define _GJS_ARG_CTYPE_i gint32
+#define _GJS_ARG_CTYPE_u guint32
+#define _GJS_ARG_CTYPE_f double
+
+static inline JSBool
+_gjs_parse_arg_b(JSContext  *context,
+                 const char *function_name,
+                 jsval       value,
+                 unsigned    i,
+                 const char *argname,
+                 gboolean   *location)
+{
+    if (G_UNLIKELY(!JSVAL_IS_BOOLEAN(value)))
+        return gjs_throw_invalid_arg(context, function_name, i + 1, argname,
+                                     "Not a boolean");
+    *location = JSVAL_TO_BOOLEAN(value);
+    return JS_TRUE;
+}
+
+static inline JSBool
+_gjs_parse_arg_o(JSContext  *context,
+                 const char *function_name,
+                 jsval       value,
+                 unsigned    i,
+                 const char *argname,
+                 JSObject  **location)
+{
+    if (G_UNLIKELY(!JSVAL_IS_OBJECT(value)))
+        return gjs_throw_invalid_arg(context, function_name, i + 1, argname,
+                                     "Not an object");
+    *location = JSVAL_TO_OBJECT(value);
+    return JS_TRUE;
+}
+
+static inline JSBool
+_gjs_parse_arg_i(JSContext  *context,
+                 const char *function_name,
+                 jsval       value,
+                 unsigned    i,
+                 const char *argname,
+                 gint32     *location)
+{
+    if (G_LIKELY(JSVAL_IS_INT(value))) {
+        *location = JSVAL_TO_INT(value);
+        return JS_TRUE;
+    }
+    if (!JS_ValueToInt32(context, value, location)) {
+        /* Our error message is going to be more useful */
+        JS_ClearPendingException(context);
+        return gjs_throw_invalid_arg(context, function_name, i + 1, argname,
+                                     "Couldn't convert to integer");
+    }
+    return JS_TRUE;
+}
+
+static inline JSBool
+_gjs_parse_arg_u(JSContext  *context,
+                 const char *function_name,
+                 jsval       value,
+                 unsigned    i,
+                 const char *argname,
+                 guint32    *location)
+{
+    double num;
+
+    if (G_LIKELY(JSVAL_IS_INT(value))) {
+        num = JSVAL_TO_INT(value);
+    } else if (JSVAL_IS_DOUBLE(value)) {
+        num = JSVAL_TO_DOUBLE(value);
+    } else if (!JS_ValueToNumber(context, value, &num)) {
+        JS_ClearPendingException(context);
+        return gjs_throw_invalid_arg(context, function_name, i + 1, argname,
+                                     "Couldn't convert to unsigned integer");
+    }
+    if (G_UNLIKELY(num > G_MAXUINT32 || num < 0))
+        return gjs_throw_invalid_arg(context, function_name, i + 1, argname,
+                                     "Value is out of range");
+    *location = num;
+    return JS_TRUE;
+}
+
+static inline JSBool
+_gjs_parse_arg_f(JSContext  *context,
+                 const char *function_name,
+                 jsval       value,
+                 unsigned    i,
+                 const char *argname,
+                 double     *location)
+{
+    if (G_LIKELY(JSVAL_IS_DOUBLE(value))) {
+        *location = JSVAL_TO_DOUBLE(value);
+        return JS_TRUE;
+    }
+    if (JSVAL_IS_INT(value)) {
+        *location = JSVAL_TO_INT(value);
+        return JS_TRUE;
+    }
+    if (!JS_ValueToNumber(context, value, location)) {
+        JS_ClearPendingException(context);
+        return gjs_throw_invalid_arg(context, function_name, i + 1, argname,
+                                     "Couldn't convert to double");
+    }
+    return JS_TRUE;
+}
+
 GjsRootedArray*   gjs_rooted_array_new        (void);
 void              gjs_rooted_array_append     (JSContext        *context,
                                                GjsRootedArray *array,
@@ -396,6 +544,13 @@ gpointer          gjs_typed_array_get_double_data (JSContext    *context,
                                                    JSObject     *object);
 gsize             gjs_typed_array_get_length      (JSContext    *context,
                                                    JSObject     *object);
+gpointer          gjs_typed_array_get_data        (JSContext    *context,
+                                                   JSObject     *object);
+JSObject *        gjs_typed_array_new             (JSContext    *context,
+                                                   guint         size,
+                                                   gboolean      is_signed,
+                                                   gboolean      floating,
+                                                   guint32       length);
 gboolean          gjs_typed_array_is_compatible   (JSContext    *context,
                                                    JSObject     *object,
                                                    guint         size,
@@ -405,11 +560,10 @@ gboolean          gjs_typed_array_is_compatible   (JSContext    *context,
 /* Functions intended for more "internal" use */
 
 void gjs_maybe_gc (JSContext *context);
-void gjs_enter_gc (void);
-void gjs_leave_gc (void);
-gboolean gjs_try_block_gc (void);
-void gjs_block_gc (void);
-void gjs_unblock_gc (void);
+void gjs_gc_write_barrier (JSObject *object);
+void gjs_gc_read_barrier (JSObject *object);
+void gjs_gc_set_slice_callback (JSRuntime *runtime, GjsGCSliceFunc func);
+gboolean gjs_gc_slice (JSRuntime *runtime, gint64 budget_ms);
 
 JSBool            gjs_context_get_frame_info (JSContext  *context,
                                               jsval      *stack,
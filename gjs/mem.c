@@ -28,7 +28,7 @@
 #include <util/log.h>
 
 #define GJS_DEFINE_COUNTER(name)             \
-    GjsMemCounter gjs_counter_ ## name = { \
+    __thread GjsMemCounter gjs_counter_ ## name = { \
         0, #name                                \
     };
 
@@ -53,27 +53,29 @@ GJS_DEFINE_COUNTER(interface)
 #define GJS_LIST_COUNTER(name) \
     & gjs_counter_ ## name
 
-static GjsMemCounter* counters[] = {
-    GJS_LIST_COUNTER(boxed),
-    GJS_LIST_COUNTER(gerror),
-    GJS_LIST_COUNTER(closure),
-    GJS_LIST_COUNTER(database),
-    GJS_LIST_COUNTER(function),
-    GJS_LIST_COUNTER(fundamental),
-    GJS_LIST_COUNTER(importer),
-    GJS_LIST_COUNTER(ns),
-    GJS_LIST_COUNTER(object),
-    GJS_LIST_COUNTER(param),
-    GJS_LIST_COUNTER(repo),
-    GJS_LIST_COUNTER(resultset),
-    GJS_LIST_COUNTER(weakhash),
-    GJS_LIST_COUNTER(interface)
-};
-
 void
 gjs_memory_report(const char *where,
                   gboolean    die_if_leaks)
 {
+    /* Addresses of thread-local variables aren't constant, so the
+     * list is built for the calling thread.
+     */
+    GjsMemCounter* counters[] = {
+        GJS_LIST_COUNTER(boxed),
+        GJS_LIST_COUNTER(gerror),
+        GJS_LIST_COUNTER(closure),
+        GJS_LIST_COUNTER(database),
+        GJS_LIST_COUNTER(function),
+        GJS_LIST_COUNTER(fundamental),
+        GJS_LIST_COUNTER(importer),
+        GJS_LIST_COUNTER(ns),
+        GJS_LIST_COUNTER(object),
+        GJS_LIST_COUNTER(param),
+        GJS_LIST_COUNTER(repo),
+        GJS_LIST_COUNTER(resultset),
+        GJS_LIST_COUNTER(weakhash),
+        GJS_LIST_COUNTER(interface)
+    };
     int i;
     int n_counters;
     int total_objects;
@@ -38,8 +38,11 @@ typedef struct {
     const char *name;
 } GjsMemCounter;
 
+/* Counters are thread-local; a thread runs at most one context, so
+ * this keeps them per runtime without any locking.
+ */
 #define GJS_DECLARE_COUNTER(name) \
-    extern GjsMemCounter gjs_counter_ ## name ;
+    extern __thread GjsMemCounter gjs_counter_ ## name ;
 
 GJS_DECLARE_COUNTER(everything)
 
@@ -37,6 +37,10 @@ typedef struct {
     GjsNativeFlags flags;
 } GjsNativeModule;
 
+/* Shared by the contexts of all threads, so lookups and registration
+ * (which also happens when a .so module is loaded) hold modules_lock.
+ */
+static GMutex modules_lock;
 static GHashTable *modules = NULL;
 
 static void
@@ -52,12 +56,15 @@ gjs_register_native_module (const char            *module_id,
 {
     GjsNativeModule *module;
 
+    g_mutex_lock(&modules_lock);
+
     if (modules == NULL) {
         modules = g_hash_table_new_full(g_str_hash, g_str_equal,
                                         g_free, native_module_free);
     }
 
     if (g_hash_table_lookup(modules, module_id) != NULL) {
+        g_mutex_unlock(&modules_lock);
         g_warning("A second native module tried to register the same id '%s'",
                   module_id);
         return;
@@ -71,6 +78,8 @@ gjs_register_native_module (const char            *module_id,
                          g_strdup(module_id),
                          module);
 
+    g_mutex_unlock(&modules_lock);
+
     gjs_debug(GJS_DEBUG_NATIVE,
               "Registered native JS module '%s'",
               module_id);
@@ -106,10 +115,13 @@ gjs_is_registered_native_module(JSContext  *context,
                                 JSObject   *parent,
                                 const char *name)
 {
-    if (modules == NULL)
-        return FALSE;
+    gboolean registered;
+
+    g_mutex_lock(&modules_lock);
+    registered = modules != NULL && g_hash_table_lookup(modules, name) != NULL;
+    g_mutex_unlock(&modules_lock);
 
-    return g_hash_table_lookup(modules, name) != NULL;
+    return registered;
 }
 
 /**
@@ -131,10 +143,13 @@ gjs_import_native_module(JSContext *context,
               "Defining native module '%s'",
               name);
 
+    /* entries are never removed, so this stays valid after unlocking */
+    g_mutex_lock(&modules_lock);
     if (modules != NULL)
         native_module = g_hash_table_lookup(modules, name);
     else
         native_module = NULL;
+    g_mutex_unlock(&modules_lock);
 
     if (!native_module) {
         gjs_throw(context,
@@ -35,9 +35,68 @@
 #include <string.h>
 #include <math.h>
 
+/* Values are pushed in chunks of this many jsvals; a frame larger
+ * than this gets a chunk of its own.
+ */
+#define VALUE_STACK_CHUNK_SIZE 256
+
+typedef struct ValueStackChunk ValueStackChunk;
+struct ValueStackChunk {
+    ValueStackChunk *prev;
+    guint size;
+    guint top;
+    jsval values[1];
+};
+
+/* Scratch bytes are allocated in chunks of at least this size */
+#define SCRATCH_CHUNK_SIZE 4096
+
+/* @base is the scratch offset of data[0], so that an offset can mark
+ * a position across chunks.
+ */
+typedef struct ScratchChunk ScratchChunk;
+struct ScratchChunk {
+    ScratchChunk *prev;
+    gsize base;
+    gsize size;
+    gsize top;
+    char data[1];
+};
+
 typedef struct {
     JSContext *context;
     jsid const_strings[GJS_STRING_LAST];
+
+    /* The thread the runtime was created on, and the main context
+     * that was the thread-default there at the time; anything that
+     * has to call back into JS from elsewhere is deferred to it.
+     */
+    GThread *thread;
+    GMainContext *main_context;
+
+    /* Held while the runtime is collecting garbage, so that toggle
+     * notifications on other threads know to defer to an idle.
+     */
+    GMutex gc_lock;
+
+    /* see gjs_gc_set_slice_callback() */
+    GjsGCSliceFunc gc_slice_func;
+
+    GjsWrapperState wrapper_state;
+
+    /* Stack of scratch jsvals used by the marshallers, traced as
+     * a whole from trace_value_stack() instead of rooting each
+     * location separately.
+     */
+    ValueStackChunk *value_stack;
+    ValueStackChunk *spare_chunk;
+
+    /* Bump allocator for short-lived C data of the marshallers */
+    ScratchChunk *scratch;
+    ScratchChunk *spare_scratch;
+
+    /* constant C string -> interned JSString */
+    GHashTable *static_strings;
 } GjsRuntimeData;
 
 /* Keep this consistent with GjsConstString */
@@ -47,7 +106,8 @@ static const char *const_strings[] = {
     "__gjsKeepAlive", "__gjsPrivateNS",
     "gi", "versions", "overrides",
     "_init", "_new_internal", "new",
-    "message", "code", "stack", "fileName", "lineNumber"
+    "message", "code", "stack", "fileName", "lineNumber",
+    "promise", "Promise", "putReturn", "putError"
 };
 
 G_STATIC_ASSERT(G_N_ELEMENTS(const_strings) == GJS_STRING_LAST);
@@ -73,6 +133,51 @@ gjs_runtime_get_context(JSRuntime *runtime)
     return get_data(runtime)->context;
 }
 
+/**
+ * gjs_runtime_get_thread:
+ * @runtime: a #JSRuntime
+ *
+ * Gets the thread that owns @runtime. JS code of the runtime may only
+ * run on that thread.
+ *
+ * Return value: (transfer none): the owning thread
+ */
+GThread *
+gjs_runtime_get_thread(JSRuntime *runtime)
+{
+    return get_data(runtime)->thread;
+}
+
+/**
+ * gjs_runtime_get_main_context:
+ * @runtime: a #JSRuntime
+ *
+ * Gets the main context that is iterated by the thread owning
+ * @runtime; sources that need to call into JS from another thread
+ * should be attached to it.
+ *
+ * Return value: (transfer none): the main context of the runtime
+ */
+GMainContext *
+gjs_runtime_get_main_context(JSRuntime *runtime)
+{
+    return get_data(runtime)->main_context;
+}
+
+/**
+ * gjs_runtime_get_wrapper_state:
+ * @runtime: a #JSRuntime
+ *
+ * Gets the per-runtime bookkeeping of the GI wrappers.
+ *
+ * Return value: (transfer none): the wrapper state of @runtime
+ */
+GjsWrapperState *
+gjs_runtime_get_wrapper_state(JSRuntime *runtime)
+{
+    return &get_data(runtime)->wrapper_state;
+}
+
 jsid
 gjs_runtime_get_const_string(JSRuntime      *runtime,
                              GjsConstString  name)
@@ -96,6 +201,282 @@ gjs_object_get_property_const(JSContext      *context,
                               pname, value_p);
 }
 
+static ValueStackChunk *
+value_stack_chunk_new(guint size)
+{
+    ValueStackChunk *chunk;
+
+    chunk = g_malloc(G_STRUCT_OFFSET(ValueStackChunk, values) + size * sizeof(jsval));
+    chunk->prev = NULL;
+    chunk->size = size;
+    chunk->top = 0;
+
+    return chunk;
+}
+
+static void
+trace_value_stack(JSTracer *tracer,
+                  void     *data)
+{
+    GjsRuntimeData *rdata = data;
+    ValueStackChunk *chunk;
+    guint i;
+
+    for (chunk = rdata->value_stack; chunk != NULL; chunk = chunk->prev) {
+        for (i = 0; i < chunk->top; i++)
+            JS_CALL_VALUE_TRACER(tracer, chunk->values[i], "marshal value stack");
+    }
+}
+
+/**
+ * gjs_runtime_push_values:
+ * @runtime: a #JSRuntime
+ * @n_values: number of values to reserve
+ *
+ * Reserves @n_values consecutive jsvals, initialized to %JSVAL_VOID,
+ * which are traced by the garbage collector until they are released
+ * with gjs_runtime_pop_values(). This is meant for the argument vectors
+ * of closure and callback invocations, which would otherwise have to
+ * add and remove a root for every location on every call.
+ *
+ * Frames must be popped in the reverse order they were pushed. The
+ * returned pointer stays valid until the frame is popped.
+ *
+ * Return value: the first of the reserved values
+ */
+jsval *
+gjs_runtime_push_values(JSRuntime *runtime,
+                        guint      n_values)
+{
+    GjsRuntimeData *data = get_data(runtime);
+    ValueStackChunk *chunk = data->value_stack;
+    jsval *values;
+    guint i;
+
+    if (chunk == NULL || chunk->size - chunk->top < n_values) {
+        ValueStackChunk *new_chunk;
+
+        if (data->spare_chunk != NULL && data->spare_chunk->size >= n_values) {
+            new_chunk = data->spare_chunk;
+            data->spare_chunk = NULL;
+        } else {
+            new_chunk = value_stack_chunk_new(MAX(n_values, VALUE_STACK_CHUNK_SIZE));
+        }
+
+        new_chunk->prev = chunk;
+        data->value_stack = chunk = new_chunk;
+    }
+
+    values = &chunk->values[chunk->top];
+    for (i = 0; i < n_values; i++)
+        values[i] = JSVAL_VOID;
+    chunk->top += n_values;
+
+    return values;
+}
+
+/**
+ * gjs_runtime_pop_values:
+ * @runtime: a #JSRuntime
+ * @values: the frame returned by gjs_runtime_push_values()
+ * @n_values: the size of the frame
+ *
+ * Releases the topmost frame of values reserved with
+ * gjs_runtime_push_values().
+ */
+void
+gjs_runtime_pop_values(JSRuntime *runtime,
+                       jsval     *values,
+                       guint      n_values)
+{
+    GjsRuntimeData *data = get_data(runtime);
+    ValueStackChunk *chunk = data->value_stack;
+
+    g_assert(chunk != NULL);
+    g_assert(chunk->top >= n_values);
+
+    chunk->top -= n_values;
+    g_assert(values == &chunk->values[chunk->top]);
+
+    if (chunk->top == 0 && chunk->prev != NULL) {
+        /* Keep one chunk around so that a frame straddling a
+         * chunk boundary doesn't malloc on every call.
+         */
+        data->value_stack = chunk->prev;
+        chunk->prev = NULL;
+
+        g_free(data->spare_chunk);
+        data->spare_chunk = chunk;
+    }
+}
+
+static ScratchChunk *
+scratch_chunk_new(gsize size)
+{
+    ScratchChunk *chunk;
+
+    chunk = g_malloc(G_STRUCT_OFFSET(ScratchChunk, data) + size);
+    chunk->prev = NULL;
+    chunk->base = 0;
+    chunk->size = size;
+    chunk->top = 0;
+
+    return chunk;
+}
+
+/**
+ * gjs_runtime_scratch_mark:
+ * @runtime: a #JSRuntime
+ *
+ * Gets the current position of the scratch allocator of @runtime, to
+ * be passed to gjs_runtime_scratch_release() once the memory allocated
+ * from now on isn't needed anymore.
+ *
+ * Return value: an opaque mark
+ */
+gsize
+gjs_runtime_scratch_mark(JSRuntime *runtime)
+{
+    ScratchChunk *chunk = get_data(runtime)->scratch;
+
+    return chunk->base + chunk->top;
+}
+
+/**
+ * gjs_runtime_scratch_alloc:
+ * @runtime: a #JSRuntime
+ * @size: number of bytes
+ *
+ * Allocates @size bytes that stay valid until they are released with
+ * gjs_runtime_scratch_release(), for the C data of a single call, for
+ * instance, rather than going through malloc() and free(). Marks must
+ * be released in the reverse order they were taken.
+ *
+ * Return value: the memory, aligned for any pointer
+ */
+gpointer
+gjs_runtime_scratch_alloc(JSRuntime *runtime,
+                          gsize      size)
+{
+    GjsRuntimeData *data = get_data(runtime);
+    ScratchChunk *chunk = data->scratch;
+    gpointer mem;
+
+    size = (size + sizeof(gpointer) - 1) & ~(sizeof(gpointer) - 1);
+
+    if (chunk->size - chunk->top < size) {
+        ScratchChunk *new_chunk;
+
+        if (data->spare_scratch != NULL && data->spare_scratch->size >= size) {
+            new_chunk = data->spare_scratch;
+            data->spare_scratch = NULL;
+        } else {
+            new_chunk = scratch_chunk_new(MAX(size, SCRATCH_CHUNK_SIZE));
+        }
+
+        new_chunk->prev = chunk;
+        new_chunk->base = chunk->base + chunk->top;
+        new_chunk->top = 0;
+        data->scratch = chunk = new_chunk;
+    }
+
+    mem = &chunk->data[chunk->top];
+    chunk->top += size;
+
+    return mem;
+}
+
+/**
+ * gjs_runtime_scratch_release:
+ * @runtime: a #JSRuntime
+ * @mark: a mark from gjs_runtime_scratch_mark()
+ *
+ * Releases all the scratch memory allocated since @mark was taken.
+ */
+void
+gjs_runtime_scratch_release(JSRuntime *runtime,
+                            gsize      mark)
+{
+    GjsRuntimeData *data = get_data(runtime);
+    ScratchChunk *chunk = data->scratch;
+
+    while (chunk->base >= mark && chunk->prev != NULL) {
+        data->scratch = chunk->prev;
+        chunk->prev = NULL;
+
+        /* Keep the largest chunk around for the next call */
+        if (data->spare_scratch == NULL || data->spare_scratch->size < chunk->size) {
+            g_free(data->spare_scratch);
+            data->spare_scratch = chunk;
+        } else {
+            g_free(chunk);
+        }
+        chunk = data->scratch;
+    }
+
+    g_assert(mark >= chunk->base && mark <= chunk->base + chunk->top);
+    chunk->top = mark - chunk->base;
+}
+
+/**
+ * gjs_runtime_get_static_string:
+ * @context: a #JSContext
+ * @static_string: a UTF-8 string that is never freed
+ *
+ * Gets the interned JS string for @static_string, which is only
+ * converted the first time. Interned strings are never collected, so
+ * this is meant for a bounded set of constant strings, like type
+ * names.
+ *
+ * Return value: the JS string, or %NULL on failure
+ */
+JSString *
+gjs_runtime_get_static_string(JSContext  *context,
+                              const char *static_string)
+{
+    GjsRuntimeData *data = get_data(JS_GetRuntime(context));
+    JSString *str;
+
+    str = g_hash_table_lookup(data->static_strings, static_string);
+    if (str == NULL) {
+        str = JS_InternString(context, static_string);
+        if (str != NULL)
+            g_hash_table_insert(data->static_strings, (gpointer) static_string, str);
+    }
+
+    return str;
+}
+
+void
+gjs_enter_gc(JSRuntime *runtime)
+{
+    g_mutex_lock(&get_data(runtime)->gc_lock);
+}
+
+void
+gjs_leave_gc(JSRuntime *runtime)
+{
+    g_mutex_unlock(&get_data(runtime)->gc_lock);
+}
+
+gboolean
+gjs_try_block_gc(JSRuntime *runtime)
+{
+    return g_mutex_trylock(&get_data(runtime)->gc_lock);
+}
+
+void
+gjs_block_gc(JSRuntime *runtime)
+{
+    g_mutex_lock(&get_data(runtime)->gc_lock);
+}
+
+void
+gjs_unblock_gc(JSRuntime *runtime)
+{
+    g_mutex_unlock(&get_data(runtime)->gc_lock);
+}
+
 void
 gjs_runtime_init_for_context(JSRuntime *runtime,
                              JSContext *context)
@@ -103,17 +484,66 @@ gjs_runtime_init_for_context(JSRuntime *runtime,
     GjsRuntimeData *data;
     int i;
 
-    data = g_new(GjsRuntimeData, 1);
+    data = g_new0(GjsRuntimeData, 1);
 
     data->context = context;
+    data->thread = g_thread_self();
+    data->main_context = g_main_context_ref_thread_default();
+    g_mutex_init(&data->gc_lock);
+    data->wrapper_state.fundamental_objects = g_hash_table_new(NULL, NULL);
     for (i = 0; i < GJS_STRING_LAST; i++)
         data->const_strings[i] = gjs_intern_string_to_id(context, const_strings[i]);
 
+    data->value_stack = value_stack_chunk_new(VALUE_STACK_CHUNK_SIZE);
+    data->spare_chunk = NULL;
+    data->scratch = scratch_chunk_new(SCRATCH_CHUNK_SIZE);
+    data->static_strings = g_hash_table_new(NULL, NULL);
+
     JS_SetRuntimePrivate(runtime, data);
+    JS_SetExtraGCRootsTracer(runtime, trace_value_stack, data);
 }
 
 void
 gjs_runtime_deinit(JSRuntime *runtime)
 {
-    g_free(get_data(runtime));
+    GjsRuntimeData *data = get_data(runtime);
+
+    JS_SetExtraGCRootsTracer(runtime, NULL, NULL);
+
+    g_assert(data->value_stack->prev == NULL);
+    g_assert(data->value_stack->top == 0);
+
+    g_free(data->value_stack);
+    g_free(data->spare_chunk);
+    g_assert(data->scratch->prev == NULL);
+    g_assert(data->scratch->top == 0);
+    g_free(data->scratch);
+    g_free(data->spare_scratch);
+    g_hash_table_unref(data->static_strings);
+    g_hash_table_unref(data->wrapper_state.fundamental_objects);
+    g_slist_free(data->wrapper_state.completed_trampolines);
+    g_clear_pointer(&data->wrapper_state.class_init_properties, g_hash_table_unref);
+    g_clear_pointer(&data->wrapper_state.property_ids, g_hash_table_unref);
+    g_assert(data->wrapper_state.object_init_list == NULL);
+    g_assert(g_queue_is_empty(&data->wrapper_state.async_calls));
+    g_assert(g_queue_is_empty(&data->wrapper_state.completed_async_calls));
+    g_assert(g_queue_is_empty(&data->wrapper_state.dbus_implementations));
+    g_assert(g_queue_is_empty(&data->wrapper_state.workers));
+
+    g_mutex_clear(&data->gc_lock);
+    g_main_context_unref(data->main_context);
+    g_free(data);
+}
+
+void
+gjs_runtime_set_gc_slice_func(JSRuntime      *runtime,
+                              GjsGCSliceFunc  func)
+{
+    get_data(runtime)->gc_slice_func = func;
+}
+
+GjsGCSliceFunc
+gjs_runtime_get_gc_slice_func(JSRuntime *runtime)
+{
+    return get_data(runtime)->gc_slice_func;
 }
@@ -24,6 +24,8 @@
 #ifndef __GJS_RUNTIME_H__
 #define __GJS_RUNTIME_H__
 
+G_BEGIN_DECLS
+
 typedef enum {
   GJS_STRING_CONSTRUCTOR,
   GJS_STRING_PROTOTYPE,
@@ -45,15 +47,100 @@ typedef enum {
   GJS_STRING_STACK,
   GJS_STRING_FILENAME,
   GJS_STRING_LINE_NUMBER,
+  GJS_STRING_PROMISE_MODULE,
+  GJS_STRING_PROMISE,
+  GJS_STRING_PUT_RETURN,
+  GJS_STRING_PUT_ERROR,
   GJS_STRING_LAST
 } GjsConstString;
 
+/* Bookkeeping of the GI wrappers that belongs to a single runtime,
+ * so that several contexts, each on its own thread, don't share it.
+ * Only touched from the thread owning the runtime, except where noted.
+ */
+typedef struct {
+    /* fundamental instance -> JSObject wrapping it */
+    GHashTable *fundamental_objects;
+
+    /* async callback trampolines to free on the next call into C */
+    GSList *completed_trampolines;
+
+    /* JS objects whose GObject is being constructed, innermost first */
+    GSList *object_init_list;
+
+    /* GType -> GPtrArray of GParamSpec, from gjs_register_type()
+     * until class_init of the type installs them
+     */
+    GHashTable *class_init_properties;
+
+    /* GParamSpec of a JS-implemented property -> interned jsid of the
+     * name it is stored under on the JS object
+     */
+    GHashTable *property_ids;
+
+    /* toggle notifications queued to the main context of the runtime;
+     * atomic, since they are queued from any thread
+     */
+    volatile gint pending_idle_toggles;
+
+    /* _async() calls returning a promise; the in-flight ones, and the
+     * completed ones waiting for async_flush_source to resolve them
+     * in a single batch
+     */
+    GQueue async_calls;
+    GQueue completed_async_calls;
+    GSource *async_flush_source;
+
+    /* data of the D-Bus objects whose methods are implemented in JS,
+     * to unexport them when the context goes away
+     */
+    GQueue dbus_implementations;
+
+    /* Worker objects created in this runtime whose thread hasn't been
+     * joined yet
+     */
+    GQueue workers;
+} GjsWrapperState;
+
+/* Called at the start and at the end of every GC slice */
+typedef void (* GjsGCSliceFunc) (JSRuntime *runtime, gboolean slice_begin);
+
 void        gjs_runtime_init_for_context     (JSRuntime       *runtime,
                                               JSContext       *context);
 void        gjs_runtime_deinit               (JSRuntime       *runtime);
 
 JSContext*  gjs_runtime_get_context          (JSRuntime       *runtime);
+GThread*    gjs_runtime_get_thread           (JSRuntime       *runtime);
+GMainContext* gjs_runtime_get_main_context   (JSRuntime       *runtime);
+GjsWrapperState* gjs_runtime_get_wrapper_state (JSRuntime     *runtime);
 jsid        gjs_runtime_get_const_string     (JSRuntime       *runtime,
                                               GjsConstString   string);
 
+jsval*      gjs_runtime_push_values          (JSRuntime       *runtime,
+                                              guint            n_values);
+void        gjs_runtime_pop_values           (JSRuntime       *runtime,
+                                              jsval           *values,
+                                              guint            n_values);
+
+gsize       gjs_runtime_scratch_mark         (JSRuntime       *runtime);
+gpointer    gjs_runtime_scratch_alloc        (JSRuntime       *runtime,
+                                              gsize            size);
+void        gjs_runtime_scratch_release      (JSRuntime       *runtime,
+                                              gsize            mark);
+
+JSString*   gjs_runtime_get_static_string    (JSContext       *context,
+                                              const char      *static_string);
+
+void        gjs_enter_gc                     (JSRuntime       *runtime);
+void        gjs_leave_gc                     (JSRuntime       *runtime);
+gboolean    gjs_try_block_gc                 (JSRuntime       *runtime);
+void        gjs_block_gc                     (JSRuntime       *runtime);
+void        gjs_unblock_gc                   (JSRuntime       *runtime);
+
+void        gjs_runtime_set_gc_slice_func    (JSRuntime       *runtime,
+                                              GjsGCSliceFunc   func);
+GjsGCSliceFunc gjs_runtime_get_gc_slice_func (JSRuntime       *runtime);
+
+G_END_DECLS
+
 #endif /* __GJS_RUNTIME_H__ */
@@ -38,8 +38,11 @@ static GjsTypeModule *global_type_module;
 GjsTypeModule *
 gjs_type_module_get ()
 {
-    if (global_type_module == NULL) {
+    static gsize initialized = 0;
+
+    if (g_once_init_enter (&initialized)) {
         global_type_module = g_object_new (GJS_TYPE_TYPE_MODULE, NULL);
+        g_once_init_leave (&initialized, 1);
     }
 
     return global_type_module;
@@ -14,5 +14,63 @@ function testDanglingIdle() {
     Mainloop.idle_add(function() { return true; });
 }
 
+function testTimerWheel() {
+    let order = [];
+    let cancelled = false;
+
+    Mainloop.timer_add(30, function() { order.push(30); return false; });
+    Mainloop.timer_add(10, function() { order.push(10); return false; });
+    let id = Mainloop.timer_add(20, function() { cancelled = true; return false; });
+    JSUnit.assertTrue(id < 0);
+
+    let count = 0;
+    Mainloop.timer_add(5, function() {
+        count++;
+        return count < 3;
+    });
+
+    // both land on the same 100 ms boundary; whether they share a
+    // wakeup depends on how loaded the machine is, so only their
+    // order is checked
+    let coalesced = [];
+    Mainloop.timer_add(40, function() {
+        coalesced.push('a');
+        Mainloop.idle_add(function() { coalesced.push('idle'); return false; });
+        return false;
+    }, 100);
+    Mainloop.timer_add(60, function() { coalesced.push('b'); return false; }, 100);
+
+    Mainloop.timer_add(250, function() { Mainloop.quit('testTimerWheel'); return false; });
+
+    JSUnit.assertTrue(Mainloop.source_remove(id));
+    JSUnit.assertFalse(Mainloop.source_remove(id));
+
+    Mainloop.run('testTimerWheel');
+
+    JSUnit.assertEquals(2, order.length);
+    JSUnit.assertEquals(10, order[0]);
+    JSUnit.assertEquals(30, order[1]);
+    JSUnit.assertFalse(cancelled);
+    JSUnit.assertEquals(3, count);
+    JSUnit.assertEquals(3, coalesced.length);
+    JSUnit.assertTrue(coalesced.indexOf('a') >= 0);
+    JSUnit.assertTrue(coalesced.indexOf('a') < coalesced.indexOf('b'));
+    JSUnit.assertTrue(coalesced.indexOf('a') < coalesced.indexOf('idle'));
+}
+
+function testTimerWheelTimeoutAdd() {
+    Mainloop.use_timer_wheel(true);
+    try {
+        let ran = false;
+        let id = Mainloop.timeout_add(10, function() { ran = true; return false; });
+        JSUnit.assertTrue(id < 0);
+        Mainloop.timeout_add(20, function() { Mainloop.quit('testTimerWheelTimeoutAdd'); return false; });
+        Mainloop.run('testTimerWheelTimeoutAdd');
+        JSUnit.assertTrue(ran);
+    } finally {
+        Mainloop.use_timer_wheel(false);
+    }
+}
+
 JSUnit.gjstestRun(this, JSUnit.setUp, JSUnit.tearDown);
 
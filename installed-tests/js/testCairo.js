@@ -1,7 +1,10 @@
 // application/javascript;version=1.8
 const JSUnit = imports.jsUnit;
+const ByteArray = imports.byteArray;
 const Cairo = imports.cairo;
 const Everything = imports.gi.Regress;
+const GLib = imports.gi.GLib;
+const Mainloop = imports.mainloop;
 
 function _ts(obj) {
     return obj.toString().slice(8, -1);
@@ -126,6 +129,155 @@ function testContextMethods() {
     cr.stroke();
 }
 
+function testPathData() {
+    let cr = _createContext();
+
+    cr.appendPathData([0, 0, 10, 0, 10, 10],
+                      [Cairo.PathDataType.MOVE_TO,
+                       Cairo.PathDataType.LINE_TO,
+                       Cairo.PathDataType.LINE_TO,
+                       Cairo.PathDataType.CLOSE_PATH]);
+    let data = cr.copyPath().getData();
+    JSUnit.assertEquals(Cairo.PathDataType.MOVE_TO, data.ops[0]);
+    JSUnit.assertEquals(Cairo.PathDataType.CLOSE_PATH, data.ops[3]);
+    JSUnit.assertEquals(10, data.points[3]);
+
+    cr.newPath();
+    cr.drawPolyline(new Float64Array([1, 2, 3, 4, 5, 6]));
+    let point = cr.getCurrentPoint();
+    JSUnit.assertEquals(5, point[0]);
+    JSUnit.assertEquals(6, point[1]);
+
+    JSUnit.assertRaises(function() {
+        cr.appendPathData([0, 0], [Cairo.PathDataType.CURVE_TO]);
+    });
+    JSUnit.assertRaises(function() {
+        cr.drawPolyline([1, 2, 3]);
+    });
+}
+
+function testPathDataInvalidOps() {
+    let cr = _createContext();
+
+    // 258 would wrap around to CURVE_TO if cast to a byte
+    [ NaN, -1, 1.5, 4, 258 ].forEach(function(op) {
+        let error = null;
+        try {
+            cr.appendPathData([0, 0], [op]);
+        } catch (e) {
+            error = e;
+        }
+        JSUnit.assertTrue(error instanceof TypeError);
+    });
+
+    let error = null;
+    try {
+        cr.appendPathData([0, 0], new Uint8Array([4]));
+    } catch (e) {
+        error = e;
+    }
+    JSUnit.assertTrue(error instanceof TypeError);
+    JSUnit.assertEquals(0, cr.copyPath().getData().ops.length);
+}
+
+function testPathRecorder() {
+    let recorder = new Cairo.PathRecorder();
+    for (let i = 0; i < 100; i++)
+        recorder.rectangle(i, i, 1, 1);
+
+    let cr = _createContext();
+    recorder.replay(cr);
+    let replayed = cr.copyPath().getData();
+
+    cr.newPath();
+    for (let i = 0; i < 100; i++)
+        cr.rectangle(i, i, 1, 1);
+    let expected = cr.copyPath().getData();
+
+    JSUnit.assertEquals(expected.ops.length, replayed.ops.length);
+    JSUnit.assertEquals(expected.points.length, replayed.points.length);
+    JSUnit.assertEquals(expected.points[expected.points.length - 1],
+                        replayed.points[replayed.points.length - 1]);
+}
+
+function testImageSurfaceData() {
+    let surface = new Cairo.ImageSurface(Cairo.Format.ARGB32, 2, 2);
+    let cr = new Cairo.Context(surface);
+    cr.setSourceRGBA(1, 1, 1, 1);
+    cr.paint();
+
+    let data = surface.getData();
+    JSUnit.assertEquals(surface.getStride() * 2, data.length);
+    JSUnit.assertEquals(255, data[0]);
+
+    let pixels = new ByteArray.ByteArray(16);
+    pixels[0] = 42;
+    let wrapped = new Cairo.ImageSurface(Cairo.Format.ARGB32, 2, 2, pixels, 8);
+    JSUnit.assertEquals(42, wrapped.getData()[0]);
+
+    let fromBuffer = new Cairo.ImageSurface(Cairo.Format.A8, 4, 1,
+                                            new Uint8Array([1, 2, 3, 4]));
+    JSUnit.assertEquals(3, fromBuffer.getData()[2]);
+
+    // The surface draws into its own copy of the pixels
+    cr = new Cairo.Context(wrapped);
+    cr.setSourceRGBA(0, 0, 0, 1);
+    cr.paint();
+    wrapped.flush();
+    wrapped.markDirty();
+    wrapped.markDirtyRectangle(0, 0, 1, 1);
+    JSUnit.assertEquals(42, pixels[0]);
+    JSUnit.assertEquals(0, wrapped.getData()[0]);
+
+    // and pixels shared with a GBytes are left alone
+    let bytes = ByteArray.fromArray([7, 7, 7, 7]).toGBytes();
+    let shared = ByteArray.fromGBytes(bytes);
+    let fromShared = new Cairo.ImageSurface(Cairo.Format.A8, 4, 1, shared);
+    cr = new Cairo.Context(fromShared);
+    cr.setSourceRGBA(0, 0, 0, 0);
+    cr.setOperator(Cairo.Operator.SOURCE);
+    cr.paint();
+    fromShared.flush();
+    JSUnit.assertEquals(0, fromShared.getData()[0]);
+    JSUnit.assertEquals(7, ByteArray.fromGBytes(bytes)[0]);
+
+    JSUnit.assertRaises(function() {
+        new Cairo.ImageSurface(Cairo.Format.ARGB32, 2, 2, new ByteArray.ByteArray(4));
+    });
+}
+
+function testPNGAsync() {
+    let surface = new Cairo.ImageSurface(Cairo.Format.ARGB32, 4, 4);
+    let cr = new Cairo.Context(surface);
+    cr.setSourceRGBA(0, 0, 1, 1);
+    cr.paint();
+
+    let filename = GLib.build_filenamev([GLib.get_tmp_dir(),
+                                         'gjs-test-cairo-' + GLib.random_int() + '.png']);
+    let loaded = null, errors = [];
+
+    surface.writeToPNGAsync(filename, function(result, error) {
+        if (error)
+            errors.push(error);
+        Cairo.ImageSurface.createFromPNGAsync(filename, function(result, error) {
+            if (error)
+                errors.push(error);
+            loaded = result;
+            Cairo.ImageSurface.createFromPNGAsync('/nonexistent.png', function(result, error) {
+                JSUnit.assertNull(result);
+                JSUnit.assertNotNull(error);
+                Mainloop.quit('testPNGAsync');
+            });
+        });
+    });
+    Mainloop.run('testPNGAsync');
+    GLib.unlink(filename);
+
+    JSUnit.assertEquals(0, errors.length);
+    JSUnit.assertEquals(4, loaded.getWidth());
+    JSUnit.assertEquals(255, loaded.getData()[0]);
+}
+
 function testSolidPattern() {
     let cr = _createContext();
 
@@ -194,6 +194,34 @@ function testCrossCall() {
     JSUnit.assertEquals(50, res);
 }
 
+const SubMagic = new Lang.Class({
+    Name: 'SubMagic',
+
+    Extends: Magic,
+
+    foo: function(a, b, buffer) {
+        return this.parent(a, b, buffer) + 1;
+    }
+});
+
+function testMethodWrapping() {
+    // only methods calling parent() pay for a wrapper
+    JSUnit.assertEquals(undefined, MagicBase.prototype.foo._origin);
+    JSUnit.assertEquals(undefined, Accessor.prototype._init._origin);
+    JSUnit.assertTrue(Magic.prototype.foo._origin !== undefined);
+
+    let newSubMagic = new SubMagic(1, 2);
+    let buffer = [];
+
+    JSUnit.assertEquals(61, newSubMagic.foo(10, 20, buffer));
+    assertArrayEquals([10, 20], buffer);
+
+    // bar is inherited from Magic and still reaches MagicBase
+    buffer = [];
+    JSUnit.assertEquals(50, newSubMagic.bar(10, buffer));
+    assertArrayEquals([10, 20], buffer);
+}
+
 function testConstruct() {
     let instance = new CustomConstruct(1, 2);
 
@@ -2,6 +2,7 @@
 // This used to be called "Everything"
 const JSUnit = imports.jsUnit;
 const Everything = imports.gi.Regress;
+const ByteArray = imports.byteArray;
 const GLib = imports.gi.GLib;
 
 function testStruct() {
@@ -189,5 +190,92 @@ function testVariantConstructor() {
     JSUnit.assertEquals(2, unpacked[4].length);
 }
 
+function testVariantDictionary() {
+    let dict_variant = new GLib.Variant('a{sv}',
+                                        { 'foo': new GLib.Variant('i', 42),
+                                          'bar': new GLib.Variant('as', [ 'a', 'b' ]) });
+    JSUnit.assertEquals(2, dict_variant.n_children());
+
+    let unpacked = dict_variant.deep_unpack();
+    JSUnit.assertTrue(unpacked.foo instanceof GLib.Variant);
+    JSUnit.assertEquals(42, unpacked.foo.deep_unpack());
+    JSUnit.assertEquals('b', unpacked.bar.deep_unpack()[1]);
+
+    let int_dict = new GLib.Variant('a{ud}', { 1: 0.5, 4000000000: 2 }).deep_unpack();
+    JSUnit.assertEquals(0.5, int_dict[1]);
+    JSUnit.assertEquals(2, int_dict[4000000000]);
+}
+
+function testVariantMaybe() {
+    JSUnit.assertNull(new GLib.Variant('ms', null).deep_unpack());
+    JSUnit.assertEquals('x', new GLib.Variant('ms', 'x').deep_unpack());
+    JSUnit.assertTrue(new GLib.Variant('ms', 'x').unpack() instanceof GLib.Variant);
+}
+
+function testVariantFixedArrays() {
+    let int_variant = new GLib.Variant('ai', [ 1, -2, 3 ]);
+    JSUnit.assertEquals(3, int_variant.n_children());
+    JSUnit.assertTrue(int_variant.unpack()[0] instanceof GLib.Variant);
+
+    let ints = int_variant.deep_unpack();
+    JSUnit.assertEquals(-2, ints[1]);
+
+    let typed = int_variant.unpack_typed_array();
+    JSUnit.assertTrue(typed instanceof Int32Array);
+    JSUnit.assertEquals(3, typed.length);
+    JSUnit.assertEquals(3, typed[2]);
+
+    let doubles = new GLib.Variant('ad', new Float64Array([ 0.5, 1.5 ]));
+    JSUnit.assertEquals(1.5, doubles.unpack_typed_array()[1]);
+
+    let bytes = new GLib.Variant('ay', [ 1, 2, 255 ]).deep_unpack();
+    JSUnit.assertTrue(bytes instanceof ByteArray.ByteArray);
+    JSUnit.assertEquals(255, bytes[2]);
+
+    JSUnit.assertRaises(function() { new GLib.Variant('ay', [ 256 ]); });
+    JSUnit.assertRaises(function() { new GLib.Variant('as', [ 'a' ]).unpack_typed_array(); });
+}
+
+function testVariantIntegerRanges() {
+    [ 'u', 'x', 't' ].forEach(function(type) {
+        JSUnit.assertRaises(function() { new GLib.Variant(type, NaN); });
+        JSUnit.assertRaises(function() { new GLib.Variant(type, Infinity); });
+    });
+    JSUnit.assertRaises(function() { new GLib.Variant('u', -1); });
+    JSUnit.assertRaises(function() { new GLib.Variant('t', -1); });
+    JSUnit.assertRaises(function() { new GLib.Variant('u', Math.pow(2, 32)); });
+    JSUnit.assertRaises(function() { new GLib.Variant('x', Math.pow(2, 63)); });
+    JSUnit.assertRaises(function() { new GLib.Variant('x', -Infinity); });
+    JSUnit.assertRaises(function() { new GLib.Variant('t', Math.pow(2, 64)); });
+
+    JSUnit.assertEquals(-Math.pow(2, 63), new GLib.Variant('x', -Math.pow(2, 63)).deep_unpack());
+    JSUnit.assertEquals(Math.pow(2, 53), new GLib.Variant('t', Math.pow(2, 53)).deep_unpack());
+    JSUnit.assertEquals(Math.pow(2, 63), new GLib.Variant('t', Math.pow(2, 63)).deep_unpack());
+}
+
+function testVariantInvalidSignature() {
+    JSUnit.assertRaises(function() { new GLib.Variant('', 1); });
+    JSUnit.assertRaises(function() { new GLib.Variant('ii', 1); });
+    JSUnit.assertRaises(function() { new GLib.Variant('(i', [ 1 ]); });
+    JSUnit.assertRaises(function() { new GLib.Variant('(ii)', [ 1 ]); });
+    JSUnit.assertRaises(function() { new GLib.Variant('o', 'not a path'); });
+}
+
+function testVariantTypeVariantRejectsPrimitives() {
+    [ 42, 'foo', true, null, undefined ].forEach(function(value) {
+        let error = null;
+        try {
+            new GLib.Variant('v', value);
+        } catch (e) {
+            error = e;
+        }
+        JSUnit.assertTrue(error instanceof TypeError);
+        JSUnit.assertEquals("Expected a GLib.Variant for type 'v'", error.message);
+    });
+
+    JSUnit.assertRaises(function() { new GLib.Variant('av', [ 1 ]); });
+    JSUnit.assertEquals(1, new GLib.Variant('v', new GLib.Variant('i', 1)).deep_unpack().deep_unpack());
+}
+
 JSUnit.gjstestRun(this, JSUnit.setUp, JSUnit.tearDown);
 
@@ -248,6 +248,15 @@ function testInitStuff() {
     JSUnit.assertNull(theError);
 }
 
+function testPropertiesFromGetAll() {
+    // The proxy loads the properties with GetAll() when initialized;
+    // the write-only property must not be part of the reply
+    JSUnit.assertEquals(true, proxy.PropReadOnly);
+    JSUnit.assertEquals(String(PROP_READ_WRITE_INITIAL_VALUE),
+                        proxy.PropReadWrite.deep_unpack());
+    JSUnit.assertNull(proxy.get_cached_property('PropWriteOnly'));
+}
+
 function testFrobateStuff() {
     let theResult, theExcp;
     proxy.frobateStuffRemote({}, function(result, excp) {
@@ -274,4 +274,39 @@ function testDerived() {
     JSUnit.assertEquals('yes', derived.readwrite);
 }
 
+const HyphenObject = new GObject.Class({
+    Name: 'HyphenObject',
+    Properties: {
+        'hyphen-name': GObject.ParamSpec.string('hyphen-name', 'HyphenName',
+                                                'A property with a hyphen in its name',
+                                                GObject.ParamFlags.READABLE | GObject.ParamFlags.WRITABLE,
+                                                '')
+    },
+
+    _init: function(props) {
+        this._hyphenName = '';
+        this.parent(props);
+    },
+
+    get hyphen_name() {
+        return this._hyphenName;
+    },
+
+    set hyphen_name(val) {
+        this._hyphenName = val;
+    }
+});
+
+function testPropertyFromC() {
+    // construct properties and bindings go through
+    // g_object_set_property() and g_object_get_property()
+    let source = new HyphenObject({ hyphen_name: 'first' });
+    let target = new HyphenObject();
+    JSUnit.assertEquals('first', source.hyphen_name);
+
+    source.bind_property('hyphen-name', target, 'hyphen-name',
+                         GObject.BindingFlags.SYNC_CREATE);
+    JSUnit.assertEquals('first', target.hyphen_name);
+}
+
 JSUnit.gjstestRun(this, JSUnit.setUp, JSUnit.tearDown);
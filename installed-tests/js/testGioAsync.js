@@ -0,0 +1,91 @@
+// application/javascript;version=1.8
+
+const JSUnit = imports.jsUnit;
+const Gio = imports.gi.Gio;
+const GLib = imports.gi.GLib;
+const Mainloop = imports.mainloop;
+
+let _path = null;
+
+function setUp() {
+    JSUnit.setUp();
+
+    let [fd, path] = GLib.file_open_tmp('gjs-test-gio-async-XXXXXX');
+    GLib.close(fd);
+    GLib.file_set_contents(path, 'some contents');
+    _path = path;
+}
+
+function tearDown() {
+    GLib.unlink(_path);
+    JSUnit.tearDown();
+}
+
+function testPromiseReturn() {
+    let file = Gio.File.new_for_path(_path);
+    let result = null;
+
+    let promise = file.load_contents_async(null);
+    promise.get(function(value) {
+        result = value;
+        Mainloop.quit('testPromiseReturn');
+    }, function(e) {
+        Mainloop.quit('testPromiseReturn');
+        throw e;
+    });
+    Mainloop.run('testPromiseReturn');
+
+    let [ok, contents] = result;
+    JSUnit.assertTrue(ok);
+    JSUnit.assertEquals('some contents', String(contents));
+}
+
+function testPromiseError() {
+    let file = Gio.File.new_for_path(_path + '-does-not-exist');
+    let error = null;
+
+    file.load_contents_async(null).get(function(value) {
+        Mainloop.quit('testPromiseError');
+    }, function(e) {
+        error = e;
+        Mainloop.quit('testPromiseError');
+    });
+    Mainloop.run('testPromiseError');
+
+    JSUnit.assertTrue(error instanceof GLib.Error);
+    JSUnit.assertTrue(error.matches(Gio.IOErrorEnum, Gio.IOErrorEnum.NOT_FOUND));
+}
+
+function testManyPromises() {
+    let file = Gio.File.new_for_path(_path);
+    let pending = 100;
+
+    for (let i = 0; i < 100; i++) {
+        file.query_info_async('standard::size', Gio.FileQueryInfoFlags.NONE,
+                              GLib.PRIORITY_DEFAULT, null).get(function(info) {
+            JSUnit.assertEquals(13, info.get_size());
+            if (--pending == 0)
+                Mainloop.quit('testManyPromises');
+        });
+    }
+    Mainloop.run('testManyPromises');
+
+    JSUnit.assertEquals(0, pending);
+}
+
+function testCallback() {
+    let file = Gio.File.new_for_path(_path);
+    let contents = null;
+
+    let retval = file.load_contents_async(null, function(obj, res) {
+        let [ok, data] = obj.load_contents_finish(res);
+        contents = String(data);
+        Mainloop.quit('testCallback');
+    });
+    Mainloop.run('testCallback');
+
+    JSUnit.assertUndefined(retval);
+    JSUnit.assertEquals('some contents', contents);
+}
+
+JSUnit.gjstestRun(this, setUp, tearDown);
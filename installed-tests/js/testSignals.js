@@ -61,7 +61,45 @@ function testDisconnectDuringEmit() {
     foo.disconnect(firstId);
 
     // poke in private implementation to sanity-check
-    JSUnit.assertEquals('no handlers left', 0, foo._signalConnections.length);
+    JSUnit.assertEquals('no handlers left', 0, Object.keys(foo._signalConnections).length);
+    JSUnit.assertEquals('no handlers left', 0, foo._signalHandlers['bar'].connections.length);
+}
+
+function testConnectDuringEmit() {
+    var foo = new Foo();
+    var called = 0;
+    foo.connect('bar',
+                function(theFoo) {
+                    theFoo.connect('bar', function() { called += 1; });
+                });
+
+    // the handler connected during the first emission only runs from
+    // the second one on
+    foo.emit('bar');
+    JSUnit.assertEquals(0, called);
+    foo.emit('bar');
+    JSUnit.assertEquals(1, called);
+}
+
+function testManyHandlers() {
+    var foo = new Foo();
+    var ids = [];
+    var sum = 0;
+    for (let i = 0; i < 200; i++)
+        ids.push(foo.connect('bar', function(theFoo, a, b, c, d) {
+            sum += a + b + c + d;
+        }));
+
+    foo.emit('bar', 1, 2, 3, 4);
+    JSUnit.assertEquals(2000, sum);
+
+    for (let i = 0; i < 200; i += 2)
+        foo.disconnect(ids[i]);
+    JSUnit.assertRaises(function() { foo.disconnect(ids[0]); });
+
+    sum = 0;
+    foo.emit('bar', 1, 2, 3, 4);
+    JSUnit.assertEquals(1000, sum);
 }
 
 function testMultipleSignals() {
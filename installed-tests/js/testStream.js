@@ -0,0 +1,97 @@
+// application/javascript;version=1.8
+
+const JSUnit = imports.jsUnit;
+const ByteArray = imports.byteArray;
+const Gio = imports.gi.Gio;
+const GLib = imports.gi.GLib;
+const Stream = imports.stream;
+
+let _path = null;
+
+function setUp() {
+    JSUnit.setUp();
+
+    let [fd, path] = GLib.file_open_tmp('gjs-test-stream-XXXXXX');
+    GLib.close(fd);
+    _path = path;
+}
+
+function tearDown() {
+    GLib.unlink(_path);
+    JSUnit.tearDown();
+}
+
+function openReader(contents, bufferSize) {
+    GLib.file_set_contents(_path, contents);
+    return new Stream.Reader(Gio.File.new_for_path(_path).read(null), bufferSize);
+}
+
+function testReadLine() {
+    // a small buffer, so that it has to grow for the long line
+    let reader = openReader('first\nsecond, longer line\n\nlast', 4);
+
+    JSUnit.assertEquals('first', reader.readLine());
+    JSUnit.assertEquals('second, longer line', reader.readLine());
+    JSUnit.assertEquals('', reader.readLine());
+    JSUnit.assertEquals('last', reader.readLine());
+    JSUnit.assertNull(reader.readLine());
+    reader.close();
+}
+
+function testReadUntil() {
+    let reader = openReader('a||bé|c||', 3);
+
+    JSUnit.assertEquals('a', reader.readUntil('||'));
+    JSUnit.assertEquals('bé|c', reader.readUntil('||'));
+    JSUnit.assertNull(reader.readUntil('||'));
+    JSUnit.assertRaises(function() {
+        reader.readUntil('');
+    });
+}
+
+function testReadChunk() {
+    // multibyte characters get split between reads of 3 bytes
+    let text = 'héllo wörld, ½ ∞';
+    let reader = openReader(text, 3);
+    let chunks = [];
+    let chunk;
+
+    while ((chunk = reader.readChunk()) !== null)
+        chunks.push(chunk);
+
+    JSUnit.assertTrue(chunks.length > 1);
+    JSUnit.assertEquals(text, chunks.join(''));
+}
+
+function testReadBytes() {
+    let reader = openReader('0123456789', 4);
+
+    JSUnit.assertEquals('012', reader.readBytes(3).toString());
+
+    let buffer = new ByteArray.ByteArray(4);
+    JSUnit.assertEquals(4, reader.readInto(buffer));
+    JSUnit.assertEquals('3456', buffer.toString());
+    JSUnit.assertEquals(3, reader.readInto(buffer));
+    JSUnit.assertEquals('789', buffer.toString().substring(0, 3));
+    JSUnit.assertEquals(0, reader.readInto(buffer));
+    JSUnit.assertNull(reader.readBytes(1));
+}
+
+function testWriter() {
+    let file = Gio.File.new_for_path(_path);
+    let writer = new Stream.Writer(file.replace(null, false, Gio.FileCreateFlags.NONE, null), 8);
+
+    writer.write('héllo\n');
+    writer.write(ByteArray.fromString('a longer line than the buffer\n'));
+    writer.write('end');
+    writer.close();
+
+    let [ok, contents] = GLib.file_get_contents(_path);
+    JSUnit.assertEquals('héllo\na longer line than the buffer\nend', String(contents));
+
+    JSUnit.assertRaises(function() {
+        writer.write(42);
+    });
+}
+
+JSUnit.gjstestRun(this, setUp, tearDown);
@@ -0,0 +1,185 @@
+// application/javascript;version=1.8
+
+const JSUnit = imports.jsUnit;
+const ByteArray = imports.byteArray;
+const GLib = imports.gi.GLib;
+const GObject = imports.gi.GObject;
+const Gio = imports.gi.Gio;
+const Mainloop = imports.mainloop;
+const Worker = imports.worker.Worker;
+
+const ECHO_SCRIPT =
+    'function onmessage(data) {\n' +
+    '    if (data === "close")\n' +
+    '        close();\n' +
+    '    else\n' +
+    '        postMessage(data);\n' +
+    '}\n';
+
+let _scriptFile = null;
+
+function setUp() {
+    JSUnit.setUp();
+
+    let [fd, path] = GLib.file_open_tmp('gjs-test-worker-XXXXXX.js');
+    GLib.close(fd);
+    GLib.file_set_contents(path, ECHO_SCRIPT);
+    _scriptFile = path;
+}
+
+function tearDown() {
+    GLib.unlink(_scriptFile);
+    JSUnit.tearDown();
+}
+
+function runUntil(name, timeout) {
+    let timedOut = false;
+    let id = Mainloop.timeout_add(timeout, function() {
+        timedOut = true;
+        Mainloop.quit(name);
+        return false;
+    });
+    Mainloop.run(name);
+    if (!timedOut)
+        GLib.source_remove(id);
+    return !timedOut;
+}
+
+function testEcho() {
+    let worker = new Worker(_scriptFile);
+    let sent = [undefined, null, true, 42, 0.5, 'héllo',
+                [1, [2, 'three']], { a: 1, b: { c: [null] } }];
+    let received = [];
+
+    worker.onmessage = function(data) {
+        received.push(data);
+        if (received.length == sent.length)
+            Mainloop.quit('testEcho');
+    };
+    sent.forEach(function(data) {
+        worker.postMessage(data);
+    });
+
+    JSUnit.assertTrue(runUntil('testEcho', 5000));
+    JSUnit.assertEquals(JSON.stringify(sent), JSON.stringify(received));
+    JSUnit.assertUndefined(received[0]);
+    JSUnit.assertNull(received[1]);
+
+    worker.terminate();
+}
+
+function testByteArray() {
+    let worker = new Worker(_scriptFile);
+    let bytes = ByteArray.fromString('some binary data');
+    let received = null;
+
+    worker.onmessage = function(data) {
+        received = data;
+        Mainloop.quit('testByteArray');
+    };
+    worker.postMessage(bytes);
+
+    JSUnit.assertTrue(runUntil('testByteArray', 5000));
+    JSUnit.assertTrue(received instanceof ByteArray.ByteArray);
+    JSUnit.assertEquals('some binary data', received.toString());
+
+    // the copies are independent
+    received[0] = 0x53;
+    JSUnit.assertEquals('some binary data', bytes.toString());
+
+    worker.terminate();
+}
+
+function testInvalidMessage() {
+    let worker = new Worker(_scriptFile);
+
+    JSUnit.assertRaises(function() {
+        worker.postMessage(function() {});
+    });
+
+    let cyclic = {};
+    cyclic.self = cyclic;
+    JSUnit.assertRaises(function() {
+        worker.postMessage(cyclic);
+    });
+
+    worker.terminate();
+    JSUnit.assertRaises(function() {
+        worker.postMessage('too late');
+    });
+}
+
+function testNonCloneableMessage() {
+    let worker = new Worker(_scriptFile);
+
+    [new GObject.Object(),
+     new GLib.Variant('s', 'boxed'),
+     new Date(),
+     { nested: [new Date()] }].forEach(function(data) {
+        let error = null;
+        try {
+            worker.postMessage(data);
+        } catch (e) {
+            error = e;
+        }
+        JSUnit.assertTrue(error instanceof TypeError);
+    });
+
+    worker.terminate();
+}
+
+function testClose() {
+    let worker = new Worker(_scriptFile);
+    let received = [];
+
+    worker.onmessage = function(data) {
+        received.push(data);
+    };
+    worker.postMessage('before');
+    worker.postMessage('close');
+
+    // nothing is echoed once the worker has closed itself
+    runUntil('testClose', 500);
+    JSUnit.assertEquals(1, received.length);
+    JSUnit.assertEquals('before', received[0]);
+}
+
+function testSharedObject() {
+    let [fd, path] = GLib.file_open_tmp('gjs-test-worker-XXXXXX.js');
+    GLib.close(fd);
+    GLib.file_set_contents(path,
+        'const Gio = imports.gi.Gio;\n' +
+        'function onmessage() {\n' +
+        '    try {\n' +
+        '        Gio.Vfs.get_default();\n' +
+        '        postMessage("wrapped");\n' +
+        '    } catch (e) {\n' +
+        '        postMessage(e.message);\n' +
+        '    }\n' +
+        '}\n');
+
+    // the main runtime wraps the singleton first
+    let vfs = Gio.Vfs.get_default();
+    vfs._marker = 'main';
+
+    let worker = new Worker(path);
+    let received = null;
+    worker.onmessage = function(data) {
+        received = data;
+        Mainloop.quit('testSharedObject');
+    };
+    worker.postMessage('go');
+
+    try {
+        JSUnit.assertTrue(runUntil('testSharedObject', 5000));
+    } finally {
+        worker.terminate();
+        GLib.unlink(path);
+    }
+
+    JSUnit.assertTrue(received.indexOf('another thread') >= 0);
+    JSUnit.assertTrue(Gio.Vfs.get_default() === vfs);
+    JSUnit.assertEquals('main', Gio.Vfs.get_default()._marker);
+}
+
+JSUnit.gjstestRun(this, setUp, tearDown);
@@ -0,0 +1,55 @@
+// application/javascript;version=1.8
+
+// Lazy imports are turned on once per process, by the first import
+// of a NAME.js file, which importing GLib already does; so
+// GJS_LAZY_IMPORTS is set in the environment by testLazyImports.test.
+const GLib = imports.gi.GLib;
+const JSUnit = imports.jsUnit;
+
+if (GLib.getenv('GJS_LAZY_IMPORTS') === null)
+    throw new Error('GJS_LAZY_IMPORTS must be set to run this test');
+
+let moduleDir = GLib.dir_make_tmp('gjs-lazy-imports-XXXXXX');
+
+function writeModule(name, source) {
+    GLib.file_set_contents(GLib.build_filenamev([moduleDir, name + '.js']),
+                           source);
+}
+
+writeModule('lazyEvaluated',
+            "imports.gi.GLib.setenv('GJS_TEST_LAZY_EVALUATED', '1', true);\n" +
+            "var value = 42;\n");
+writeModule('lazySideEffect',
+            "imports.gi.GLib.setenv('GJS_TEST_LAZY_SIDE_EFFECT', '1', true);\n");
+
+imports.searchPath.unshift(moduleDir);
+
+function testNotEvaluatedBeforeFirstAccess() {
+    let module = imports.lazyEvaluated;
+    JSUnit.assertNull(GLib.getenv('GJS_TEST_LAZY_EVALUATED'));
+
+    JSUnit.assertEquals(42, module.value);
+    JSUnit.assertEquals('1', GLib.getenv('GJS_TEST_LAZY_EVALUATED'));
+}
+
+function testSideEffectOnlyModuleNeverRuns() {
+    imports.lazySideEffect;
+
+    let loop = new GLib.MainLoop(null, false);
+    GLib.timeout_add(GLib.PRIORITY_DEFAULT, 100, function() {
+        loop.quit();
+        return false;
+    });
+    loop.run();
+
+    JSUnit.assertNull(GLib.getenv('GJS_TEST_LAZY_SIDE_EFFECT'));
+}
+
+try {
+    testNotEvaluatedBeforeFirstAccess();
+    testSideEffectOnlyModuleNeverRuns();
+} finally {
+    GLib.unlink(GLib.build_filenamev([moduleDir, 'lazyEvaluated.js']));
+    GLib.unlink(GLib.build_filenamev([moduleDir, 'lazySideEffect.js']));
+    GLib.rmdir(moduleDir);
+}
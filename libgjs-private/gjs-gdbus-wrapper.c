@@ -28,6 +28,10 @@ struct _GjsDBusImplementationPrivate {
     // from gchar* to GVariant*
     GHashTable           *outstanding_properties;
     guint                 idle_id;
+
+    const GjsDBusImplementationHandlers *handlers;
+    gpointer                             handlers_data;
+    GDestroyNotify                       handlers_notify;
 };
 
 G_DEFINE_TYPE(GjsDBusImplementation, gjs_dbus_implementation, G_TYPE_DBUS_INTERFACE_SKELETON)
@@ -44,9 +48,29 @@ gjs_dbus_implementation_method_call(GDBusConnection       *connection,
 {
     GjsDBusImplementation *self = GJS_DBUS_IMPLEMENTATION (user_data);
 
+    if (self->priv->handlers) {
+        self->priv->handlers->method_call(self, method_name, parameters, invocation,
+                                          self->priv->handlers_data);
+        return;
+    }
+
     g_signal_emit(self, signals[SIGNAL_HANDLE_METHOD], 0, method_name, parameters, invocation);
 }
 
+static GVariant *
+get_property_value(GjsDBusImplementation *self,
+                   const char            *property_name)
+{
+    GVariant *value;
+
+    if (self->priv->handlers)
+        return self->priv->handlers->get_property(self, property_name,
+                                                  self->priv->handlers_data);
+
+    g_signal_emit(self, signals[SIGNAL_HANDLE_PROPERTY_GET], 0, property_name, &value);
+    return value;
+}
+
 static GVariant *
 gjs_dbus_implementation_property_get(GDBusConnection       *connection,
                                      const char            *sender,
@@ -59,7 +83,7 @@ gjs_dbus_implementation_property_get(GDBusConnection       *connection,
     GjsDBusImplementation *self = GJS_DBUS_IMPLEMENTATION (user_data);
     GVariant *value;
 
-    g_signal_emit(self, signals[SIGNAL_HANDLE_PROPERTY_GET], 0, property_name, &value);
+    value = get_property_value(self, property_name);
 
     /* Marshaling GErrors is not supported, so this is the best we can do
        (GIO will assert if value is NULL and error is not set) */
@@ -81,7 +105,11 @@ gjs_dbus_implementation_property_set(GDBusConnection       *connection,
 {
     GjsDBusImplementation *self = GJS_DBUS_IMPLEMENTATION (user_data);
 
-    g_signal_emit(self, signals[SIGNAL_HANDLE_PROPERTY_SET], 0, property_name, value);
+    if (self->priv->handlers)
+        self->priv->handlers->set_property(self, property_name, value,
+                                           self->priv->handlers_data);
+    else
+        g_signal_emit(self, signals[SIGNAL_HANDLE_PROPERTY_SET], 0, property_name, value);
 
     return TRUE;
 }
@@ -106,6 +134,9 @@ gjs_dbus_implementation_finalize(GObject *object) {
     g_dbus_interface_info_unref (self->priv->ifaceinfo);
     g_hash_table_unref (self->priv->outstanding_properties);
 
+    if (self->priv->handlers_notify)
+        self->priv->handlers_notify (self->priv->handlers_data);
+
     G_OBJECT_CLASS(gjs_dbus_implementation_parent_class)->finalize(object);
 }
 
@@ -151,14 +182,24 @@ gjs_dbus_implementation_get_properties (GDBusInterfaceSkeleton *skeleton) {
         GDBusPropertyInfo *prop = *props;
         GVariant *value;
 
+        if (!(prop->flags & G_DBUS_PROPERTY_INFO_FLAGS_READABLE))
+            continue;
+
         /* If we have a cached value, we use that instead of querying again */
         if ((value = g_hash_table_lookup(self->priv->outstanding_properties, prop->name))) {
             g_variant_builder_add(&builder, "{sv}", prop->name, value);
             continue;
         }
 
-        g_signal_emit(self, signals[SIGNAL_HANDLE_PROPERTY_GET], 0, prop->name, &value);
+        /* With handlers set this is a direct call, not a signal
+           emission per property */
+        value = get_property_value(self, prop->name);
+        if (value == NULL)
+            continue;
+
+        g_variant_ref_sink(value);
         g_variant_builder_add(&builder, "{sv}", prop->name, value);
+        g_variant_unref(value);
     }
 
     return g_variant_builder_end(&builder);
@@ -263,6 +304,31 @@ gjs_dbus_implementation_class_init(GjsDBusImplementationClass *klass) {
                                                        G_TYPE_VARIANT /* parameters */);
 }
 
+/**
+ * gjs_dbus_implementation_set_handlers: (skip)
+ * @self: a #GjsDBusImplementation
+ * @handlers: the functions to call for method calls and property accesses
+ * @user_data: data passed to @handlers
+ * @notify: called on @user_data when @self is finalized
+ *
+ * Makes @self call @handlers directly instead of emitting the
+ * handle-method-call, handle-property-get and handle-property-set
+ * signals. Can only be called once.
+ */
+void
+gjs_dbus_implementation_set_handlers (GjsDBusImplementation               *self,
+                                      const GjsDBusImplementationHandlers *handlers,
+                                      gpointer                             user_data,
+                                      GDestroyNotify                       notify)
+{
+    g_return_if_fail (GJS_IS_DBUS_IMPLEMENTATION (self));
+    g_return_if_fail (self->priv->handlers == NULL);
+
+    self->priv->handlers = handlers;
+    self->priv->handlers_data = user_data;
+    self->priv->handlers_notify = notify;
+}
+
 static gboolean
 idle_cb (gpointer data) {
     GDBusInterfaceSkeleton *skeleton = G_DBUS_INTERFACE_SKELETON (data);
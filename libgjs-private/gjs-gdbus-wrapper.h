@@ -55,6 +55,30 @@ GType                  gjs_dbus_implementation_get_type (void);
 void                   gjs_dbus_implementation_emit_property_changed (GjsDBusImplementation *self, gchar *property, GVariant *newvalue);
 void                   gjs_dbus_implementation_emit_signal           (GjsDBusImplementation *self, gchar *signal_name, GVariant *parameters);
 
+#ifndef __GI_SCANNER__
+/* Used by gjs itself to dispatch calls without going through the
+ * handle-* signals */
+typedef struct {
+    void       (*method_call)  (GjsDBusImplementation *self,
+                                const char            *method_name,
+                                GVariant              *parameters,
+                                GDBusMethodInvocation *invocation,
+                                gpointer               user_data);
+    GVariant * (*get_property) (GjsDBusImplementation *self,
+                                const char            *property_name,
+                                gpointer               user_data);
+    void       (*set_property) (GjsDBusImplementation *self,
+                                const char            *property_name,
+                                GVariant              *value,
+                                gpointer               user_data);
+} GjsDBusImplementationHandlers;
+
+void                   gjs_dbus_implementation_set_handlers          (GjsDBusImplementation               *self,
+                                                                      const GjsDBusImplementationHandlers *handlers,
+                                                                      gpointer                             user_data,
+                                                                      GDestroyNotify                       notify);
+#endif
+
 G_END_DECLS
 
 #endif  /* __GJS_UTIL_DBUS_H__ */
@@ -48,3 +48,63 @@ gjs_bindtextdomain(const char *domain,
     /* Always use UTF-8; we assume it internally here */
     bind_textdomain_codeset(domain, "UTF-8");
 }
+
+/* A source that is only ever woken by g_source_set_ready_time(); the
+ * mainloop timer wheel drives all of its timers with one of these.
+ */
+static gboolean
+timer_source_dispatch(GSource     *source,
+                      GSourceFunc  callback,
+                      gpointer     user_data)
+{
+    g_source_set_ready_time(source, -1);
+
+    if (callback == NULL)
+        return G_SOURCE_REMOVE;
+
+    return callback(user_data);
+}
+
+static gboolean
+timer_source_closure_callback(gpointer data)
+{
+    GClosure *closure = data;
+    GValue result_value = G_VALUE_INIT;
+    gboolean result;
+
+    g_value_init(&result_value, G_TYPE_BOOLEAN);
+    g_closure_invoke(closure, &result_value, 0, NULL, NULL);
+    result = g_value_get_boolean(&result_value);
+    g_value_unset(&result_value);
+
+    return result;
+}
+
+static GSourceFuncs timer_source_funcs = {
+    NULL, /* prepare */
+    NULL, /* check */
+    timer_source_dispatch,
+    NULL, /* finalize */
+    (GSourceFunc) timer_source_closure_callback,
+    NULL  /* closure_marshal */
+};
+
+/**
+ * gjs_timer_source_new:
+ *
+ * Creates a source that dispatches only when its ready time, set with
+ * g_source_set_ready_time(), is reached. The ready time is reset to -1
+ * on every dispatch.
+ *
+ * Returns: (transfer full): a new #GSource
+ */
+GSource *
+gjs_timer_source_new(void)
+{
+    GSource *source;
+
+    source = g_source_new(&timer_source_funcs, sizeof(GSource));
+    g_source_set_name(source, "[gjs] timer wheel");
+
+    return source;
+}
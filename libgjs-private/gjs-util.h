@@ -23,7 +23,7 @@
 #ifndef __GJS_PRIVATE_UTIL_H__
 #define __GJS_PRIVATE_UTIL_H__
 
-#include <glib.h>
+#include <glib-object.h>
 
 G_BEGIN_DECLS
 
@@ -35,6 +35,9 @@ void gjs_textdomain     (const char *domain);
 void gjs_bindtextdomain (const char *domain,
                          const char *location);
 
+/* For imports.mainloop */
+GSource * gjs_timer_source_new (void);
+
 G_END_DECLS
 
 #endif
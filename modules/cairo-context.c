@@ -50,6 +50,28 @@ mname##_func(JSContext *context,                    \
         return JS_FALSE;                                           \
     }
 
+/* Argument conversion is resolved at compile time: each argument is
+ * given as a gjs_parse_args() format character, a C type and a name,
+ * and is converted by the matching inline GJS_PARSE_ARG() helper.
+ * The argN variables are declared at the top of the function; the
+ * conversions are blocks of their own, so that they can be followed
+ * by more declarations.
+ */
+#define _GJS_CAIRO_CONTEXT_GET_ARGS(m, n)                                  \
+    {                                                                      \
+        if (!GJS_CHECK_N_ARGS(context, #m, argc, n))                       \
+            return JS_FALSE;                                               \
+    }
+
+#define _GJS_CAIRO_CONTEXT_GET_ARG(m, i, k, t, n)                          \
+    {                                                                      \
+        jsval *argv = JS_ARGV(context, vp);                                \
+        GJS_ARG_CTYPE(k) value;                                            \
+        if (!GJS_PARSE_ARG(context, #m, k, argv, i - 1, #n, &value))       \
+            return JS_FALSE;                                               \
+        arg##i = (t) value;                                                \
+    }
+
 #define _GJS_CAIRO_CONTEXT_DEFINE_FUNC0(method, cfunc)                     \
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC_BEGIN(method)                               \
     cr = gjs_cairo_context_get_context(context, obj);                      \
@@ -78,9 +100,9 @@ _GJS_CAIRO_CONTEXT_DEFINE_FUNC_END
 #define _GJS_CAIRO_CONTEXT_DEFINE_FUNC2FFAFF(method, cfunc, n1, n2)        \
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC_BEGIN(method)                               \
     double arg1, arg2;                                                     \
-    if (!gjs_parse_args(context, #method, "ff", argc, JS_ARGV(context, vp), \
-                        #n1, &arg1, #n2, &arg2))                           \
-        return JS_FALSE;                                                   \
+    _GJS_CAIRO_CONTEXT_GET_ARGS(method, 2)                                 \
+    _GJS_CAIRO_CONTEXT_GET_ARG(method, 1, f, double, n1)                   \
+    _GJS_CAIRO_CONTEXT_GET_ARG(method, 2, f, double, n2)                   \
     cr = gjs_cairo_context_get_context(context, obj);                      \
     cfunc(cr, &arg1, &arg2);                                               \
     if (cairo_status(cr) == CAIRO_STATUS_SUCCESS) {                        \
@@ -150,85 +172,89 @@ _GJS_CAIRO_CONTEXT_DEFINE_FUNC_BEGIN(method)                               \
     JS_SET_RVAL(context, vp, retval);                                      \
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC_END
 
-#define _GJS_CAIRO_CONTEXT_DEFINE_FUNC1(method, cfunc, fmt, t1, n1)        \
+#define _GJS_CAIRO_CONTEXT_DEFINE_FUNC1(method, cfunc, k1, t1, n1)         \
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC_BEGIN(method)                               \
     t1 arg1;                                                               \
-    if (!gjs_parse_args(context, #method, fmt, argc, JS_ARGV(context, vp), \
-                        #n1, &arg1))                                       \
-        return JS_FALSE;                                                   \
+    _GJS_CAIRO_CONTEXT_GET_ARGS(method, 1)                                 \
+    _GJS_CAIRO_CONTEXT_GET_ARG(method, 1, k1, t1, n1)                      \
     cr = gjs_cairo_context_get_context(context, obj);                      \
     cfunc(cr, arg1);                                                       \
     JS_SET_RVAL(context, vp, JSVAL_VOID);                                  \
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC_END
 
-#define _GJS_CAIRO_CONTEXT_DEFINE_FUNC2(method, cfunc, fmt, t1, n1, t2, n2) \
+#define _GJS_CAIRO_CONTEXT_DEFINE_FUNC2(method, cfunc, k1, t1, n1, k2, t2, n2) \
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC_BEGIN(method)                               \
     t1 arg1;                                                               \
     t2 arg2;                                                               \
-    if (!gjs_parse_args(context, #method, fmt, argc, JS_ARGV(context, vp),                 \
-                        #n1, &arg1, #n2, &arg2))                           \
-        return JS_FALSE;                                                   \
+    _GJS_CAIRO_CONTEXT_GET_ARGS(method, 2)                                 \
+    _GJS_CAIRO_CONTEXT_GET_ARG(method, 1, k1, t1, n1)                      \
+    _GJS_CAIRO_CONTEXT_GET_ARG(method, 2, k2, t2, n2)                      \
     cr = gjs_cairo_context_get_context(context, obj);                      \
     cfunc(cr, arg1, arg2);                                                 \
     JS_SET_RVAL(context, vp, JSVAL_VOID);                                  \
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC_END
 
-#define _GJS_CAIRO_CONTEXT_DEFINE_FUNC2B(method, cfunc, fmt, t1, n1, t2, n2) \
+#define _GJS_CAIRO_CONTEXT_DEFINE_FUNC2B(method, cfunc, k1, t1, n1, k2, t2, n2) \
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC_BEGIN(method)                               \
+    cairo_bool_t ret;                                                      \
     t1 arg1;                                                               \
     t2 arg2;                                                               \
-    cairo_bool_t ret;                                                      \
-    if (!gjs_parse_args(context, #method, fmt, argc, JS_ARGV(context, vp),                 \
-                        #n1, &arg1, #n2, &arg2))                           \
-        return JS_FALSE;                                                   \
+    _GJS_CAIRO_CONTEXT_GET_ARGS(method, 2)                                 \
+    _GJS_CAIRO_CONTEXT_GET_ARG(method, 1, k1, t1, n1)                      \
+    _GJS_CAIRO_CONTEXT_GET_ARG(method, 2, k2, t2, n2)                      \
     cr = gjs_cairo_context_get_context(context, obj);                      \
     ret = cfunc(cr, arg1, arg2);                                           \
     JS_SET_RVAL(context, vp, BOOLEAN_TO_JSVAL(ret));                       \
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC_END
 
-#define _GJS_CAIRO_CONTEXT_DEFINE_FUNC3(method, cfunc, fmt, t1, n1, t2, n2, t3, n3) \
+#define _GJS_CAIRO_CONTEXT_DEFINE_FUNC3(method, cfunc, k1, t1, n1, k2, t2, n2, k3, t3, n3) \
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC_BEGIN(method)                               \
     t1 arg1;                                                               \
     t2 arg2;                                                               \
     t3 arg3;                                                               \
-    if (!gjs_parse_args(context, #method, fmt, argc, JS_ARGV(context, vp),                 \
-                        #n1, &arg1, #n2, &arg2, #n3, &arg3))               \
-        return JS_FALSE;                                                   \
+    _GJS_CAIRO_CONTEXT_GET_ARGS(method, 3)                                 \
+    _GJS_CAIRO_CONTEXT_GET_ARG(method, 1, k1, t1, n1)                      \
+    _GJS_CAIRO_CONTEXT_GET_ARG(method, 2, k2, t2, n2)                      \
+    _GJS_CAIRO_CONTEXT_GET_ARG(method, 3, k3, t3, n3)                      \
     cr = gjs_cairo_context_get_context(context, obj);                      \
     cfunc(cr, arg1, arg2, arg3);                                           \
     JS_SET_RVAL(context, vp, JSVAL_VOID);                                  \
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC_END
 
-#define _GJS_CAIRO_CONTEXT_DEFINE_FUNC4(method, cfunc, fmt, t1, n1, t2, n2, t3, n3, t4, n4) \
+#define _GJS_CAIRO_CONTEXT_DEFINE_FUNC4(method, cfunc, k1, t1, n1, k2, t2, n2, k3, t3, n3, k4, t4, n4) \
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC_BEGIN(method)                               \
     t1 arg1;                                                               \
     t2 arg2;                                                               \
     t3 arg3;                                                               \
     t4 arg4;                                                               \
-    if (!gjs_parse_args(context, #method, fmt, argc, JS_ARGV(context, vp),                 \
-                        #n1, &arg1, #n2, &arg2, #n3, &arg3, #n4, &arg4))   \
-        return JS_FALSE;                                                   \
+    _GJS_CAIRO_CONTEXT_GET_ARGS(method, 4)                                 \
+    _GJS_CAIRO_CONTEXT_GET_ARG(method, 1, k1, t1, n1)                      \
+    _GJS_CAIRO_CONTEXT_GET_ARG(method, 2, k2, t2, n2)                      \
+    _GJS_CAIRO_CONTEXT_GET_ARG(method, 3, k3, t3, n3)                      \
+    _GJS_CAIRO_CONTEXT_GET_ARG(method, 4, k4, t4, n4)                      \
     cr = gjs_cairo_context_get_context(context, obj);                      \
     cfunc(cr, arg1, arg2, arg3, arg4);                                     \
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC_END
 
-#define _GJS_CAIRO_CONTEXT_DEFINE_FUNC5(method, cfunc, fmt, t1, n1, t2, n2, t3, n3, t4, n4, t5, n5) \
+#define _GJS_CAIRO_CONTEXT_DEFINE_FUNC5(method, cfunc, k1, t1, n1, k2, t2, n2, k3, t3, n3, k4, t4, n4, k5, t5, n5) \
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC_BEGIN(method)                               \
     t1 arg1;                                                               \
     t2 arg2;                                                               \
     t3 arg3;                                                               \
     t4 arg4;                                                               \
     t5 arg5;                                                               \
-    if (!gjs_parse_args(context, #method, fmt, argc, JS_ARGV(context, vp),                 \
-                        #n1, &arg1, #n2, &arg2, #n3, &arg3,                \
-                        #n4, &arg4, #n5, &arg5))                           \
-        return JS_FALSE;                                                   \
+    _GJS_CAIRO_CONTEXT_GET_ARGS(method, 5)                                 \
+    _GJS_CAIRO_CONTEXT_GET_ARG(method, 1, k1, t1, n1)                      \
+    _GJS_CAIRO_CONTEXT_GET_ARG(method, 2, k2, t2, n2)                      \
+    _GJS_CAIRO_CONTEXT_GET_ARG(method, 3, k3, t3, n3)                      \
+    _GJS_CAIRO_CONTEXT_GET_ARG(method, 4, k4, t4, n4)                      \
+    _GJS_CAIRO_CONTEXT_GET_ARG(method, 5, k5, t5, n5)                      \
     cr = gjs_cairo_context_get_context(context, obj);                      \
     cfunc(cr, arg1, arg2, arg3, arg4, arg5);                               \
     JS_SET_RVAL(context, vp, JSVAL_VOID);                                  \
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC_END
 
-#define _GJS_CAIRO_CONTEXT_DEFINE_FUNC6(method, cfunc, fmt, t1, n1, t2, n2, t3, n3, t4, n4, t5, n5, t6, n6) \
+#define _GJS_CAIRO_CONTEXT_DEFINE_FUNC6(method, cfunc, k1, t1, n1, k2, t2, n2, k3, t3, n3, k4, t4, n4, k5, t5, n5, k6, t6, n6) \
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC_BEGIN(method)                               \
     t1 arg1;                                                               \
     t2 arg2;                                                               \
@@ -236,10 +262,13 @@ _GJS_CAIRO_CONTEXT_DEFINE_FUNC_BEGIN(method)                               \
     t4 arg4;                                                               \
     t5 arg5;                                                               \
     t6 arg6;                                                               \
-    if (!gjs_parse_args(context, #method, fmt, argc, JS_ARGV(context, vp),                 \
-                        #n1, &arg1, #n2, &arg2, #n3, &arg3,                \
-                        #n4, &arg4, #n5, &arg5, #n6, &arg6))               \
-        return JS_FALSE;                                                   \
+    _GJS_CAIRO_CONTEXT_GET_ARGS(method, 6)                                 \
+    _GJS_CAIRO_CONTEXT_GET_ARG(method, 1, k1, t1, n1)                      \
+    _GJS_CAIRO_CONTEXT_GET_ARG(method, 2, k2, t2, n2)                      \
+    _GJS_CAIRO_CONTEXT_GET_ARG(method, 3, k3, t3, n3)                      \
+    _GJS_CAIRO_CONTEXT_GET_ARG(method, 4, k4, t4, n4)                      \
+    _GJS_CAIRO_CONTEXT_GET_ARG(method, 5, k5, t5, n5)                      \
+    _GJS_CAIRO_CONTEXT_GET_ARG(method, 6, k6, t6, n6)                      \
     cr = gjs_cairo_context_get_context(context, obj);                      \
     cfunc(cr, arg1, arg2, arg3, arg4, arg5, arg6);                         \
     JS_SET_RVAL(context, vp, JSVAL_VOID);                                  \
@@ -326,15 +355,15 @@ static JSPropertySpec gjs_cairo_context_proto_props[] = {
 
 /* Methods */
 
-_GJS_CAIRO_CONTEXT_DEFINE_FUNC5(arc, cairo_arc, "fffff",
-                                double, xc, double, yc, double, radius,
-                                double, angle1, double, angle2)
-_GJS_CAIRO_CONTEXT_DEFINE_FUNC5(arcNegative, cairo_arc_negative, "fffff",
-                                double, xc, double, yc, double, radius,
-                                double, angle1, double, angle2)
-_GJS_CAIRO_CONTEXT_DEFINE_FUNC6(curveTo, cairo_curve_to, "ffffff",
-                                double, x1, double, y1, double, x2, double, y2,
-                                double, x3, double, y3)
+_GJS_CAIRO_CONTEXT_DEFINE_FUNC5(arc, cairo_arc,
+                                f, double, xc, f, double, yc, f, double, radius,
+                                f, double, angle1, f, double, angle2)
+_GJS_CAIRO_CONTEXT_DEFINE_FUNC5(arcNegative, cairo_arc_negative,
+                                f, double, xc, f, double, yc, f, double, radius,
+                                f, double, angle1, f, double, angle2)
+_GJS_CAIRO_CONTEXT_DEFINE_FUNC6(curveTo, cairo_curve_to,
+                                f, double, x1, f, double, y1, f, double, x2, f, double, y2,
+                                f, double, x3, f, double, y3)
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC0(clip, cairo_clip)
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC0(clipPreserve, cairo_clip_preserve)
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC0AFFFF(clipExtents, cairo_clip_extents)
@@ -357,49 +386,49 @@ _GJS_CAIRO_CONTEXT_DEFINE_FUNC0I(getOperator, cairo_get_operator)
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC0F(getTolerance, cairo_get_tolerance)
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC0B(hasCurrentPoint, cairo_has_current_point)
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC0(identityMatrix, cairo_identity_matrix)
-_GJS_CAIRO_CONTEXT_DEFINE_FUNC2B(inFill, cairo_in_fill, "ff", double, x, double, y)
-_GJS_CAIRO_CONTEXT_DEFINE_FUNC2B(inStroke, cairo_in_stroke, "ff", double, x, double, y)
-_GJS_CAIRO_CONTEXT_DEFINE_FUNC2(lineTo, cairo_line_to, "ff", double, x, double, y)
-_GJS_CAIRO_CONTEXT_DEFINE_FUNC2(moveTo, cairo_move_to, "ff", double, x, double, y)
+_GJS_CAIRO_CONTEXT_DEFINE_FUNC2B(inFill, cairo_in_fill, f, double, x, f, double, y)
+_GJS_CAIRO_CONTEXT_DEFINE_FUNC2B(inStroke, cairo_in_stroke, f, double, x, f, double, y)
+_GJS_CAIRO_CONTEXT_DEFINE_FUNC2(lineTo, cairo_line_to, f, double, x, f, double, y)
+_GJS_CAIRO_CONTEXT_DEFINE_FUNC2(moveTo, cairo_move_to, f, double, x, f, double, y)
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC0(newPath, cairo_new_path)
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC0(newSubPath, cairo_new_sub_path)
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC0(paint, cairo_paint)
-_GJS_CAIRO_CONTEXT_DEFINE_FUNC1(paintWithAlpha, cairo_paint_with_alpha, "f", double, alpha)
+_GJS_CAIRO_CONTEXT_DEFINE_FUNC1(paintWithAlpha, cairo_paint_with_alpha, f, double, alpha)
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC0AFFFF(pathExtents, cairo_path_extents)
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC0(pushGroup, cairo_push_group)
-_GJS_CAIRO_CONTEXT_DEFINE_FUNC1(pushGroupWithContent, cairo_push_group_with_content, "i",
-                                cairo_content_t, content)
+_GJS_CAIRO_CONTEXT_DEFINE_FUNC1(pushGroupWithContent, cairo_push_group_with_content,
+                                i, cairo_content_t, content)
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC0(popGroupToSource, cairo_pop_group_to_source)
-_GJS_CAIRO_CONTEXT_DEFINE_FUNC4(rectangle, cairo_rectangle, "ffff",
-                                double, x, double, y, double, width, double, height)
-_GJS_CAIRO_CONTEXT_DEFINE_FUNC6(relCurveTo, cairo_rel_curve_to, "ffffff",
-                                double, dx1, double, dy1, double, dx2, double, dy2,
-                                double, dx3, double, dy3)
-_GJS_CAIRO_CONTEXT_DEFINE_FUNC2(relLineTo, cairo_rel_line_to, "ff", double, dx, double, dy)
-_GJS_CAIRO_CONTEXT_DEFINE_FUNC2(relMoveTo, cairo_rel_move_to, "ff", double, dx, double, dy)
+_GJS_CAIRO_CONTEXT_DEFINE_FUNC4(rectangle, cairo_rectangle,
+                                f, double, x, f, double, y, f, double, width, f, double, height)
+_GJS_CAIRO_CONTEXT_DEFINE_FUNC6(relCurveTo, cairo_rel_curve_to,
+                                f, double, dx1, f, double, dy1, f, double, dx2, f, double, dy2,
+                                f, double, dx3, f, double, dy3)
+_GJS_CAIRO_CONTEXT_DEFINE_FUNC2(relLineTo, cairo_rel_line_to, f, double, dx, f, double, dy)
+_GJS_CAIRO_CONTEXT_DEFINE_FUNC2(relMoveTo, cairo_rel_move_to, f, double, dx, f, double, dy)
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC0(resetClip, cairo_reset_clip)
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC0(restore, cairo_restore)
-_GJS_CAIRO_CONTEXT_DEFINE_FUNC1(rotate, cairo_rotate, "f", double, angle)
+_GJS_CAIRO_CONTEXT_DEFINE_FUNC1(rotate, cairo_rotate, f, double, angle)
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC0(save, cairo_save)
-_GJS_CAIRO_CONTEXT_DEFINE_FUNC2(scale, cairo_scale, "ff", double, sx, double, sy)
-_GJS_CAIRO_CONTEXT_DEFINE_FUNC1(setAntialias, cairo_set_antialias, "i", cairo_antialias_t, antialias)
-_GJS_CAIRO_CONTEXT_DEFINE_FUNC1(setFillRule, cairo_set_fill_rule, "i", cairo_fill_rule_t, fill_rule)
-_GJS_CAIRO_CONTEXT_DEFINE_FUNC1(setFontSize, cairo_set_font_size, "f", double, size)
-_GJS_CAIRO_CONTEXT_DEFINE_FUNC1(setLineCap, cairo_set_line_cap, "i", cairo_line_cap_t, line_cap)
-_GJS_CAIRO_CONTEXT_DEFINE_FUNC1(setLineJoin, cairo_set_line_join, "i", cairo_line_join_t, line_join)
-_GJS_CAIRO_CONTEXT_DEFINE_FUNC1(setLineWidth, cairo_set_line_width, "f", double, width)
-_GJS_CAIRO_CONTEXT_DEFINE_FUNC1(setMiterLimit, cairo_set_miter_limit, "f", double, limit)
-_GJS_CAIRO_CONTEXT_DEFINE_FUNC1(setOperator, cairo_set_operator, "i", cairo_operator_t, op)
-_GJS_CAIRO_CONTEXT_DEFINE_FUNC1(setTolerance, cairo_set_tolerance, "f", double, tolerance)
-_GJS_CAIRO_CONTEXT_DEFINE_FUNC3(setSourceRGB, cairo_set_source_rgb, "fff",
-                                double, red, double, green, double, blue)
-_GJS_CAIRO_CONTEXT_DEFINE_FUNC4(setSourceRGBA, cairo_set_source_rgba, "ffff",
-                                double, red, double, green, double, blue, double, alpha)
+_GJS_CAIRO_CONTEXT_DEFINE_FUNC2(scale, cairo_scale, f, double, sx, f, double, sy)
+_GJS_CAIRO_CONTEXT_DEFINE_FUNC1(setAntialias, cairo_set_antialias, i, cairo_antialias_t, antialias)
+_GJS_CAIRO_CONTEXT_DEFINE_FUNC1(setFillRule, cairo_set_fill_rule, i, cairo_fill_rule_t, fill_rule)
+_GJS_CAIRO_CONTEXT_DEFINE_FUNC1(setFontSize, cairo_set_font_size, f, double, size)
+_GJS_CAIRO_CONTEXT_DEFINE_FUNC1(setLineCap, cairo_set_line_cap, i, cairo_line_cap_t, line_cap)
+_GJS_CAIRO_CONTEXT_DEFINE_FUNC1(setLineJoin, cairo_set_line_join, i, cairo_line_join_t, line_join)
+_GJS_CAIRO_CONTEXT_DEFINE_FUNC1(setLineWidth, cairo_set_line_width, f, double, width)
+_GJS_CAIRO_CONTEXT_DEFINE_FUNC1(setMiterLimit, cairo_set_miter_limit, f, double, limit)
+_GJS_CAIRO_CONTEXT_DEFINE_FUNC1(setOperator, cairo_set_operator, i, cairo_operator_t, op)
+_GJS_CAIRO_CONTEXT_DEFINE_FUNC1(setTolerance, cairo_set_tolerance, f, double, tolerance)
+_GJS_CAIRO_CONTEXT_DEFINE_FUNC3(setSourceRGB, cairo_set_source_rgb,
+                                f, double, red, f, double, green, f, double, blue)
+_GJS_CAIRO_CONTEXT_DEFINE_FUNC4(setSourceRGBA, cairo_set_source_rgba,
+                                f, double, red, f, double, green, f, double, blue, f, double, alpha)
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC0(showPage, cairo_show_page)
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC0(stroke, cairo_stroke)
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC0(strokePreserve, cairo_stroke_preserve)
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC0AFFFF(strokeExtents, cairo_stroke_extents)
-_GJS_CAIRO_CONTEXT_DEFINE_FUNC2(translate, cairo_translate, "ff", double, tx, double, ty)
+_GJS_CAIRO_CONTEXT_DEFINE_FUNC2(translate, cairo_translate, f, double, tx, f, double, ty)
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC2FFAFF(userToDevice, cairo_user_to_device, "x", "y")
 _GJS_CAIRO_CONTEXT_DEFINE_FUNC2FFAFF(userToDeviceDistance, cairo_user_to_device_distance, "x", "y")
 
@@ -487,6 +516,239 @@ copyPathFlat_func(JSContext *context,
     return JS_TRUE;
 }
 
+/* Reads a numeric array argument of the bulk path functions.  Typed
+ * arrays of the matching element type are used in place; anything
+ * else array-like is converted element by element into *copy_p, which
+ * the caller frees.
+ */
+static JSBool
+get_path_array(JSContext  *context,
+               const char *function_name,
+               const char *argname,
+               JSObject   *array_obj,
+               gboolean    floating,
+               gpointer   *data_p,
+               guint32    *length_p,
+               gpointer   *copy_p)
+{
+    gsize elem_size = floating ? sizeof(double) : sizeof(guint8);
+    guint32 length, i;
+    gpointer copy;
+
+    *copy_p = NULL;
+
+    if (gjs_is_typed_array_object(context, array_obj) &&
+        gjs_typed_array_is_compatible(context, array_obj, elem_size * 8, FALSE, floating)) {
+        *data_p = gjs_typed_array_get_data(context, array_obj);
+        *length_p = gjs_typed_array_get_length(context, array_obj);
+        return JS_TRUE;
+    }
+
+    if (!JS_GetArrayLength(context, array_obj, &length)) {
+        gjs_throw(context, "%s(): %s must be an array", function_name, argname);
+        return JS_FALSE;
+    }
+
+    if (length > G_MAXSIZE / elem_size) {
+        gjs_throw(context, "%s(): %s is too long", function_name, argname);
+        return JS_FALSE;
+    }
+
+    copy = g_malloc((gsize) length * elem_size);
+    for (i = 0; i < length; i++) {
+        jsval elem;
+        double number;
+
+        if (!JS_GetElement(context, array_obj, i, &elem) ||
+            !JS_ValueToNumber(context, elem, &number)) {
+            g_free(copy);
+            return JS_FALSE;
+        }
+
+        if (floating) {
+            ((double *) copy)[i] = number;
+        } else {
+            /* only path ops are read as bytes; anything else would be
+             * an undefined cast or wrap around into a valid op
+             */
+            if (!(number >= CAIRO_PATH_MOVE_TO && number <= CAIRO_PATH_CLOSE_PATH) ||
+                number != (int) number) {
+                gjs_throw_custom(context, "TypeError",
+                                 "%s(): %s[%u] is not a valid path op",
+                                 function_name, argname, i);
+                g_free(copy);
+                return JS_FALSE;
+            }
+            ((guint8 *) copy)[i] = (guint8) number;
+        }
+    }
+
+    *data_p = *copy_p = copy;
+    *length_p = length;
+    return JS_TRUE;
+}
+
+/* Number of coordinates each cairo_path_data_type_t consumes, or -1 */
+static int
+path_op_n_coords(guint8 op)
+{
+    switch (op) {
+    case CAIRO_PATH_MOVE_TO:
+    case CAIRO_PATH_LINE_TO:
+        return 2;
+    case CAIRO_PATH_CURVE_TO:
+        return 6;
+    case CAIRO_PATH_CLOSE_PATH:
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+static JSBool
+appendPathData_func(JSContext *context,
+                    unsigned   argc,
+                    jsval     *vp)
+{
+    jsval *argv = JS_ARGV(context, vp);
+    JSObject *obj = JS_THIS_OBJECT(context, vp);
+    JSObject *points_obj, *ops_obj;
+    gpointer points_data, ops_data;
+    gpointer points_copy = NULL, ops_copy = NULL;
+    guint32 n_coords, n_ops, i;
+    gsize needed;
+    const double *points;
+    const guint8 *ops;
+    JSBool retval = JS_FALSE;
+    cairo_t *cr;
+
+    if (!GJS_CHECK_N_ARGS(context, "appendPathData", argc, 2) ||
+        !GJS_PARSE_ARG(context, "appendPathData", o, argv, 0, "points", &points_obj) ||
+        !GJS_PARSE_ARG(context, "appendPathData", o, argv, 1, "ops", &ops_obj))
+        return JS_FALSE;
+
+    if (points_obj == NULL || ops_obj == NULL) {
+        gjs_throw(context, "appendPathData() takes two arrays");
+        return JS_FALSE;
+    }
+
+    if (!get_path_array(context, "appendPathData", "points", points_obj, TRUE,
+                        &points_data, &n_coords, &points_copy) ||
+        !get_path_array(context, "appendPathData", "ops", ops_obj, FALSE,
+                        &ops_data, &n_ops, &ops_copy))
+        goto out;
+
+    points = points_data;
+    ops = ops_data;
+
+    /* Validate everything first so a bad op doesn't leave half a path */
+    for (i = 0, needed = 0; i < n_ops; i++) {
+        int n = path_op_n_coords(ops[i]);
+        if (n < 0) {
+            gjs_throw_custom(context, "TypeError",
+                             "appendPathData(): ops[%u] is not a valid path op", i);
+            goto out;
+        }
+        needed += n;
+
+        /* checked as we go, so that needed can't overflow */
+        if (needed > n_coords) {
+            gjs_throw(context, "appendPathData(): ops need more than the %u coordinates given",
+                      n_coords);
+            goto out;
+        }
+    }
+
+    if (needed != n_coords) {
+        gjs_throw(context, "appendPathData(): ops need %" G_GSIZE_FORMAT " coordinates, got %u",
+                  needed, n_coords);
+        goto out;
+    }
+
+    cr = gjs_cairo_context_get_context(context, obj);
+
+    for (i = 0; i < n_ops; i++) {
+        switch (ops[i]) {
+        case CAIRO_PATH_MOVE_TO:
+            cairo_move_to(cr, points[0], points[1]);
+            break;
+        case CAIRO_PATH_LINE_TO:
+            cairo_line_to(cr, points[0], points[1]);
+            break;
+        case CAIRO_PATH_CURVE_TO:
+            cairo_curve_to(cr, points[0], points[1], points[2],
+                           points[3], points[4], points[5]);
+            break;
+        case CAIRO_PATH_CLOSE_PATH:
+            cairo_close_path(cr);
+            break;
+        }
+        points += path_op_n_coords(ops[i]);
+    }
+
+    if (!gjs_cairo_check_status(context, cairo_status(cr), "context"))
+        goto out;
+
+    JS_SET_RVAL(context, vp, JSVAL_VOID);
+    retval = JS_TRUE;
+
+ out:
+    g_free(points_copy);
+    g_free(ops_copy);
+    return retval;
+}
+
+static JSBool
+drawPolyline_func(JSContext *context,
+                  unsigned   argc,
+                  jsval     *vp)
+{
+    jsval *argv = JS_ARGV(context, vp);
+    JSObject *obj = JS_THIS_OBJECT(context, vp);
+    JSObject *points_obj;
+    gpointer points_data;
+    gpointer points_copy = NULL;
+    const double *points;
+    guint32 n_coords, i;
+    cairo_t *cr;
+
+    if (!GJS_CHECK_N_ARGS(context, "drawPolyline", argc, 1) ||
+        !GJS_PARSE_ARG(context, "drawPolyline", o, argv, 0, "points", &points_obj))
+        return JS_FALSE;
+
+    if (points_obj == NULL) {
+        gjs_throw(context, "drawPolyline() takes an array");
+        return JS_FALSE;
+    }
+
+    if (!get_path_array(context, "drawPolyline", "points", points_obj, TRUE,
+                        &points_data, &n_coords, &points_copy))
+        return JS_FALSE;
+
+    if (n_coords % 2 != 0) {
+        gjs_throw(context, "drawPolyline(): expected x, y pairs, got %u coordinates",
+                  n_coords);
+        g_free(points_copy);
+        return JS_FALSE;
+    }
+
+    points = points_data;
+    cr = gjs_cairo_context_get_context(context, obj);
+
+    if (n_coords > 0)
+        cairo_move_to(cr, points[0], points[1]);
+    for (i = 2; i < n_coords; i += 2)
+        cairo_line_to(cr, points[i], points[i + 1]);
+
+    g_free(points_copy);
+
+    if (!gjs_cairo_check_status(context, cairo_status(cr), "context"))
+        return JS_FALSE;
+
+    JS_SET_RVAL(context, vp, JSVAL_VOID);
+    return JS_TRUE;
+}
+
 static JSBool
 mask_func(JSContext *context,
           unsigned   argc,
@@ -873,6 +1135,7 @@ getGroupTarget_func(JSContext *context,
 static JSFunctionSpec gjs_cairo_context_proto_funcs[] = {
     { "$dispose", JSOP_WRAPPER((JSNative)dispose_func), 0, 0 },
     { "appendPath", JSOP_WRAPPER((JSNative)appendPath_func), 0, 0},
+    { "appendPathData", JSOP_WRAPPER((JSNative)appendPathData_func), 0, 0 },
     { "arc", JSOP_WRAPPER((JSNative)arc_func), 0, 0 },
     { "arcNegative", JSOP_WRAPPER((JSNative)arcNegative_func), 0, 0 },
     { "clip", JSOP_WRAPPER((JSNative)clip_func), 0, 0 },
@@ -885,6 +1148,7 @@ static JSFunctionSpec gjs_cairo_context_proto_funcs[] = {
     { "curveTo", JSOP_WRAPPER((JSNative)curveTo_func), 0, 0 },
     { "deviceToUser", JSOP_WRAPPER((JSNative)deviceToUser_func), 0, 0 },
     { "deviceToUserDistance",JSOP_WRAPPER((JSNative)deviceToUserDistance_func), 0, 0 },
+    { "drawPolyline", JSOP_WRAPPER((JSNative)drawPolyline_func), 0, 0 },
     { "fill", JSOP_WRAPPER((JSNative)fill_func), 0, 0 },
     { "fillPreserve", JSOP_WRAPPER((JSNative)fillPreserve_func), 0, 0 },
     { "fillExtents", JSOP_WRAPPER((JSNative)fillExtents_func), 0, 0 },
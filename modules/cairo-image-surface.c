@@ -22,29 +22,107 @@
 
 #include <config.h>
 
+#include <string.h>
+
 #include <gjs/gjs-module.h>
 #include <gjs/compat.h>
+#include <gjs/byteArray.h>
 #include <cairo.h>
 #include "cairo-private.h"
 
 GJS_DEFINE_PROTO("CairoImageSurface", cairo_image_surface)
 
+/* Surfaces created from JS-provided pixels own a copy of them, freed
+ * through this key once cairo is done with the surface.
+ */
+static const cairo_user_data_key_t storage_key;
+
+static cairo_surface_t *
+create_surface_for_data(JSContext     *context,
+                        cairo_format_t format,
+                        int            width,
+                        int            height,
+                        JSObject      *data_obj,
+                        int            stride)
+{
+    cairo_surface_t *surface;
+    guint8 *source;
+    gsize len, size;
+    guint8 *data;
+
+    if (stride < 0)
+        stride = cairo_format_stride_for_width(format, width);
+    if (stride < 0 || width < 0 || height < 0) {
+        gjs_throw(context, "ImageSurface: invalid format or size");
+        return NULL;
+    }
+
+    /* The pixels are copied into storage of the surface's own: cairo
+     * writes to it, and ByteArray storage may be an immutable GBytes
+     * shared with others, while ArrayBuffer storage belongs to the JS
+     * heap and can't be pinned past a GC here.
+     */
+    if (gjs_typecheck_bytearray(context, data_obj, JS_FALSE)) {
+        gjs_byte_array_peek_data(context, data_obj, &source, &len);
+    } else if (gjs_is_array_buffer_object(context, data_obj)) {
+        source = gjs_array_buffer_get_data(context, data_obj);
+        len = gjs_array_buffer_get_length(context, data_obj);
+    } else if (gjs_is_typed_array_object(context, data_obj) &&
+               gjs_typed_array_is_compatible(context, data_obj, 8, FALSE, FALSE)) {
+        source = gjs_typed_array_get_data(context, data_obj);
+        len = gjs_typed_array_get_length(context, data_obj);
+    } else {
+        gjs_throw_custom(context, "TypeError",
+                         "ImageSurface: data must be a ByteArray, ArrayBuffer or Uint8Array");
+        return NULL;
+    }
+
+    size = (gsize) stride * height;
+    if (len < size) {
+        gjs_throw(context, "ImageSurface: data is too small, need %" G_GSIZE_FORMAT " bytes",
+                  size);
+        return NULL;
+    }
+
+    data = g_malloc(size);
+    memcpy(data, source, size);
+
+    surface = cairo_image_surface_create_for_data(data, format, width, height, stride);
+    if (!gjs_cairo_check_status(context, cairo_surface_status(surface), "surface")) {
+        g_free(data);
+        return NULL;
+    }
+
+    cairo_surface_set_user_data(surface, &storage_key, data, g_free);
+    return surface;
+}
+
 GJS_NATIVE_CONSTRUCTOR_DECLARE(cairo_image_surface)
 {
     GJS_NATIVE_CONSTRUCTOR_VARIABLES(cairo_image_surface)
     int format, width, height;
+    JSObject *data_obj = NULL;
+    int stride = -1;
     cairo_surface_t *surface;
 
     GJS_NATIVE_CONSTRUCTOR_PRELUDE(cairo_image_surface);
 
-    // create_for_data optional parameter
-    if (!gjs_parse_args(context, "ImageSurface", "iii", argc, argv,
+    if (!gjs_parse_args(context, "ImageSurface", "iii|oi", argc, argv,
                         "format", &format,
                         "width", &width,
-                        "height", &height))
+                        "height", &height,
+                        "data", &data_obj,
+                        "stride", &stride))
         return JS_FALSE;
 
-    surface = cairo_image_surface_create(format, width, height);
+    if (data_obj != NULL) {
+        surface = create_surface_for_data(context, format, width, height,
+                                          data_obj, stride);
+        if (!surface)
+            return JS_FALSE;
+    } else {
+        surface = cairo_image_surface_create(format, width, height);
+    }
 
     if (!gjs_cairo_check_status(context, cairo_surface_status(surface), "surface"))
         return JS_FALSE;
@@ -99,6 +177,29 @@ createFromPNG_func(JSContext *context,
     return JS_TRUE;
 }
 
+static JSBool
+createFromPNGAsync_func(JSContext *context,
+                        unsigned   argc,
+                        jsval     *vp)
+{
+    jsval *argv = JS_ARGV(context, vp);
+    char *filename;
+    JSObject *callback;
+    JSBool ret;
+
+    if (!gjs_parse_args(context, "createFromPNGAsync", "so", argc, argv,
+                        "filename", &filename,
+                        "callback", &callback))
+        return JS_FALSE;
+
+    ret = gjs_cairo_surface_start_job(context, GJS_CAIRO_SURFACE_JOB_READ_PNG,
+                                      NULL, filename, callback);
+    g_free(filename);
+
+    JS_SET_RVAL(context, vp, JSVAL_VOID);
+    return ret;
+}
+
 static JSBool
 getFormat_func(JSContext *context,
                unsigned   argc,
@@ -195,9 +296,64 @@ getStride_func(JSContext *context,
     return JS_TRUE;
 }
 
+/* Returns the pixels as a ByteArray sharing the surface memory.  The
+ * surface is flushed first; drawing done afterwards shows through once
+ * flush() is called again.  Writing to the ByteArray detaches it onto
+ * a private copy, so pixels generated in JS should be handed to the
+ * ImageSurface constructor instead, which copies them.
+ */
+static JSBool
+getData_func(JSContext *context,
+             unsigned   argc,
+             jsval     *vp)
+{
+    JSObject *obj = JS_THIS_OBJECT(context, vp);
+    cairo_surface_t *surface;
+    GBytes *bytes;
+    guint8 *data;
+    JSObject *array;
+
+    if (argc > 0) {
+        gjs_throw(context, "ImageSurface.getData() takes no arguments");
+        return JS_FALSE;
+    }
+
+    surface = gjs_cairo_surface_get_surface(context, obj);
+    cairo_surface_flush(surface);
+    data = cairo_image_surface_get_data(surface);
+
+    if (!gjs_cairo_check_status(context, cairo_surface_status(surface), "surface"))
+        return JS_FALSE;
+
+    if (data == NULL) {
+        gjs_throw(context, "ImageSurface.getData(): surface has no pixel data");
+        return JS_FALSE;
+    }
+
+    bytes = cairo_surface_get_user_data(surface, &storage_key);
+    if (bytes != NULL) {
+        g_bytes_ref(bytes);
+    } else {
+        gsize len = (gsize) cairo_image_surface_get_stride(surface) *
+            cairo_image_surface_get_height(surface);
+        bytes = g_bytes_new_with_free_func(data, len,
+                                           (GDestroyNotify) cairo_surface_destroy,
+                                           cairo_surface_reference(surface));
+    }
+
+    array = gjs_byte_array_from_bytes(context, bytes);
+    g_bytes_unref(bytes);
+    if (!array)
+        return JS_FALSE;
+
+    JS_SET_RVAL(context, vp, OBJECT_TO_JSVAL(array));
+    return JS_TRUE;
+}
+
 static JSFunctionSpec gjs_cairo_image_surface_proto_funcs[] = {
     { "createFromPNG", JSOP_WRAPPER((JSNative)createFromPNG_func), 0, 0},
-    // getData
+    { "createFromPNGAsync", JSOP_WRAPPER((JSNative)createFromPNGAsync_func), 0, 0 },
+    { "getData", JSOP_WRAPPER((JSNative)getData_func), 0, 0 },
     { "getFormat", JSOP_WRAPPER((JSNative)getFormat_func), 0, 0 },
     { "getWidth", JSOP_WRAPPER((JSNative)getWidth_func), 0, 0 },
     { "getHeight", JSOP_WRAPPER((JSNative)getHeight_func), 0, 0 },
@@ -235,4 +391,10 @@ gjs_cairo_image_surface_init(JSContext *context, JSObject *module_obj)
                            (JSNative)createFromPNG_func,
                            1, GJS_MODULE_PROP_FLAGS))
         return;
+
+    if (!JS_DefineFunction(context, module_obj,
+                           "createFromPNGAsync",
+                           (JSNative)createFromPNGAsync_func,
+                           2, GJS_MODULE_PROP_FLAGS))
+        return;
 }
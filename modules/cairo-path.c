@@ -53,7 +53,75 @@ static JSPropertySpec gjs_cairo_path_proto_props[] = {
     { NULL }
 };
 
+/* Returns the path as { ops: Uint8Array, points: Float64Array }, the
+ * same layout Context.appendPathData() takes, so paths can be
+ * inspected or edited without walking an opaque object.
+ */
+static JSBool
+getData_func(JSContext *context,
+             unsigned   argc,
+             jsval     *vp)
+{
+    JSObject *obj = JS_THIS_OBJECT(context, vp);
+    GjsCairoPath *priv;
+    cairo_path_t *path;
+    JSObject *result, *ops_obj, *points_obj;
+    guint8 *ops;
+    double *points;
+    guint32 n_ops = 0, n_coords = 0;
+    jsval value;
+    int i, j;
+
+    if (argc > 0) {
+        gjs_throw(context, "Path.getData() takes no arguments");
+        return JS_FALSE;
+    }
+
+    priv = priv_from_js(context, obj);
+    if (priv == NULL)
+        return JS_FALSE;
+    path = priv->path;
+
+    for (i = 0; i < path->num_data; i += path->data[i].header.length) {
+        n_ops++;
+        n_coords += 2 * (path->data[i].header.length - 1);
+    }
+
+    result = JS_NewObject(context, NULL, NULL, NULL);
+    if (!result)
+        return JS_FALSE;
+    JS_SET_RVAL(context, vp, OBJECT_TO_JSVAL(result));
+
+    ops_obj = gjs_typed_array_new(context, 8, FALSE, FALSE, n_ops);
+    if (!ops_obj)
+        return JS_FALSE;
+    value = OBJECT_TO_JSVAL(ops_obj);
+    if (!JS_SetProperty(context, result, "ops", &value))
+        return JS_FALSE;
+
+    points_obj = gjs_typed_array_new(context, 64, TRUE, TRUE, n_coords);
+    if (!points_obj)
+        return JS_FALSE;
+    value = OBJECT_TO_JSVAL(points_obj);
+    if (!JS_SetProperty(context, result, "points", &value))
+        return JS_FALSE;
+
+    ops = gjs_typed_array_get_data(context, ops_obj);
+    points = gjs_typed_array_get_data(context, points_obj);
+
+    for (i = 0; i < path->num_data; i += path->data[i].header.length) {
+        *ops++ = path->data[i].header.type;
+        for (j = 1; j < path->data[i].header.length; j++) {
+            *points++ = path->data[i + j].point.x;
+            *points++ = path->data[i + j].point.y;
+        }
+    }
+
+    return JS_TRUE;
+}
+
 static JSFunctionSpec gjs_cairo_path_proto_funcs[] = {
+    { "getData", JSOP_WRAPPER((JSNative)getData_func), 0, 0 },
     { NULL }
 };
 
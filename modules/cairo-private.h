@@ -67,6 +67,18 @@ JSObject *       gjs_cairo_surface_from_surface         (JSContext       *contex
 cairo_surface_t* gjs_cairo_surface_get_surface          (JSContext       *context,
                                                          JSObject        *object);
 
+typedef enum {
+    GJS_CAIRO_SURFACE_JOB_WRITE_PNG,
+    GJS_CAIRO_SURFACE_JOB_READ_PNG,
+    GJS_CAIRO_SURFACE_JOB_FINISH
+} GjsCairoSurfaceJob;
+
+JSBool           gjs_cairo_surface_start_job            (JSContext          *context,
+                                                         GjsCairoSurfaceJob  job,
+                                                         cairo_surface_t    *surface,
+                                                         const char         *filename,
+                                                         JSObject           *callback);
+
 /* image surface */
 jsval            gjs_cairo_image_surface_create_proto   (JSContext       *context,
                                                          JSObject        *module,
@@ -25,6 +25,8 @@
 #include <gjs/gjs-module.h>
 #include <gjs/compat.h>
 #include <gi/foreign.h>
+#include <gi/closure.h>
+#include <gio/gio.h>
 #include <cairo.h>
 #include "cairo-private.h"
 
@@ -108,13 +110,303 @@ getType_func(JSContext *context,
     return JS_TRUE;
 }
 
+static JSBool
+flush_func(JSContext *context,
+           unsigned   argc,
+           jsval     *vp)
+{
+    JSObject *obj = JS_THIS_OBJECT(context, vp);
+    cairo_surface_t *surface;
+
+    if (argc > 0) {
+        gjs_throw(context, "Surface.flush() takes no arguments");
+        return JS_FALSE;
+    }
+
+    surface = gjs_cairo_surface_get_surface(context, obj);
+    cairo_surface_flush(surface);
+    if (!gjs_cairo_check_status(context, cairo_surface_status(surface),
+                                "surface"))
+        return JS_FALSE;
+
+    JS_SET_RVAL(context, vp, JSVAL_VOID);
+    return JS_TRUE;
+}
+
+static JSBool
+markDirty_func(JSContext *context,
+               unsigned   argc,
+               jsval     *vp)
+{
+    JSObject *obj = JS_THIS_OBJECT(context, vp);
+    cairo_surface_t *surface;
+
+    if (argc > 0) {
+        gjs_throw(context, "Surface.markDirty() takes no arguments");
+        return JS_FALSE;
+    }
+
+    surface = gjs_cairo_surface_get_surface(context, obj);
+    cairo_surface_mark_dirty(surface);
+    if (!gjs_cairo_check_status(context, cairo_surface_status(surface),
+                                "surface"))
+        return JS_FALSE;
+
+    JS_SET_RVAL(context, vp, JSVAL_VOID);
+    return JS_TRUE;
+}
+
+static JSBool
+markDirtyRectangle_func(JSContext *context,
+                        unsigned   argc,
+                        jsval     *vp)
+{
+    jsval *argv = JS_ARGV(context, vp);
+    JSObject *obj = JS_THIS_OBJECT(context, vp);
+    cairo_surface_t *surface;
+    gint32 x, y, width, height;
+
+    if (!GJS_CHECK_N_ARGS(context, "markDirtyRectangle", argc, 4) ||
+        !GJS_PARSE_ARG(context, "markDirtyRectangle", i, argv, 0, "x", &x) ||
+        !GJS_PARSE_ARG(context, "markDirtyRectangle", i, argv, 1, "y", &y) ||
+        !GJS_PARSE_ARG(context, "markDirtyRectangle", i, argv, 2, "width", &width) ||
+        !GJS_PARSE_ARG(context, "markDirtyRectangle", i, argv, 3, "height", &height))
+        return JS_FALSE;
+
+    surface = gjs_cairo_surface_get_surface(context, obj);
+    cairo_surface_mark_dirty_rectangle(surface, x, y, width, height);
+    if (!gjs_cairo_check_status(context, cairo_surface_status(surface),
+                                "surface"))
+        return JS_FALSE;
+
+    JS_SET_RVAL(context, vp, JSVAL_VOID);
+    return JS_TRUE;
+}
+
+/* Async surface I/O: PNG encoding and decoding and finishing a
+ * (PDF, PS, SVG) surface run on GLib's worker pool through GTask, and
+ * the callback is invoked from the main loop as callback(result, error).
+ */
+typedef struct {
+    GjsCairoSurfaceJob  job;
+    cairo_surface_t    *surface;
+    char               *filename;
+    cairo_status_t      status;
+    GClosure           *closure;
+} SurfaceJobData;
+
+static void
+surface_job_data_free(gpointer data)
+{
+    SurfaceJobData *job_data = data;
+
+    if (job_data->surface != NULL)
+        cairo_surface_destroy(job_data->surface);
+    g_free(job_data->filename);
+    g_closure_invalidate(job_data->closure);
+    g_closure_unref(job_data->closure);
+    g_slice_free(SurfaceJobData, job_data);
+}
+
+static void
+surface_job_thread(GTask        *task,
+                   gpointer      source_object,
+                   gpointer      task_data,
+                   GCancellable *cancellable)
+{
+    SurfaceJobData *job_data = task_data;
+
+    switch (job_data->job) {
+    case GJS_CAIRO_SURFACE_JOB_WRITE_PNG:
+        job_data->status = cairo_surface_write_to_png(job_data->surface,
+                                                      job_data->filename);
+        break;
+    case GJS_CAIRO_SURFACE_JOB_READ_PNG:
+        job_data->surface = cairo_image_surface_create_from_png(job_data->filename);
+        job_data->status = cairo_surface_status(job_data->surface);
+        break;
+    case GJS_CAIRO_SURFACE_JOB_FINISH:
+        cairo_surface_finish(job_data->surface);
+        job_data->status = cairo_surface_status(job_data->surface);
+        break;
+    }
+
+    g_task_return_boolean(task, TRUE);
+}
+
+static void
+surface_job_done(GObject      *source_object,
+                 GAsyncResult *result,
+                 gpointer      user_data)
+{
+    SurfaceJobData *job_data = g_task_get_task_data(G_TASK(result));
+    GClosure *closure = job_data->closure;
+    JSRuntime *runtime;
+    JSContext *context;
+    jsval *argv;
+
+    /* The context went away while the job was running */
+    if (!gjs_closure_is_valid(closure))
+        return;
+
+    runtime = gjs_closure_get_runtime(closure);
+    context = gjs_runtime_get_context(runtime);
+    JS_BeginRequest(context);
+
+    /* the result, the error and the return value */
+    argv = gjs_runtime_push_values(runtime, 3);
+
+    argv[0] = JSVAL_NULL;
+    argv[1] = JSVAL_NULL;
+
+    if (job_data->status == CAIRO_STATUS_SUCCESS) {
+        if (job_data->job == GJS_CAIRO_SURFACE_JOB_READ_PNG) {
+            JSObject *wrapper;
+
+            wrapper = gjs_cairo_image_surface_from_surface(context, job_data->surface);
+            if (wrapper)
+                argv[0] = OBJECT_TO_JSVAL(wrapper);
+            else if (!JS_IsExceptionPending(context))
+                gjs_throw(context, "failed to create surface");
+        } else {
+            argv[0] = JSVAL_TRUE;
+        }
+    } else {
+        /* Build the same exception the sync variant would throw */
+        gjs_cairo_check_status(context, job_data->status, "surface");
+    }
+
+    /* Errors go to the callback, as the caller is waiting for it */
+    if (JS_GetPendingException(context, &argv[1]))
+        JS_ClearPendingException(context);
+
+    gjs_closure_invoke(closure, 2, argv, &argv[2]);
+
+    gjs_runtime_pop_values(runtime, argv, 3);
+    JS_EndRequest(context);
+}
+
+JSBool
+gjs_cairo_surface_start_job(JSContext          *context,
+                            GjsCairoSurfaceJob  job,
+                            cairo_surface_t    *surface,
+                            const char         *filename,
+                            JSObject           *callback)
+{
+    SurfaceJobData *job_data;
+    GTask *task;
+
+    if (callback == NULL || !JS_ObjectIsFunction(context, callback)) {
+        gjs_throw(context, "callback is not a function");
+        return JS_FALSE;
+    }
+
+    job_data = g_slice_new0(SurfaceJobData);
+    job_data->job = job;
+    job_data->surface = surface ? cairo_surface_reference(surface) : NULL;
+    job_data->filename = g_strdup(filename);
+    job_data->closure = gjs_closure_new(context, callback, "cairo surface job", TRUE);
+    g_closure_ref(job_data->closure);
+    g_closure_sink(job_data->closure);
+
+    task = g_task_new(NULL, NULL, surface_job_done, NULL);
+    g_task_set_task_data(task, job_data, surface_job_data_free);
+    g_task_run_in_thread(task, surface_job_thread);
+    g_object_unref(task);
+
+    return JS_TRUE;
+}
+
+/* Encodes a snapshot of image surfaces, so drawing can go on while the
+ * PNG is written; other surfaces must be left alone until the callback
+ * runs.
+ */
+static JSBool
+writeToPNGAsync_func(JSContext *context,
+                     unsigned   argc,
+                     jsval     *vp)
+{
+    jsval *argv = JS_ARGV(context, vp);
+    JSObject *obj = JS_THIS_OBJECT(context, vp);
+    char *filename;
+    JSObject *callback;
+    cairo_surface_t *surface, *snapshot;
+    JSBool ret;
+
+    if (!gjs_parse_args(context, "writeToPNGAsync", "so", argc, argv,
+                        "filename", &filename,
+                        "callback", &callback))
+        return JS_FALSE;
+
+    surface = gjs_cairo_surface_get_surface(context, obj);
+    if (!surface) {
+        g_free(filename);
+        return JS_FALSE;
+    }
+
+    cairo_surface_flush(surface);
+
+    if (cairo_surface_get_type(surface) == CAIRO_SURFACE_TYPE_IMAGE) {
+        cairo_t *cr;
+
+        snapshot = cairo_image_surface_create(cairo_image_surface_get_format(surface),
+                                              cairo_image_surface_get_width(surface),
+                                              cairo_image_surface_get_height(surface));
+        cr = cairo_create(snapshot);
+        cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+        cairo_set_source_surface(cr, surface, 0, 0);
+        cairo_paint(cr);
+        cairo_destroy(cr);
+    } else {
+        snapshot = cairo_surface_reference(surface);
+    }
+
+    if (!gjs_cairo_check_status(context, cairo_surface_status(snapshot), "surface")) {
+        cairo_surface_destroy(snapshot);
+        g_free(filename);
+        return JS_FALSE;
+    }
+
+    ret = gjs_cairo_surface_start_job(context, GJS_CAIRO_SURFACE_JOB_WRITE_PNG,
+                                      snapshot, filename, callback);
+    cairo_surface_destroy(snapshot);
+    g_free(filename);
+
+    JS_SET_RVAL(context, vp, JSVAL_VOID);
+    return ret;
+}
+
+static JSBool
+finishAsync_func(JSContext *context,
+                 unsigned   argc,
+                 jsval     *vp)
+{
+    jsval *argv = JS_ARGV(context, vp);
+    JSObject *obj = JS_THIS_OBJECT(context, vp);
+    JSObject *callback;
+    cairo_surface_t *surface;
+
+    if (!GJS_CHECK_N_ARGS(context, "finishAsync", argc, 1) ||
+        !GJS_PARSE_ARG(context, "finishAsync", o, argv, 0, "callback", &callback))
+        return JS_FALSE;
+
+    surface = gjs_cairo_surface_get_surface(context, obj);
+    if (!surface)
+        return JS_FALSE;
+
+    JS_SET_RVAL(context, vp, JSVAL_VOID);
+    return gjs_cairo_surface_start_job(context, GJS_CAIRO_SURFACE_JOB_FINISH,
+                                       surface, NULL, callback);
+}
+
 static JSFunctionSpec gjs_cairo_surface_proto_funcs[] = {
-    // flush
+    { "finishAsync", JSOP_WRAPPER((JSNative)finishAsync_func), 0, 0 },
+    { "flush", JSOP_WRAPPER((JSNative)flush_func), 0, 0 },
     // getContent
     // getFontOptions
     { "getType", JSOP_WRAPPER((JSNative)getType_func), 0, 0},
-    // markDirty
-    // markDirtyRectangle
+    { "markDirty", JSOP_WRAPPER((JSNative)markDirty_func), 0, 0 },
+    { "markDirtyRectangle", JSOP_WRAPPER((JSNative)markDirtyRectangle_func), 0, 0 },
     // setDeviceOffset
     // getDeviceOffset
     // setFallbackResolution
@@ -123,6 +415,7 @@ static JSFunctionSpec gjs_cairo_surface_proto_funcs[] = {
     // showPage
     // hasShowTextGlyphs
     { "writeToPNG", JSOP_WRAPPER((JSNative)writeToPNG_func), 0, 0 },
+    { "writeToPNGAsync", JSOP_WRAPPER((JSNative)writeToPNGAsync_func), 0, 0 },
     { NULL }
 };
 
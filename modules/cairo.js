@@ -118,6 +118,13 @@ const Operator = {
     HSL_LUMINOSITY : 28
 };
 
+const PathDataType = {
+    MOVE_TO: 0,
+    LINE_TO: 1,
+    CURVE_TO: 2,
+    CLOSE_PATH: 3
+};
+
 const PatternType = {
     SOLID : 0,
     SURFACE : 1,
@@ -142,6 +149,80 @@ const SurfaceType = {
     QUARTZ_IMAGE : 13
 };
 
+// A growable buffer of path commands, in the layout taken by
+// Context.appendPathData(). Recording a path once and replaying it
+// costs a single native call per context, however long the path is.
+const PathRecorder = new Lang.Class({
+    Name: 'PathRecorder',
+
+    _init: function() {
+        this.clear();
+    },
+
+    clear: function() {
+        this._ops = new Uint8Array(16);
+        this._points = new Float64Array(64);
+        this._nOps = 0;
+        this._nCoords = 0;
+    },
+
+    _reserve: function(nCoords) {
+        if (this._nOps == this._ops.length) {
+            let ops = new Uint8Array(this._ops.length * 2);
+            ops.set(this._ops);
+            this._ops = ops;
+        }
+        if (this._nCoords + nCoords > this._points.length) {
+            let points = new Float64Array(this._points.length * 2);
+            points.set(this._points);
+            this._points = points;
+        }
+    },
+
+    moveTo: function(x, y) {
+        this._reserve(2);
+        this._ops[this._nOps++] = PathDataType.MOVE_TO;
+        this._points[this._nCoords++] = x;
+        this._points[this._nCoords++] = y;
+    },
+
+    lineTo: function(x, y) {
+        this._reserve(2);
+        this._ops[this._nOps++] = PathDataType.LINE_TO;
+        this._points[this._nCoords++] = x;
+        this._points[this._nCoords++] = y;
+    },
+
+    curveTo: function(x1, y1, x2, y2, x3, y3) {
+        this._reserve(6);
+        this._ops[this._nOps++] = PathDataType.CURVE_TO;
+        this._points[this._nCoords++] = x1;
+        this._points[this._nCoords++] = y1;
+        this._points[this._nCoords++] = x2;
+        this._points[this._nCoords++] = y2;
+        this._points[this._nCoords++] = x3;
+        this._points[this._nCoords++] = y3;
+    },
+
+    closePath: function() {
+        this._reserve(0);
+        this._ops[this._nOps++] = PathDataType.CLOSE_PATH;
+    },
+
+    rectangle: function(x, y, width, height) {
+        this.moveTo(x, y);
+        this.lineTo(x + width, y);
+        this.lineTo(x + width, y + height);
+        this.lineTo(x, y + height);
+        this.closePath();
+    },
+
+    replay: function(cr) {
+        cr.appendPathData(this._points.subarray(0, this._nCoords),
+                          this._ops.subarray(0, this._nOps));
+    }
+});
+
 // Merge stuff defined in native code
 Lang.copyProperties(imports.cairoNative, this);
 
@@ -165,9 +165,9 @@ function _parent() {
 
     let caller = this.__caller__;
     let name = caller._name;
-    let parent = caller._owner.__super__;
+    let parentProto = caller._parentProto;
 
-    let previous = parent ? parent.prototype[name] : undefined;
+    let previous = parentProto ? parentProto[name] : undefined;
 
     if (!previous)
         throw new TypeError("The method '" + name + "' is not on the superclass");
@@ -204,9 +204,19 @@ Class.prototype = Object.create(_Base.prototype);
 Class.prototype.constructor = Class;
 Class.prototype.__name__ = 'Class';
 
+// Only methods that mention 'parent' need to know who is calling
+// them; the rest go on the prototype as they are, so calling them
+// costs no more than calling a method on a plain prototype.
+function _callsParent(meth) {
+    return /\bparent\b/.test(Function.prototype.toString.call(meth));
+}
+
 Class.prototype.wrapFunction = function(name, meth) {
     if (meth._origin) meth = meth._origin;
 
+    if (!_callsParent(meth))
+        return meth;
+
     function wrapper() {
         let prevCaller = this.__caller__;
         this.__caller__ = wrapper;
@@ -218,6 +228,8 @@ Class.prototype.wrapFunction = function(name, meth) {
     wrapper._origin = meth;
     wrapper._name = name;
     wrapper._owner = this;
+    // where parent() looks for the method, resolved once per class
+    wrapper._parentProto = this.__super__ ? this.__super__.prototype : null;
 
     return wrapper;
 }
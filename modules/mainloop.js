@@ -23,6 +23,7 @@
 
 const GLib = imports.gi.GLib;
 const GObject = imports.gi.GObject;
+const GjsPrivate = imports.gi.GjsPrivate;
 
 var _mainLoops = {};
 
@@ -69,13 +70,269 @@ function timeout_seconds_source(timeout, handler) {
 }
 
 function timeout_add(timeout, handler) {
+    if (_useTimerWheel)
+        return timer_add(timeout, handler, 0);
     return timeout_source(timeout, handler).attach(null);
 }
 
 function timeout_add_seconds(timeout, handler) {
+    // like GLib, seconds timeouts are coalesced on whole seconds
+    if (_useTimerWheel)
+        return timer_add(timeout * 1000, handler, 1000);
     return timeout_seconds_source(timeout, handler).attach(null);
 }
 
 function source_remove(id) {
+    if (id < 0)
+        return timer_remove(id);
     return GLib.source_remove(id);
 }
+
+// Timer wheel
+//
+// Timers added with timer_add() (and, after use_timer_wheel(true), with
+// timeout_add() and timeout_add_seconds()) don't get a GSource, GClosure
+// and keep-alive entry each. They live in a hierarchical timer wheel
+// driven by a single source, which sleeps until the next slot that has
+// something in it. The wheel has a 1 ms resolution and _WHEEL_LEVELS
+// levels of _WHEEL_SIZE slots. A timer goes in the lowest level whose
+// span covers its delay, and is cascaded down as its expiry comes
+// closer. Removing a timer only flags it.
+//
+// Timer ids are negative so source_remove() can tell them from GLib
+// source ids.
+
+const _WHEEL_SIZE = 64;
+const _WHEEL_LEVELS = 4;
+const _WHEEL_SPANS = [1, 64, 4096, 262144];
+const _WHEEL_MAX_DELAY = 16777215;
+
+function _TimerWheel() {
+    this._init();
+}
+
+_TimerWheel.prototype = {
+    _init: function() {
+        this._epoch = GLib.get_monotonic_time();
+        this._tick = 0;
+        this._levels = [];
+        for (let level = 0; level < _WHEEL_LEVELS; level++) {
+            let slots = [];
+            for (let i = 0; i < _WHEEL_SIZE; i++)
+                slots.push([]);
+            this._levels.push(slots);
+        }
+        this._timers = {};
+        this._nTimers = 0;
+        this._nextId = -1;
+        this._source = null;
+        this._readyTick = -1;
+    },
+
+    _now: function() {
+        return Math.floor((GLib.get_monotonic_time() - this._epoch) / 1000);
+    },
+
+    // Timers with a coalescing window expire on a multiple of it, so
+    // that all the timers sharing a window fire in the same wakeup.
+    _expiry: function(from, delay, window) {
+        let expires = from + Math.max(delay, 0);
+        if (window > 1)
+            expires = Math.ceil(expires / window) * window;
+        return Math.max(expires, this._tick + 1);
+    },
+
+    // Returns the tick at which the slot the timer landed in has to be
+    // looked at: its expiry in the first level, the cascade of its
+    // slot above that.
+    _place: function(timer) {
+        let expires = Math.min(timer.expires, this._tick + _WHEEL_MAX_DELAY);
+        let delta = expires - this._tick;
+        let level = 0;
+        while (level < _WHEEL_LEVELS - 1 && delta >= _WHEEL_SPANS[level + 1])
+            level++;
+
+        let span = _WHEEL_SPANS[level];
+        let index = Math.floor(expires / span);
+        this._levels[level][index % _WHEEL_SIZE].push(timer);
+        return index * span;
+    },
+
+    // The earliest tick after the current one at which a slot of the
+    // first level has to run or a slot of a higher level has to be
+    // cascaded, or -1.
+    _nextEvent: function() {
+        let best = -1;
+        for (let level = 0; level < _WHEEL_LEVELS; level++) {
+            let span = _WHEEL_SPANS[level];
+            let base = Math.floor(this._tick / span);
+            for (let k = 1; k <= _WHEEL_SIZE; k++) {
+                let start = (base + k) * span;
+                if (best >= 0 && start >= best)
+                    break;
+                if (this._levels[level][(base + k) % _WHEEL_SIZE].length > 0) {
+                    best = start;
+                    break;
+                }
+            }
+        }
+        return best;
+    },
+
+    _cascade: function() {
+        for (let level = 1; level < _WHEEL_LEVELS; level++) {
+            let span = _WHEEL_SPANS[level];
+            if (this._tick % span != 0)
+                break;
+
+            let index = (this._tick / span) % _WHEEL_SIZE;
+            let slot = this._levels[level][index];
+            if (slot.length == 0)
+                continue;
+
+            this._levels[level][index] = [];
+            for (let i = 0; i < slot.length; i++) {
+                if (!slot[i].removed)
+                    this._place(slot[i]);
+            }
+        }
+    },
+
+    _runSlot: function() {
+        let index = this._tick % _WHEEL_SIZE;
+        let slot = this._levels[0][index];
+        if (slot.length == 0)
+            return;
+
+        this._levels[0][index] = [];
+        for (let i = 0; i < slot.length; i++) {
+            let timer = slot[i];
+            if (timer.removed)
+                continue;
+
+            // timers further away than the wheel spans come back early
+            if (timer.expires > this._tick) {
+                this._place(timer);
+                continue;
+            }
+
+            let again = false;
+            try {
+                let handler = timer.handler;
+                again = handler();
+            } catch (e) {
+                logError(e, "Exception in timer handler");
+            }
+
+            if (timer.removed)
+                continue;
+
+            if (again) {
+                timer.expires = this._expiry(this._now(), timer.delay, timer.window);
+                this._place(timer);
+            } else {
+                this._forget(timer);
+            }
+        }
+    },
+
+    _forget: function(timer) {
+        timer.removed = true;
+        delete this._timers[timer.id];
+        this._nTimers--;
+    },
+
+    _setReadyTick: function(tick) {
+        if (this._source == null) {
+            this._source = GjsPrivate.timer_source_new();
+            GObject.source_set_closure(this._source,
+                                       (function() { return this._dispatch(); }).bind(this));
+            this._source.attach(null);
+        }
+
+        this._readyTick = tick;
+        this._source.set_ready_time(tick < 0 ? -1 : this._epoch + tick * 1000);
+    },
+
+    _dispatch: function() {
+        let now = this._now();
+
+        for (;;) {
+            let next = this._nextEvent();
+            if (next < 0 || next > now)
+                break;
+            this._tick = next;
+            this._cascade();
+            this._runSlot();
+        }
+        // nothing is due before now, so the wheel can jump there
+        if (this._tick < now)
+            this._tick = now;
+
+        this._setReadyTick(this._nTimers > 0 ? this._nextEvent() : -1);
+        return true;
+    },
+
+    add: function(delay, handler, window) {
+        if (typeof(handler) != 'function')
+            throw new Error("Timer handler must be a function");
+
+        // an empty wheel can jump to the current time; cancelled
+        // leftovers are dropped as their slots come up
+        if (this._nTimers == 0)
+            this._tick = Math.max(this._tick, this._now());
+
+        let timer = { id: this._nextId--,
+                      delay: delay,
+                      window: window,
+                      handler: handler,
+                      expires: this._expiry(this._now(), delay, window),
+                      removed: false };
+        this._timers[timer.id] = timer;
+        this._nTimers++;
+
+        let event = this._place(timer);
+        if (this._readyTick < 0 || event < this._readyTick)
+            this._setReadyTick(event);
+
+        return timer.id;
+    },
+
+    remove: function(id) {
+        let timer = this._timers[id];
+        if (timer === undefined)
+            return false;
+
+        this._forget(timer);
+        return true;
+    }
+};
+
+var _timerWheel = null;
+var _useTimerWheel = false;
+
+function _getTimerWheel() {
+    if (_timerWheel == null)
+        _timerWheel = new _TimerWheel();
+    return _timerWheel;
+}
+
+// Makes timeout_add() and timeout_add_seconds() use the timer wheel.
+// Ids they return are then only valid with source_remove() from this
+// module, not with GLib.source_remove().
+function use_timer_wheel(enabled) {
+    _useTimerWheel = enabled;
+}
+
+// Like timeout_add(), on the timer wheel. When @window is given the
+// handler may run up to @window ms late, so that timers with the same
+// window get coalesced into one wakeup.
+function timer_add(timeout, handler, window) {
+    return _getTimerWheel().add(timeout, handler, window || 0);
+}
+
+function timer_remove(id) {
+    if (_timerWheel == null)
+        return false;
+    return _timerWheel.remove(id);
+}
@@ -32,6 +32,8 @@
 
 #include "system.h"
 #include "console.h"
+#include "worker.h"
+#include "stream.h"
 
 void
 gjs_register_static_modules (void)
@@ -41,4 +43,6 @@ gjs_register_static_modules (void)
 #endif
     gjs_register_native_module("system", gjs_js_define_system_stuff, 0);
     gjs_register_native_module("console", gjs_define_console_stuff, 0);
+    gjs_register_native_module("worker", gjs_define_worker_stuff, 0);
+    gjs_register_native_module("stream", gjs_define_stream_stuff, 0);
 }
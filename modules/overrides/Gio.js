@@ -22,48 +22,33 @@
 var GLib = imports.gi.GLib;
 var GObject = imports.gi.GObject;
 var GjsPrivate = imports.gi.GjsPrivate;
+var Gi = imports._gi;
 var Lang = imports.lang;
 var Signals = imports.signals;
 var Gio;
 
-function _signatureLength(sig) {
-    var counter = 0;
-    // make it an array
-    var signature = Array.prototype.slice.call(sig);
-    while (signature.length) {
-        GLib._read_single_type(sig);
-        counter++;
-    }
-    return counter;
-}
-
-function _proxyInvoker(methodName, sync, inSignature, arg_array) {
+function _proxyInvoker(methodName, sync, inType, nArgs, args) {
     var replyFunc;
     var flags = 0;
     var cancellable = null;
 
-    /* Convert arg_array to a *real* array */
-    arg_array = Array.prototype.slice.call(arg_array);
-
     /* The default replyFunc only logs the responses */
     replyFunc = _logReply;
 
-    var signatureLength = inSignature.length;
-    var minNumberArgs = signatureLength;
-    var maxNumberArgs = signatureLength + 3;
+    var minNumberArgs = nArgs;
+    var maxNumberArgs = nArgs + 3;
 
-    if (arg_array.length < minNumberArgs) {
+    if (args.length < minNumberArgs) {
         throw new Error("Not enough arguments passed for method: " + methodName +
-                       ". Expected " + minNumberArgs + ", got " + arg_array.length);
-    } else if (arg_array.length > maxNumberArgs) {
+                       ". Expected " + minNumberArgs + ", got " + args.length);
+    } else if (args.length > maxNumberArgs) {
         throw new Error("Too many arguments passed for method: " + methodName +
                        ". Maximum is " + maxNumberArgs +
                         " + one callback and/or flags");
     }
 
-    while (arg_array.length > signatureLength) {
-        var argNum = arg_array.length - 1;
-        var arg = arg_array.pop();
+    for (var argNum = args.length - 1; argNum >= nArgs; argNum--) {
+        var arg = args[argNum];
         if (typeof(arg) == "function" && !sync) {
             replyFunc = arg;
         } else if (typeof(arg) == "number") {
@@ -76,35 +61,13 @@ function _proxyInvoker(methodName, sync, inSignature, arg_array) {
         }
     }
 
-    var inVariant = new GLib.Variant('(' + inSignature.join('') + ')', arg_array);
-
-    var asyncCallback = function (proxy, result) {
-        var outVariant = null, succeeded = false;
-        try {
-            outVariant = proxy.call_finish(result);
-            succeeded = true;
-        } catch (e) {
-            replyFunc(null, e);
-        }
-
-        if (succeeded)
-            replyFunc(outVariant.deep_unpack(), null);
-    };
-
-    if (sync) {
-        return this.call_sync(methodName,
-                              inVariant,
-                              flags,
-                              -1,
-                              cancellable).deep_unpack();
-    } else {
-        return this.call(methodName,
-                         inVariant,
-                         flags,
-                         -1,
-                         cancellable,
-                         asyncCallback);
-    }
+    /* Only the first nArgs elements of args are packed */
+    if (sync)
+        return Gi.dbus_proxy_call_sync(this, methodName, inType, args,
+                                       flags, cancellable);
+    else
+        return Gi.dbus_proxy_call(this, methodName, inType, args,
+                                  flags, cancellable, replyFunc);
 }
 
 function _logReply(result, exc) {
@@ -113,19 +76,31 @@ function _logReply(result, exc) {
     }
 }
 
-function _makeProxyMethod(method, sync) {
-    var i;
+function _makeProxyMethod(method, sync, inType) {
     var name = method.name;
-    var inArgs = method.in_args;
-    var inSignature = [ ];
-    for (i = 0; i < inArgs.length; i++)
-        inSignature.push(inArgs[i].signature);
+    var nArgs = method.in_args.length;
 
     return function() {
-        return _proxyInvoker.call(this, name, sync, inSignature, arguments);
+        return _proxyInvoker.call(this, name, sync, inType, nArgs, arguments);
     };
 }
 
+// Builds the Remote and Sync methods of every method of the interface,
+// with the in signature compiled once instead of at every call
+function _makeProxyMethods(info) {
+    var proxyMethods = { };
+    var methods = info.methods;
+
+    for (var i = 0; i < methods.length; i++) {
+        var method = methods[i];
+        var inType = new GLib.VariantType(_makeTupleSignature(method.in_args));
+        proxyMethods[method.name + 'Remote'] = _makeProxyMethod(method, false, inType);
+        proxyMethods[method.name + 'Sync'] = _makeProxyMethod(method, true, inType);
+    }
+
+    return proxyMethods;
+}
+
 function _convertToNativeSignal(proxy, sender_name, signal_name, parameters) {
     Signals._emit.call(proxy, signal_name, sender_name, parameters.deep_unpack());
 }
@@ -162,14 +137,12 @@ function _addDBusConvenience() {
     if (info.signals.length > 0)
         this.connect('g-signal', _convertToNativeSignal);
 
-    let i, methods = info.methods;
-    for (i = 0; i < methods.length; i++) {
-        var method = methods[i];
-        this[method.name + 'Remote'] = _makeProxyMethod(methods[i], false);
-        this[method.name + 'Sync'] = _makeProxyMethod(methods[i], true);
-    }
+    // proxies created from a wrapper share the methods compiled by it
+    let proxyMethods = this._proxyMethods || _makeProxyMethods(info);
+    for (let name in proxyMethods)
+        this[name] = proxyMethods[name];
 
-    let properties = info.properties;
+    let i, properties = info.properties;
     for (i = 0; i < properties.length; i++) {
         let name = properties[i].name;
         let signature = properties[i].signature;
@@ -182,12 +155,14 @@ function _addDBusConvenience() {
 function _makeProxyWrapper(interfaceXml) {
     var info = _newInterfaceInfo(interfaceXml);
     var iname = info.name;
+    var proxyMethods = _makeProxyMethods(info);
     return function(bus, name, object, asyncCallback, cancellable) {
         var obj = new Gio.DBusProxy({ g_connection: bus,
                                       g_interface_name: iname,
                                       g_interface_info: info,
                                       g_name: name,
                                       g_object_path: object });
+        obj._proxyMethods = proxyMethods;
         if (!cancellable)
             cancellable = null;
         if (asyncCallback)
@@ -261,7 +236,7 @@ function _wrapFunction(klass, method, addition) {
     }
 }
 
-function _makeOutSignature(args) {
+function _makeTupleSignature(args) {
     var ret = '(';
     for (var i = 0; i < args.length; i++)
         ret += args[i].signature;
@@ -269,70 +244,6 @@ function _makeOutSignature(args) {
     return ret + ')';
 }
 
-function _handleMethodCall(info, impl, method_name, parameters, invocation) {
-    // prefer a sync version if available
-    if (this[method_name]) {
-        let retval;
-        try {
-            retval = this[method_name].apply(this, parameters.deep_unpack());
-        } catch (e) {
-            if (e instanceof GLib.Error) {
-                invocation.return_gerror(e);
-            } else {
-                let name = e.name;
-                if (name.indexOf('.') == -1) {
-                    // likely to be a normal JS error
-                    name = 'org.gnome.gjs.JSError.' + name;
-                }
-                invocation.return_dbus_error(name, e.message);
-            }
-            return;
-        }
-        if (retval === undefined) {
-            // undefined (no return value) is the empty tuple
-            retval = new GLib.Variant('()', []);
-        }
-        try {
-            if (!(retval instanceof GLib.Variant)) {
-                // attempt packing according to out signature
-                let methodInfo = info.lookup_method(method_name);
-                let outArgs = methodInfo.out_args;
-                let outSignature = _makeOutSignature(outArgs);
-                if (outArgs.length == 1) {
-                    // if one arg, we don't require the handler wrapping it
-                    // into an Array
-                    retval = [retval];
-                }
-                retval = new GLib.Variant(outSignature, retval);
-            }
-            invocation.return_value(retval);
-        } catch(e) {
-            // if we don't do this, the other side will never see a reply
-            invocation.return_dbus_error('org.gnome.gjs.JSError.ValueError',
-                                         "Service implementation returned an incorrect value type");
-        }
-    } else if (this[method_name + 'Async']) {
-        this[method_name + 'Async'](parameters.deep_unpack(), invocation);
-    } else {
-        log('Missing handler for DBus method ' + method_name);
-        invocation.return_gerror(new Gio.DBusError({ code: Gio.DBusError.UNKNOWN_METHOD,
-                                                     message: 'Method ' + method_name + ' is not implemented' }));
-    }
-}
-
-function _handlePropertyGet(info, impl, property_name) {
-    let propInfo = info.lookup_property(property_name);
-    let jsval = this[property_name];
-    if (jsval != undefined)
-        return new GLib.Variant(propInfo.signature, jsval);
-    else
-        return null;
-}
-
-function _handlePropertySet(info, impl, property_name, new_value) {
-    this[property_name] = new_value.deep_unpack();
-}
-
 function _wrapJSObject(interfaceInfo, jsObj) {
     var info;
     if (interfaceInfo instanceof Gio.DBusInterfaceInfo)
@@ -342,15 +253,9 @@ function _wrapJSObject(interfaceInfo, jsObj) {
     info.cache_build();
 
     var impl = new GjsPrivate.DBusImplementation({ g_interface_info: info });
-    impl.connect('handle-method-call', function(impl, method_name, parameters, invocation) {
-        return _handleMethodCall.call(jsObj, info, impl, method_name, parameters, invocation)
-    });
-    impl.connect('handle-property-get', function(impl, property_name) {
-        return _handlePropertyGet.call(jsObj, info, impl, property_name);
-    });
-    impl.connect('handle-property-set', function(impl, property_name, value) {
-        return _handlePropertySet.call(jsObj, info, impl, property_name, value);
-    });
+    // Method calls and property accesses are dispatched natively to jsObj,
+    // see gi/gdbus.c
+    Gi.dbus_implementation_set_target(impl, jsObj);
 
     return impl;
 }
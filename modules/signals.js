@@ -22,9 +22,12 @@
 
 // A couple principals of this simple signal system:
 // 1) should look just like our GObject signal binding
-// 2) memory and safety matter more than speed of connect/disconnect/emit
-// 3) the expectation is that a given object will have a very small number of
-//    connections, but they may be to different signal names
+// 2) reentrancy must be safe: handlers connected during an emission are
+//    not run by it, and handlers disconnected during it are skipped
+// 3) an object may have many connections spread over different signal
+//    names, so connections are kept in a list per name; emitting only
+//    visits that name's handlers and doesn't allocate, and disconnecting
+//    is a lookup by id
 
 function _connect(name, callback) {
     // be paranoid about callback arg since we'd start to throw from emit()
@@ -35,40 +38,72 @@ function _connect(name, callback) {
     // we instantiate the "signal machinery" only on-demand if anything
     // gets connected.
     if (!('_signalConnections' in this)) {
-        this._signalConnections = [];
+        // id -> connection
+        this._signalConnections = Object.create(null);
+        // name -> { connections, emissions, disconnected }
+        this._signalHandlers = Object.create(null);
         this._nextConnectionId = 1;
     }
 
     let id = this._nextConnectionId;
     this._nextConnectionId += 1;
 
-    // this makes it O(n) in total connections to emit, but I think
-    // it's right to optimize for low memory and reentrancy-safety
-    // rather than speed
-    this._signalConnections.push({ 'id' : id,
-                                   'name' : name,
-                                   'callback' : callback,
-                                   'disconnected' : false
-                                 });
+    let handlers = this._signalHandlers[name];
+    if (handlers === undefined) {
+        handlers = { 'connections' : [],
+                     'emissions' : 0,
+                     'disconnected' : 0
+                   };
+        this._signalHandlers[name] = handlers;
+    }
+
+    let connection = { 'id' : id,
+                       'name' : name,
+                       'callback' : callback,
+                       'disconnected' : false
+                     };
+    handlers.connections.push(connection);
+    this._signalConnections[id] = connection;
+
     return id;
 }
 
+// Drops disconnected entries from a handler list. Never called while
+// an emission of that name is running, since emissions walk the list
+// in place.
+function _sweepHandlers(handlers) {
+    let connections = handlers.connections;
+    let length = connections.length;
+    let j = 0;
+    for (let i = 0; i < length; ++i) {
+        if (!connections[i].disconnected)
+            connections[j++] = connections[i];
+    }
+    connections.length = j;
+    handlers.disconnected = 0;
+}
+
+function _maybeSweepHandlers(handlers) {
+    // sweeping once half the list is dead keeps disconnect constant
+    // time when amortized
+    if (handlers.emissions == 0 && handlers.disconnected > 0 &&
+        handlers.disconnected * 2 >= handlers.connections.length)
+        _sweepHandlers(handlers);
+}
+
 function _disconnect(id) {
     if ('_signalConnections' in this) {
-        let i;
-        let length = this._signalConnections.length;
-        for (i = 0; i < length; ++i) {
-            let connection = this._signalConnections[i];
-            if (connection.id == id) {
-                if (connection.disconnected)
-                    throw new Error("Signal handler id " + id + " already disconnected");
-
-                // set a flag to deal with removal during emission
-                connection.disconnected = true;
-                this._signalConnections.splice(i, 1);
-
-                return;
-            }
+        let connection = this._signalConnections[id];
+        if (connection !== undefined) {
+            // set a flag to deal with removal during emission
+            connection.disconnected = true;
+            delete this._signalConnections[id];
+
+            let handlers = this._signalHandlers[connection.name];
+            handlers.disconnected += 1;
+            _maybeSweepHandlers(handlers);
+
+            return;
         }
     }
     throw new Error("No signal connection " + id + " found");
@@ -76,64 +111,87 @@ function _disconnect(id) {
 
 function _disconnectAll() {
     if ('_signalConnections' in this) {
-        while (this._signalConnections.length > 0) {
-            _disconnect.call(this, this._signalConnections[0].id);
-        }
+        for (let id in this._signalConnections)
+            _disconnect.call(this, id);
     }
 }
 
 function _emit(name /* , arg1, arg2 */) {
     // may not be any signal handlers at all, if not then return
-    if (!('_signalConnections' in this))
+    if (!('_signalHandlers' in this))
         return;
 
-    // To deal with re-entrancy (removal/addition while
-    // emitting), we copy out a list of what was connected
-    // at emission start; and just before invoking each
-    // handler we check its disconnected flag.
-    let handlers = [];
-    let i;
-    let length = this._signalConnections.length;
-    for (i = 0; i < length; ++i) {
-        let connection = this._signalConnections[i];
-        if (connection.name == name) {
-            handlers.push(connection);
-        }
-    }
+    let handlers = this._signalHandlers[name];
+    if (handlers === undefined)
+        return;
+
+    // To deal with re-entrancy (removal/addition while emitting) we
+    // only run the handlers that were connected at emission start,
+    // which are the first 'length' entries since new connections are
+    // appended and the list isn't swept while we walk it; just before
+    // invoking each handler we check its disconnected flag.
+    let connections = handlers.connections;
+    let length = connections.length;
 
-    // create arg array which is emitter + everything passed in except
-    // signal name. Would be more convenient not to pass emitter to
+    // Handlers get the emitter followed by everything passed in except
+    // the signal name. Would be more convenient not to pass emitter to
     // the callback, but trying to be 100% consistent with GObject
     // which does pass it in. Also if we pass in the emitter here,
     // people don't create closures with the emitter in them,
     // which would be a cycle.
-
-    let arg_array = [ this ];
-    // arguments[0] should be signal name so skip it
-    length = arguments.length;
-    for (i = 1; i < length; ++i) {
-        arg_array.push(arguments[i]);
+    //
+    // The common arities are called directly; only longer argument
+    // lists need an array.
+    let nArgs = arguments.length - 1;
+    let argArray = null;
+    if (nArgs > 3) {
+        argArray = [ this ];
+        for (let i = 1; i <= nArgs; ++i)
+            argArray.push(arguments[i]);
     }
 
-    length = handlers.length;
-    for (i = 0; i < length; ++i) {
-        let connection = handlers[i];
-        if (!connection.disconnected) {
+    handlers.emissions += 1;
+    try {
+        for (let i = 0; i < length; ++i) {
+            let connection = connections[i];
+            if (connection.disconnected)
+                continue;
+
             try {
-                // since we pass "null" for this, the global object will be used.
-                let ret = connection.callback.apply(null, arg_array);
+                // since we pass no "this", the global object will be used.
+                let callback = connection.callback;
+                let ret;
+                switch (nArgs) {
+                case 0:
+                    ret = callback(this);
+                    break;
+                case 1:
+                    ret = callback(this, arguments[1]);
+                    break;
+                case 2:
+                    ret = callback(this, arguments[1], arguments[2]);
+                    break;
+                case 3:
+                    ret = callback(this, arguments[1], arguments[2], arguments[3]);
+                    break;
+                default:
+                    ret = callback.apply(null, argArray);
+                    break;
+                }
 
                 // if the callback returns true, we don't call the next
                 // signal handlers
-                if (ret === true) {
+                if (ret === true)
                     break;
-                }
             } catch(e) {
                 // just log any exceptions so that callbacks can't disrupt
                 // signal emission
                 logError(e, "Exception in callback for signal: "+name);
             }
         }
+    } finally {
+        handlers.emissions -= 1;
+        _maybeSweepHandlers(handlers);
     }
 }
 
@@ -0,0 +1,515 @@
+/* -*- mode: C; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2014  Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <config.h>
+
+#include <string.h>
+
+#include <gio/gio.h>
+#include <gjs/gjs-module.h>
+#include <gjs/compat.h>
+#include <gjs/byteArray.h>
+#include <gi/object.h>
+#include "stream-private.h"
+
+typedef struct {
+    GInputStream *stream;
+
+    /* The unconsumed data is data[start..end); it's moved back to the
+     * front of the buffer, or the buffer grown, when more is needed.
+     */
+    guint8 *data;
+    gsize size;
+    gsize start;
+    gsize end;
+    gboolean eof;
+} StreamReader;
+
+GJS_DEFINE_PROTO("StreamReader", stream_reader)
+GJS_DEFINE_PRIV_FROM_JS(StreamReader, gjs_stream_reader_class)
+
+GJS_NATIVE_CONSTRUCTOR_DECLARE(stream_reader)
+{
+    GJS_NATIVE_CONSTRUCTOR_VARIABLES(stream_reader)
+    JSObject *stream_obj;
+    guint32 buffer_size = STREAM_DEFAULT_BUFFER_SIZE;
+    StreamReader *reader;
+
+    GJS_NATIVE_CONSTRUCTOR_PRELUDE(stream_reader);
+
+    if (!gjs_parse_args(context, "Reader", "o|u", argc, argv,
+                        "stream", &stream_obj,
+                        "bufferSize", &buffer_size))
+        return JS_FALSE;
+
+    if (!gjs_typecheck_object(context, stream_obj, G_TYPE_INPUT_STREAM, JS_TRUE))
+        return JS_FALSE;
+
+    reader = g_slice_new0(StreamReader);
+    reader->stream = g_object_ref(gjs_g_object_from_object(context, stream_obj));
+    reader->size = MAX(buffer_size, 1);
+    reader->data = g_malloc(reader->size);
+
+    g_assert(priv_from_js(context, object) == NULL);
+    JS_SetPrivate(object, reader);
+
+    GJS_NATIVE_CONSTRUCTOR_FINISH(stream_reader);
+
+    return JS_TRUE;
+}
+
+static void
+gjs_stream_reader_finalize(JSFreeOp *fop,
+                           JSObject *obj)
+{
+    StreamReader *reader = JS_GetPrivate(obj);
+
+    if (reader == NULL)
+        return; /* prototype */
+
+    g_object_unref(reader->stream);
+    g_free(reader->data);
+    g_slice_free(StreamReader, reader);
+}
+
+static StreamReader *
+reader_from_this(JSContext  *context,
+                 JSObject   *obj,
+                 const char *function_name)
+{
+    StreamReader *reader = priv_from_js(context, obj);
+
+    if (reader == NULL)
+        gjs_throw(context, "%s() called on the Reader prototype", function_name);
+
+    return reader;
+}
+
+/* Reads more data into the buffer, making room for it first. Sets
+ * reader->eof rather than reading nothing.
+ */
+static JSBool
+reader_fill(JSContext    *context,
+            StreamReader *reader)
+{
+    GError *error = NULL;
+    gssize n_read;
+
+    if (reader->start > 0) {
+        memmove(reader->data, reader->data + reader->start,
+                reader->end - reader->start);
+        reader->end -= reader->start;
+        reader->start = 0;
+    }
+
+    if (reader->end == reader->size) {
+        reader->size *= 2;
+        reader->data = g_realloc(reader->data, reader->size);
+    }
+
+    n_read = g_input_stream_read(reader->stream,
+                                 reader->data + reader->end,
+                                 reader->size - reader->end,
+                                 NULL, &error);
+    if (n_read < 0) {
+        gjs_throw_g_error(context, error);
+        return JS_FALSE;
+    }
+
+    if (n_read == 0)
+        reader->eof = TRUE;
+    reader->end += n_read;
+
+    return JS_TRUE;
+}
+
+/* Finds @delim in the unconsumed data, reading as much as needed.
+ * *@offset_p is set to its offset from reader->start, or to -1 if the
+ * stream ends first.
+ */
+static JSBool
+reader_find(JSContext    *context,
+            StreamReader *reader,
+            const guint8 *delim,
+            gsize         delim_len,
+            gssize       *offset_p)
+{
+    gsize scanned = 0;
+
+    while (TRUE) {
+        const guint8 *base = reader->data + reader->start;
+        gsize available = reader->end - reader->start;
+
+        while (scanned + delim_len <= available) {
+            const guint8 *p;
+
+            p = memchr(base + scanned, delim[0], available - delim_len + 1 - scanned);
+            if (p == NULL) {
+                scanned = available - delim_len + 1;
+                break;
+            }
+
+            if (memcmp(p, delim, delim_len) == 0) {
+                *offset_p = p - base;
+                return JS_TRUE;
+            }
+            scanned = p - base + 1;
+        }
+
+        if (reader->eof) {
+            *offset_p = -1;
+            return JS_TRUE;
+        }
+
+        if (!reader_fill(context, reader))
+            return JS_FALSE;
+    }
+}
+
+/* Returns the record up to @delim as a string, consuming the
+ * delimiter too; at the end of the stream, whatever is left, or null
+ * if nothing is.
+ */
+static JSBool
+reader_read_record(JSContext    *context,
+                   StreamReader *reader,
+                   const guint8 *delim,
+                   gsize         delim_len,
+                   jsval        *value_p)
+{
+    gssize offset;
+    gsize len, consumed;
+
+    if (!reader_find(context, reader, delim, delim_len, &offset))
+        return JS_FALSE;
+
+    if (offset >= 0) {
+        len = offset;
+        consumed = offset + delim_len;
+    } else {
+        len = consumed = reader->end - reader->start;
+        if (len == 0) {
+            *value_p = JSVAL_NULL;
+            return JS_TRUE;
+        }
+    }
+
+    if (!gjs_string_from_utf8(context, (const char *) reader->data + reader->start,
+                              len, value_p))
+        return JS_FALSE;
+
+    reader->start += consumed;
+    return JS_TRUE;
+}
+
+/* The length of @data without a UTF-8 sequence cut short at its end */
+static gsize
+utf8_complete_length(const guint8 *data,
+                     gsize         len)
+{
+    gsize i, needed;
+
+    for (i = 1; i <= 4 && i <= len; i++) {
+        guint8 c = data[len - i];
+
+        if ((c & 0xc0) == 0x80)
+            continue; /* continuation byte */
+        if (c < 0x80)
+            return len;
+
+        needed = c >= 0xf0 ? 4 : c >= 0xe0 ? 3 : 2;
+        return i < needed ? len - i : len;
+    }
+
+    return len;
+}
+
+static JSBool
+reader_read_line_func(JSContext *context,
+                      unsigned   argc,
+                      jsval     *vp)
+{
+    jsval *argv = JS_ARGV(context, vp);
+    JSObject *obj = JS_THIS_OBJECT(context, vp);
+    StreamReader *reader;
+    jsval retval;
+
+    if (!gjs_parse_args(context, "readLine", "", argc, argv))
+        return JS_FALSE;
+
+    reader = reader_from_this(context, obj, "readLine");
+    if (reader == NULL)
+        return JS_FALSE;
+
+    if (!reader_read_record(context, reader, (const guint8 *) "\n", 1, &retval))
+        return JS_FALSE;
+
+    JS_SET_RVAL(context, vp, retval);
+    return JS_TRUE;
+}
+
+static JSBool
+reader_read_until_func(JSContext *context,
+                       unsigned   argc,
+                       jsval     *vp)
+{
+    jsval *argv = JS_ARGV(context, vp);
+    JSObject *obj = JS_THIS_OBJECT(context, vp);
+    StreamReader *reader;
+    char *delim;
+    jsval retval;
+    JSBool ret;
+
+    if (!gjs_parse_args(context, "readUntil", "s", argc, argv,
+                        "delimiter", &delim))
+        return JS_FALSE;
+
+    reader = reader_from_this(context, obj, "readUntil");
+    if (reader == NULL) {
+        g_free(delim);
+        return JS_FALSE;
+    }
+
+    if (*delim == '\0') {
+        gjs_throw(context, "readUntil() needs a non-empty delimiter");
+        g_free(delim);
+        return JS_FALSE;
+    }
+
+    ret = reader_read_record(context, reader, (const guint8 *) delim,
+                             strlen(delim), &retval);
+    g_free(delim);
+    if (!ret)
+        return JS_FALSE;
+
+    JS_SET_RVAL(context, vp, retval);
+    return JS_TRUE;
+}
+
+/* Decodes as much of the stream as is available, up to a buffer's
+ * worth; a UTF-8 sequence split between two reads is kept for the
+ * next call.
+ */
+static JSBool
+reader_read_chunk_func(JSContext *context,
+                       unsigned   argc,
+                       jsval     *vp)
+{
+    jsval *argv = JS_ARGV(context, vp);
+    JSObject *obj = JS_THIS_OBJECT(context, vp);
+    StreamReader *reader;
+    gsize len;
+    jsval retval;
+
+    if (!gjs_parse_args(context, "readChunk", "", argc, argv))
+        return JS_FALSE;
+
+    reader = reader_from_this(context, obj, "readChunk");
+    if (reader == NULL)
+        return JS_FALSE;
+
+    while (TRUE) {
+        len = reader->end - reader->start;
+        if (reader->eof)
+            break;
+
+        len = utf8_complete_length(reader->data + reader->start, len);
+        if (len > 0)
+            break;
+
+        if (!reader_fill(context, reader))
+            return JS_FALSE;
+    }
+
+    if (len == 0) {
+        JS_SET_RVAL(context, vp, JSVAL_NULL);
+        return JS_TRUE;
+    }
+
+    if (!gjs_string_from_utf8(context, (const char *) reader->data + reader->start,
+                              len, &retval))
+        return JS_FALSE;
+
+    reader->start += len;
+    JS_SET_RVAL(context, vp, retval);
+    return JS_TRUE;
+}
+
+/* Copies up to @len bytes to @dest, from the buffer first and then
+ * from the stream directly, without going through the buffer.
+ */
+static JSBool
+reader_read_to(JSContext    *context,
+               StreamReader *reader,
+               guint8       *dest,
+               gsize         len,
+               gsize        *n_read_p)
+{
+    GError *error = NULL;
+    gsize buffered, n_read;
+
+    buffered = MIN(len, reader->end - reader->start);
+    memcpy(dest, reader->data + reader->start, buffered);
+    reader->start += buffered;
+
+    n_read = 0;
+    if (buffered < len && !reader->eof &&
+        !g_input_stream_read_all(reader->stream, dest + buffered, len - buffered,
+                                 &n_read, NULL, &error)) {
+        gjs_throw_g_error(context, error);
+        return JS_FALSE;
+    }
+
+    if (buffered + n_read < len)
+        reader->eof = TRUE;
+
+    *n_read_p = buffered + n_read;
+    return JS_TRUE;
+}
+
+static JSBool
+reader_read_bytes_func(JSContext *context,
+                       unsigned   argc,
+                       jsval     *vp)
+{
+    jsval *argv = JS_ARGV(context, vp);
+    JSObject *obj = JS_THIS_OBJECT(context, vp);
+    StreamReader *reader;
+    guint32 count;
+    guint8 *data;
+    gsize n_read;
+    GBytes *bytes;
+    JSObject *array;
+
+    if (!gjs_parse_args(context, "readBytes", "u", argc, argv,
+                        "count", &count))
+        return JS_FALSE;
+
+    reader = reader_from_this(context, obj, "readBytes");
+    if (reader == NULL)
+        return JS_FALSE;
+
+    data = g_malloc(count);
+    if (!reader_read_to(context, reader, data, count, &n_read)) {
+        g_free(data);
+        return JS_FALSE;
+    }
+
+    if (n_read == 0 && count > 0) {
+        g_free(data);
+        JS_SET_RVAL(context, vp, JSVAL_NULL);
+        return JS_TRUE;
+    }
+
+    /* The ByteArray holds the only reference, so it can take the data
+     * over if it's modified, instead of copying it.
+     */
+    bytes = g_bytes_new_take(g_realloc(data, n_read), n_read);
+    array = gjs_byte_array_from_bytes(context, bytes);
+    g_bytes_unref(bytes);
+    if (array == NULL)
+        return JS_FALSE;
+
+    JS_SET_RVAL(context, vp, OBJECT_TO_JSVAL(array));
+    return JS_TRUE;
+}
+
+/* Fills an existing ByteArray, so that a loop can reuse one */
+static JSBool
+reader_read_into_func(JSContext *context,
+                      unsigned   argc,
+                      jsval     *vp)
+{
+    jsval *argv = JS_ARGV(context, vp);
+    JSObject *obj = JS_THIS_OBJECT(context, vp);
+    StreamReader *reader;
+    JSObject *array_obj;
+    GByteArray *array;
+    gsize n_read;
+    jsval retval;
+    JSBool ret;
+
+    if (!gjs_parse_args(context, "readInto", "o", argc, argv,
+                        "array", &array_obj))
+        return JS_FALSE;
+
+    reader = reader_from_this(context, obj, "readInto");
+    if (reader == NULL)
+        return JS_FALSE;
+
+    if (!gjs_typecheck_bytearray(context, array_obj, JS_TRUE))
+        return JS_FALSE;
+
+    array = gjs_byte_array_get_byte_array(context, array_obj);
+    ret = reader_read_to(context, reader, array->data, array->len, &n_read);
+    g_byte_array_unref(array);
+    if (!ret || !JS_NewNumberValue(context, n_read, &retval))
+        return JS_FALSE;
+
+    JS_SET_RVAL(context, vp, retval);
+    return JS_TRUE;
+}
+
+static JSBool
+reader_close_func(JSContext *context,
+                  unsigned   argc,
+                  jsval     *vp)
+{
+    jsval *argv = JS_ARGV(context, vp);
+    JSObject *obj = JS_THIS_OBJECT(context, vp);
+    StreamReader *reader;
+    GError *error = NULL;
+
+    if (!gjs_parse_args(context, "close", "", argc, argv))
+        return JS_FALSE;
+
+    reader = reader_from_this(context, obj, "close");
+    if (reader == NULL)
+        return JS_FALSE;
+
+    reader->start = reader->end = 0;
+    reader->eof = TRUE;
+
+    if (!g_input_stream_close(reader->stream, NULL, &error)) {
+        gjs_throw_g_error(context, error);
+        return JS_FALSE;
+    }
+
+    JS_SET_RVAL(context, vp, JSVAL_VOID);
+    return JS_TRUE;
+}
+
+static JSPropertySpec gjs_stream_reader_proto_props[] = {
+    { NULL }
+};
+
+static JSFunctionSpec gjs_stream_reader_proto_funcs[] = {
+    { "readLine", JSOP_WRAPPER((JSNative)reader_read_line_func), 0, 0 },
+    { "readUntil", JSOP_WRAPPER((JSNative)reader_read_until_func), 1, 0 },
+    { "readChunk", JSOP_WRAPPER((JSNative)reader_read_chunk_func), 0, 0 },
+    { "readBytes", JSOP_WRAPPER((JSNative)reader_read_bytes_func), 1, 0 },
+    { "readInto", JSOP_WRAPPER((JSNative)reader_read_into_func), 1, 0 },
+    { "close", JSOP_WRAPPER((JSNative)reader_close_func), 0, 0 },
+    { NULL }
+};
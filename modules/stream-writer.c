@@ -0,0 +1,268 @@
+/* -*- mode: C; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2014  Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <config.h>
+
+#include <string.h>
+
+#include <gio/gio.h>
+#include <gjs/gjs-module.h>
+#include <gjs/compat.h>
+#include <gjs/byteArray.h>
+#include <gi/object.h>
+#include "stream-private.h"
+
+typedef struct {
+    GOutputStream *stream;
+    guint8 *data;
+    gsize size;
+    gsize len;
+} StreamWriter;
+
+GJS_DEFINE_PROTO("StreamWriter", stream_writer)
+GJS_DEFINE_PRIV_FROM_JS(StreamWriter, gjs_stream_writer_class)
+
+GJS_NATIVE_CONSTRUCTOR_DECLARE(stream_writer)
+{
+    GJS_NATIVE_CONSTRUCTOR_VARIABLES(stream_writer)
+    JSObject *stream_obj;
+    guint32 buffer_size = STREAM_DEFAULT_BUFFER_SIZE;
+    StreamWriter *writer;
+
+    GJS_NATIVE_CONSTRUCTOR_PRELUDE(stream_writer);
+
+    if (!gjs_parse_args(context, "Writer", "o|u", argc, argv,
+                        "stream", &stream_obj,
+                        "bufferSize", &buffer_size))
+        return JS_FALSE;
+
+    if (!gjs_typecheck_object(context, stream_obj, G_TYPE_OUTPUT_STREAM, JS_TRUE))
+        return JS_FALSE;
+
+    writer = g_slice_new0(StreamWriter);
+    writer->stream = g_object_ref(gjs_g_object_from_object(context, stream_obj));
+    writer->size = MAX(buffer_size, 1);
+    writer->data = g_malloc(writer->size);
+
+    g_assert(priv_from_js(context, object) == NULL);
+    JS_SetPrivate(object, writer);
+
+    GJS_NATIVE_CONSTRUCTOR_FINISH(stream_writer);
+
+    return JS_TRUE;
+}
+
+/* Buffered data that was never flushed is lost; there is no I/O
+ * from the garbage collector.
+ */
+static void
+gjs_stream_writer_finalize(JSFreeOp *fop,
+                           JSObject *obj)
+{
+    StreamWriter *writer = JS_GetPrivate(obj);
+
+    if (writer == NULL)
+        return; /* prototype */
+
+    g_object_unref(writer->stream);
+    g_free(writer->data);
+    g_slice_free(StreamWriter, writer);
+}
+
+static StreamWriter *
+writer_from_this(JSContext  *context,
+                 JSObject   *obj,
+                 const char *function_name)
+{
+    StreamWriter *writer = priv_from_js(context, obj);
+
+    if (writer == NULL)
+        gjs_throw(context, "%s() called on the Writer prototype", function_name);
+
+    return writer;
+}
+
+static JSBool
+writer_write_all(JSContext     *context,
+                 StreamWriter  *writer,
+                 const guint8  *data,
+                 gsize          len)
+{
+    GError *error = NULL;
+
+    if (!g_output_stream_write_all(writer->stream, data, len, NULL, NULL, &error)) {
+        gjs_throw_g_error(context, error);
+        return JS_FALSE;
+    }
+
+    return JS_TRUE;
+}
+
+static JSBool
+writer_flush_buffer(JSContext    *context,
+                    StreamWriter *writer)
+{
+    gsize len = writer->len;
+
+    /* Dropped even if writing fails, like a short write would */
+    writer->len = 0;
+    return len == 0 || writer_write_all(context, writer, writer->data, len);
+}
+
+/* Data that doesn't fit in the buffer is written out directly, after
+ * what's buffered, rather than split.
+ */
+static JSBool
+writer_append(JSContext    *context,
+              StreamWriter *writer,
+              const guint8 *data,
+              gsize         len)
+{
+    if (writer->len + len > writer->size &&
+        !writer_flush_buffer(context, writer))
+        return JS_FALSE;
+
+    if (len >= writer->size)
+        return writer_write_all(context, writer, data, len);
+
+    memcpy(writer->data + writer->len, data, len);
+    writer->len += len;
+    return JS_TRUE;
+}
+
+/* Takes a string, written as UTF-8, or a ByteArray */
+static JSBool
+writer_write_func(JSContext *context,
+                  unsigned   argc,
+                  jsval     *vp)
+{
+    jsval *argv = JS_ARGV(context, vp);
+    JSObject *obj = JS_THIS_OBJECT(context, vp);
+    StreamWriter *writer;
+    JSBool ret;
+
+    if (argc != 1) {
+        gjs_throw(context, "write() takes one argument");
+        return JS_FALSE;
+    }
+
+    writer = writer_from_this(context, obj, "write");
+    if (writer == NULL)
+        return JS_FALSE;
+
+    if (JSVAL_IS_STRING(argv[0])) {
+        char *utf8;
+
+        if (!gjs_string_to_utf8(context, argv[0], &utf8))
+            return JS_FALSE;
+
+        ret = writer_append(context, writer, (const guint8 *) utf8, strlen(utf8));
+        g_free(utf8);
+    } else if (JSVAL_IS_OBJECT(argv[0]) && !JSVAL_IS_NULL(argv[0]) &&
+               gjs_typecheck_bytearray(context, JSVAL_TO_OBJECT(argv[0]), JS_FALSE)) {
+        guint8 *data;
+        gsize len;
+
+        gjs_byte_array_peek_data(context, JSVAL_TO_OBJECT(argv[0]), &data, &len);
+        ret = writer_append(context, writer, data, len);
+    } else {
+        gjs_throw(context, "write() takes a string or a ByteArray");
+        return JS_FALSE;
+    }
+
+    if (!ret)
+        return JS_FALSE;
+
+    JS_SET_RVAL(context, vp, JSVAL_VOID);
+    return JS_TRUE;
+}
+
+static JSBool
+writer_flush_func(JSContext *context,
+                  unsigned   argc,
+                  jsval     *vp)
+{
+    jsval *argv = JS_ARGV(context, vp);
+    JSObject *obj = JS_THIS_OBJECT(context, vp);
+    StreamWriter *writer;
+    GError *error = NULL;
+
+    if (!gjs_parse_args(context, "flush", "", argc, argv))
+        return JS_FALSE;
+
+    writer = writer_from_this(context, obj, "flush");
+    if (writer == NULL)
+        return JS_FALSE;
+
+    if (!writer_flush_buffer(context, writer))
+        return JS_FALSE;
+
+    if (!g_output_stream_flush(writer->stream, NULL, &error)) {
+        gjs_throw_g_error(context, error);
+        return JS_FALSE;
+    }
+
+    JS_SET_RVAL(context, vp, JSVAL_VOID);
+    return JS_TRUE;
+}
+
+static JSBool
+writer_close_func(JSContext *context,
+                  unsigned   argc,
+                  jsval     *vp)
+{
+    jsval *argv = JS_ARGV(context, vp);
+    JSObject *obj = JS_THIS_OBJECT(context, vp);
+    StreamWriter *writer;
+    GError *error = NULL;
+
+    if (!gjs_parse_args(context, "close", "", argc, argv))
+        return JS_FALSE;
+
+    writer = writer_from_this(context, obj, "close");
+    if (writer == NULL)
+        return JS_FALSE;
+
+    if (!writer_flush_buffer(context, writer))
+        return JS_FALSE;
+
+    if (!g_output_stream_close(writer->stream, NULL, &error)) {
+        gjs_throw_g_error(context, error);
+        return JS_FALSE;
+    }
+
+    JS_SET_RVAL(context, vp, JSVAL_VOID);
+    return JS_TRUE;
+}
+
+static JSPropertySpec gjs_stream_writer_proto_props[] = {
+    { NULL }
+};
+
+static JSFunctionSpec gjs_stream_writer_proto_funcs[] = {
+    { "write", JSOP_WRAPPER((JSNative)writer_write_func), 1, 0 },
+    { "flush", JSOP_WRAPPER((JSNative)writer_flush_func), 0, 0 },
+    { "close", JSOP_WRAPPER((JSNative)writer_close_func), 0, 0 },
+    { NULL }
+};
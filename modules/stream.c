@@ -0,0 +1,55 @@
+/* -*- mode: C; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2014  Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <config.h>
+
+#include <gjs/gjs-module.h>
+#include "stream-private.h"
+
+/* Buffered readers and writers over GIO streams, for scripts going
+ * through more data than it's reasonable to allocate chunk by chunk.
+ * A Reader reads into a single buffer that it reuses for the whole
+ * stream, splits lines and other delimited records in C, and decodes
+ * UTF-8 from the buffer straight into JS strings; a Writer encodes
+ * strings into its buffer and writes it out once full.
+ *
+ * All I/O is blocking, as with the synchronous GIO methods.
+ */
+
+JSBool
+gjs_define_stream_stuff(JSContext *context,
+                        JSObject  *module)
+{
+    jsval obj;
+
+    obj = gjs_stream_reader_create_proto(context, module, "Reader", NULL);
+    if (JSVAL_IS_NULL(obj))
+        return JS_FALSE;
+
+    obj = gjs_stream_writer_create_proto(context, module, "Writer", NULL);
+    if (JSVAL_IS_NULL(obj))
+        return JS_FALSE;
+
+    return JS_TRUE;
+}
@@ -0,0 +1,854 @@
+/* -*- mode: C; c-basic-offset: 4; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright (c) 2014  Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include <gjs/gjs-module.h>
+#include <gjs/compat.h>
+#include <gjs/byteArray.h>
+#include <gjs/runtime.h>
+#include <gi/boxed.h>
+#include "worker.h"
+
+/* A worker runs a script in a GjsContext of its own, with its own
+ * JSRuntime, on a thread of its own. The two sides share no JS
+ * objects; messages are copied into a GVariant tree when posted and
+ * rebuilt on the receiving side, except for the contents of ByteArrays
+ * and GLib.Bytes, which travel as a shared GBytes.
+ *
+ * Messages are queued on a port and delivered in order from a single
+ * idle source on the main context of the receiving thread, so a burst
+ * of messages costs one wakeup.
+ */
+
+/* Bounds the depth of copied values, which also catches cycles */
+#define MAX_MESSAGE_DEPTH 64
+
+typedef struct {
+    GMainContext *main_context;
+    GQueue messages;  /* GVariant, protected by the worker lock */
+    GSource *source;  /* the pending dispatch, protected by the worker lock */
+} WorkerPort;
+
+typedef struct {
+    volatile gint refcount;
+    char *filename;
+    GThread *thread;
+
+    /* Owned by the thread that created the worker; the link is in the
+     * workers of parent_runtime until the thread is joined
+     */
+    JSRuntime *parent_runtime;
+    JSObject *object;
+    GList link;
+
+    GMainLoop *loop;
+    WorkerPort inbox;  /* to the worker thread */
+    WorkerPort outbox; /* to the creating thread */
+
+    GMutex lock;
+    JSRuntime *runtime; /* while the worker thread has one */
+    gboolean finished;
+    volatile gint terminated;
+} GjsWorker;
+
+static GPrivate current_worker;
+
+GJS_DEFINE_PROTO("Worker", worker)
+GJS_DEFINE_PRIV_FROM_JS(GjsWorker, gjs_worker_class)
+
+static GjsWorker *
+worker_ref(GjsWorker *worker)
+{
+    g_atomic_int_inc(&worker->refcount);
+    return worker;
+}
+
+static void
+worker_port_clear(WorkerPort *port)
+{
+    GVariant *message;
+
+    while ((message = g_queue_pop_head(&port->messages)) != NULL)
+        g_variant_unref(message);
+    g_assert(port->source == NULL);
+    g_main_context_unref(port->main_context);
+}
+
+static void
+worker_unref(gpointer data)
+{
+    GjsWorker *worker = data;
+
+    if (!g_atomic_int_dec_and_test(&worker->refcount))
+        return;
+
+    g_assert(worker->thread == NULL);
+
+    worker_port_clear(&worker->inbox);
+    worker_port_clear(&worker->outbox);
+    g_main_loop_unref(worker->loop);
+    g_mutex_clear(&worker->lock);
+    g_free(worker->filename);
+    g_slice_free(GjsWorker, worker);
+}
+
+/* Called with the worker lock held */
+static void
+worker_port_schedule(GjsWorker  *worker,
+                     WorkerPort *port,
+                     GSourceFunc dispatch)
+{
+    if (port->source != NULL)
+        return;
+
+    /* nothing runs the main context of a finished worker thread */
+    if (port == &worker->inbox && worker->finished)
+        return;
+
+    port->source = g_idle_source_new();
+    g_source_set_callback(port->source, dispatch, worker_ref(worker), worker_unref);
+    g_source_attach(port->source, port->main_context);
+}
+
+/* Called with the worker lock held */
+static void
+worker_port_cancel(WorkerPort *port)
+{
+    if (port->source == NULL)
+        return;
+
+    g_source_destroy(port->source);
+    g_source_unref(port->source);
+    port->source = NULL;
+}
+
+static void
+worker_port_take(GjsWorker  *worker,
+                 WorkerPort *port,
+                 GQueue     *messages_out)
+{
+    g_mutex_lock(&worker->lock);
+    *messages_out = port->messages;
+    g_queue_init(&port->messages);
+    /* may already be cancelled by the time the dispatch runs */
+    g_clear_pointer(&port->source, g_source_unref);
+    g_mutex_unlock(&worker->lock);
+}
+
+static GVariant *
+message_from_value(JSContext *context,
+                   jsval      value,
+                   int        depth);
+
+static GVariant *
+message_from_array(JSContext *context,
+                   JSObject  *array,
+                   int        depth)
+{
+    GVariantBuilder builder;
+    guint32 length, i;
+
+    if (!JS_GetArrayLength(context, array, &length))
+        return NULL;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("av"));
+
+    for (i = 0; i < length; i++) {
+        jsval elem;
+        GVariant *child;
+
+        if (!JS_GetElement(context, array, i, &elem))
+            goto fail;
+
+        child = message_from_value(context, elem, depth + 1);
+        if (child == NULL)
+            goto fail;
+
+        g_variant_builder_add(&builder, "v", child);
+    }
+
+    return g_variant_builder_end(&builder);
+
+ fail:
+    g_variant_builder_clear(&builder);
+    return NULL;
+}
+
+static GVariant *
+message_from_object(JSContext *context,
+                    JSObject  *obj,
+                    int        depth)
+{
+    GVariantBuilder builder;
+    JSObject *iter;
+    jsid prop_id;
+
+    iter = JS_NewPropertyIterator(context, obj);
+    if (iter == NULL)
+        return NULL;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+
+    prop_id = JSID_VOID;
+    if (!JS_NextProperty(context, iter, &prop_id))
+        goto fail;
+
+    while (!JSID_IS_VOID(prop_id)) {
+        jsval name_val, value;
+        JSString *name_str;
+        char *name;
+        GVariant *child;
+
+        if (!JS_IdToValue(context, prop_id, &name_val))
+            goto fail;
+
+        name_str = JS_ValueToString(context, name_val);
+        if (name_str == NULL)
+            goto fail;
+
+        if (!JS_GetPropertyById(context, obj, prop_id, &value))
+            goto fail;
+
+        if (!gjs_string_to_utf8(context, STRING_TO_JSVAL(name_str), &name))
+            goto fail;
+
+        child = message_from_value(context, value, depth + 1);
+        if (child == NULL) {
+            g_free(name);
+            goto fail;
+        }
+
+        g_variant_builder_add(&builder, "{sv}", name, child);
+        g_free(name);
+
+        prop_id = JSID_VOID;
+        if (!JS_NextProperty(context, iter, &prop_id))
+            goto fail;
+    }
+
+    return g_variant_builder_end(&builder);
+
+ fail:
+    g_variant_builder_clear(&builder);
+    return NULL;
+}
+
+static GVariant *
+message_from_value(JSContext *context,
+                   jsval      value,
+                   int        depth)
+{
+    JSObject *obj;
+
+    if (depth > MAX_MESSAGE_DEPTH) {
+        gjs_throw(context, "Worker message is nested too deeply, or cyclic");
+        return NULL;
+    }
+
+    if (JSVAL_IS_VOID(value))
+        return g_variant_new_tuple(NULL, 0);
+
+    if (JSVAL_IS_NULL(value))
+        return g_variant_new_maybe(G_VARIANT_TYPE_VARIANT, NULL);
+
+    if (JSVAL_IS_BOOLEAN(value))
+        return g_variant_new_boolean(JSVAL_TO_BOOLEAN(value));
+
+    if (JSVAL_IS_INT(value))
+        return g_variant_new_int32(JSVAL_TO_INT(value));
+
+    if (JSVAL_IS_DOUBLE(value))
+        return g_variant_new_double(JSVAL_TO_DOUBLE(value));
+
+    if (JSVAL_IS_STRING(value)) {
+        GVariant *variant;
+        char *str;
+
+        if (!gjs_string_to_utf8(context, value, &str))
+            return NULL;
+
+        variant = g_variant_new_string(str);
+        g_free(str);
+        return variant;
+    }
+
+    obj = JSVAL_TO_OBJECT(value);
+
+    if (JS_ObjectIsFunction(context, obj)) {
+        gjs_throw(context, "Functions cannot be posted to a worker");
+        return NULL;
+    }
+
+    /* The GBytes is shared rather than copied; it is immutable, and a
+     * ByteArray that gets modified later detaches onto its own copy.
+     */
+    if (gjs_typecheck_bytearray(context, obj, JS_FALSE)) {
+        GBytes *bytes;
+        GVariant *variant;
+
+        bytes = gjs_byte_array_get_bytes(context, obj);
+        variant = g_variant_new_from_bytes(G_VARIANT_TYPE_BYTESTRING, bytes, TRUE);
+        g_bytes_unref(bytes);
+        return variant;
+    }
+
+    if (gjs_typecheck_boxed(context, obj, NULL, G_TYPE_BYTES, JS_FALSE)) {
+        GBytes *bytes = gjs_c_struct_from_boxed(context, obj);
+
+        return g_variant_new_from_bytes(G_VARIANT_TYPE_BYTESTRING, bytes, TRUE);
+    }
+
+    if (JS_IsArrayObject(context, obj))
+        return message_from_array(context, obj, depth);
+
+    /* Only plain objects are copied as a bag of properties; the state of
+     * GObjects, boxed structs, Dates and other native objects isn't in
+     * their properties, and their copy would silently lose it.
+     */
+    if (strcmp(JS_GetClass(obj)->name, "Object") != 0) {
+        gjs_throw_custom(context, "TypeError",
+                         "%s objects cannot be posted to a worker",
+                         JS_GetClass(obj)->name);
+        return NULL;
+    }
+
+    return message_from_object(context, obj, depth);
+}
+
+/* @value_p must be rooted */
+static JSBool
+message_to_value(JSContext *context,
+                 GVariant  *message,
+                 jsval     *value_p)
+{
+    switch (g_variant_classify(message)) {
+    case G_VARIANT_CLASS_TUPLE:
+        *value_p = JSVAL_VOID;
+        return JS_TRUE;
+    case G_VARIANT_CLASS_MAYBE:
+        *value_p = JSVAL_NULL;
+        return JS_TRUE;
+    case G_VARIANT_CLASS_BOOLEAN:
+        *value_p = BOOLEAN_TO_JSVAL(g_variant_get_boolean(message));
+        return JS_TRUE;
+    case G_VARIANT_CLASS_INT32:
+        *value_p = INT_TO_JSVAL(g_variant_get_int32(message));
+        return JS_TRUE;
+    case G_VARIANT_CLASS_DOUBLE:
+        return JS_NewNumberValue(context, g_variant_get_double(message), value_p);
+    case G_VARIANT_CLASS_STRING:
+        return gjs_string_from_utf8(context,
+                                    g_variant_get_string(message, NULL), -1,
+                                    value_p);
+    case G_VARIANT_CLASS_ARRAY:
+        break;
+    default:
+        g_assert_not_reached();
+    }
+
+    if (g_variant_is_of_type(message, G_VARIANT_TYPE_BYTESTRING)) {
+        GBytes *bytes;
+        JSObject *obj;
+
+        bytes = g_variant_get_data_as_bytes(message);
+        obj = gjs_byte_array_from_bytes(context, bytes);
+        g_bytes_unref(bytes);
+        if (obj == NULL)
+            return JS_FALSE;
+
+        *value_p = OBJECT_TO_JSVAL(obj);
+        return JS_TRUE;
+    } else {
+        JSRuntime *runtime = JS_GetRuntime(context);
+        gboolean is_array;
+        JSObject *obj;
+        jsval *child_p;
+        JSBool ret = JS_FALSE;
+        gsize n_children, i;
+
+        is_array = g_variant_is_of_type(message, G_VARIANT_TYPE("av"));
+        n_children = g_variant_n_children(message);
+
+        if (is_array)
+            obj = JS_NewArrayObject(context, 0, NULL);
+        else
+            obj = JS_NewObject(context, NULL, NULL, NULL);
+        if (obj == NULL)
+            return JS_FALSE;
+        *value_p = OBJECT_TO_JSVAL(obj);
+
+        /* the child value and the property name */
+        child_p = gjs_runtime_push_values(runtime, 2);
+
+        for (i = 0; i < n_children; i++) {
+            GVariant *child;
+            const char *name;
+            jsid id;
+
+            if (is_array) {
+                g_variant_get_child(message, i, "v", &child);
+            } else {
+                g_variant_get_child(message, i, "{&sv}", &name, &child);
+            }
+
+            if (!message_to_value(context, child, &child_p[0])) {
+                g_variant_unref(child);
+                goto out;
+            }
+            g_variant_unref(child);
+
+            if (is_array) {
+                if (!JS_DefineElement(context, obj, i, child_p[0],
+                                      NULL, NULL, JSPROP_ENUMERATE))
+                    goto out;
+            } else {
+                if (!gjs_string_from_utf8(context, name, -1, &child_p[1]) ||
+                    !JS_ValueToId(context, child_p[1], &id) ||
+                    !JS_SetPropertyById(context, obj, id, &child_p[0]))
+                    goto out;
+            }
+        }
+
+        ret = JS_TRUE;
+
+    out:
+        gjs_runtime_pop_values(runtime, child_p, 2);
+        return ret;
+    }
+}
+
+/* Calls the onmessage handler of @this_obj with each message in turn */
+static void
+deliver_messages(JSContext *context,
+                 JSObject  *this_obj,
+                 GQueue    *messages)
+{
+    JSRuntime *runtime = JS_GetRuntime(context);
+    GVariant *message;
+    jsval *argv;
+
+    JS_BeginRequest(context);
+
+    /* the handler, the message and the return value */
+    argv = gjs_runtime_push_values(runtime, 3);
+
+    while ((message = g_queue_pop_head(messages)) != NULL) {
+        if (!JS_GetProperty(context, this_obj, "onmessage", &argv[0]) ||
+            !message_to_value(context, message, &argv[1])) {
+            gjs_log_exception(context);
+        } else if (JSVAL_IS_OBJECT(argv[0]) && !JSVAL_IS_NULL(argv[0]) &&
+                   JS_ObjectIsFunction(context, JSVAL_TO_OBJECT(argv[0]))) {
+            if (!gjs_call_function_value(context, this_obj, argv[0],
+                                         1, &argv[1], &argv[2]))
+                gjs_log_exception(context);
+        }
+
+        g_variant_unref(message);
+    }
+
+    gjs_runtime_pop_values(runtime, argv, 3);
+    JS_EndRequest(context);
+}
+
+static void
+worker_post(GjsWorker  *worker,
+            WorkerPort *port,
+            GSourceFunc dispatch,
+            GVariant   *message)
+{
+    g_mutex_lock(&worker->lock);
+    g_queue_push_tail(&port->messages, g_variant_ref_sink(message));
+    worker_port_schedule(worker, port, dispatch);
+    g_mutex_unlock(&worker->lock);
+}
+
+/* Runs on the thread that created the worker, once the worker thread
+ * is done or about to be
+ */
+static void
+worker_join(JSContext *context,
+            GjsWorker *worker)
+{
+    GjsWrapperState *state;
+
+    g_thread_join(worker->thread);
+    worker->thread = NULL;
+
+    state = gjs_runtime_get_wrapper_state(worker->parent_runtime);
+    g_queue_unlink(&state->workers, &worker->link);
+
+    /* Nothing can reach the worker object from the thread anymore */
+    JS_RemoveObjectRoot(context, &worker->object);
+}
+
+/* Runs on the thread that created the worker */
+static gboolean
+dispatch_to_parent(gpointer data)
+{
+    GjsWorker *worker = data;
+    JSContext *context;
+    GQueue messages;
+    gboolean finished;
+
+    worker_port_take(worker, &worker->outbox, &messages);
+
+    g_mutex_lock(&worker->lock);
+    finished = worker->finished;
+    g_mutex_unlock(&worker->lock);
+
+    context = gjs_runtime_get_context(worker->parent_runtime);
+
+    if (worker->object != NULL)
+        deliver_messages(context, worker->object, &messages);
+
+    g_queue_foreach(&messages, (GFunc) g_variant_unref, NULL);
+    g_queue_clear(&messages);
+
+    if (finished && worker->thread != NULL)
+        worker_join(context, worker);
+
+    return FALSE;
+}
+
+/* Runs on the worker thread */
+static gboolean
+dispatch_to_worker(gpointer data)
+{
+    GjsWorker *worker = data;
+    JSContext *context;
+    GQueue messages;
+
+    worker_port_take(worker, &worker->inbox, &messages);
+
+    if (g_atomic_int_get(&worker->terminated)) {
+        g_main_loop_quit(worker->loop);
+    } else {
+        context = gjs_context_get_native_context(gjs_context_get_current());
+        deliver_messages(context, gjs_get_import_global(context), &messages);
+    }
+
+    g_queue_foreach(&messages, (GFunc) g_variant_unref, NULL);
+    g_queue_clear(&messages);
+
+    return FALSE;
+}
+
+/* @interrupt is FALSE for close(), which lets the handler that
+ * called it run to completion.
+ */
+static void
+worker_terminate(GjsWorker *worker,
+                 gboolean   interrupt)
+{
+    g_atomic_int_set(&worker->terminated, TRUE);
+
+    g_mutex_lock(&worker->lock);
+
+    /* Interrupts a script that is still running... */
+    if (interrupt && worker->runtime != NULL)
+        JS_TriggerOperationCallback(worker->runtime);
+
+    /* ...or quits the loop from inside, which can't miss a loop
+     * that hasn't started running yet.
+     */
+    worker_port_schedule(worker, &worker->inbox, dispatch_to_worker);
+
+    g_mutex_unlock(&worker->lock);
+}
+
+/**
+ * gjs_worker_terminate_all:
+ * @runtime: a #JSRuntime
+ *
+ * Terminates and joins the workers created from @runtime that are
+ * still running, and drops the messages they posted that weren't
+ * delivered yet, before the context of @runtime is destroyed.
+ */
+void
+gjs_worker_terminate_all(JSRuntime *runtime)
+{
+    GjsWrapperState *state;
+    JSContext *context;
+    GList *link;
+
+    state = gjs_runtime_get_wrapper_state(runtime);
+    context = gjs_runtime_get_context(runtime);
+
+    JS_BeginRequest(context);
+    while ((link = g_queue_peek_head_link(&state->workers)) != NULL) {
+        GjsWorker *worker = link->data;
+
+        worker_terminate(worker, TRUE);
+        worker_join(context, worker);
+
+        g_mutex_lock(&worker->lock);
+        worker_port_cancel(&worker->outbox);
+        g_mutex_unlock(&worker->lock);
+    }
+    JS_EndRequest(context);
+}
+
+static JSBool
+worker_operation_callback(JSContext *context)
+{
+    GjsWorker *worker = g_private_get(&current_worker);
+
+    return !g_atomic_int_get(&worker->terminated);
+}
+
+static JSBool
+worker_global_post_message(JSContext *context,
+                           unsigned   argc,
+                           jsval     *vp)
+{
+    jsval *argv = JS_ARGV(context, vp);
+    GjsWorker *worker = g_private_get(&current_worker);
+    GVariant *message;
+
+    message = message_from_value(context, argc > 0 ? argv[0] : JSVAL_VOID, 0);
+    if (message == NULL)
+        return JS_FALSE;
+
+    worker_post(worker, &worker->outbox, dispatch_to_parent, message);
+
+    JS_SET_RVAL(context, vp, JSVAL_VOID);
+    return JS_TRUE;
+}
+
+static JSBool
+worker_global_close(JSContext *context,
+                    unsigned   argc,
+                    jsval     *vp)
+{
+    jsval *argv = JS_ARGV(context, vp);
+
+    if (!gjs_parse_args(context, "close", "", argc, argv))
+        return JS_FALSE;
+
+    worker_terminate(g_private_get(&current_worker), FALSE);
+
+    JS_SET_RVAL(context, vp, JSVAL_VOID);
+    return JS_TRUE;
+}
+
+static JSFunctionSpec worker_global_funcs[] = {
+    { "postMessage", JSOP_WRAPPER((JSNative)worker_global_post_message), 1, GJS_MODULE_PROP_FLAGS },
+    { "close", JSOP_WRAPPER((JSNative)worker_global_close), 0, GJS_MODULE_PROP_FLAGS },
+    { NULL }
+};
+
+static gpointer
+worker_thread_main(gpointer data)
+{
+    GjsWorker *worker = data;
+    GjsContext *js_context;
+    JSContext *context;
+    GError *error = NULL;
+    int status;
+
+    g_main_context_push_thread_default(worker->inbox.main_context);
+    g_private_set(&current_worker, worker);
+
+    /* Picks up the thread-default main context for its runtime */
+    js_context = g_object_new(GJS_TYPE_CONTEXT, NULL);
+    context = gjs_context_get_native_context(js_context);
+
+    g_mutex_lock(&worker->lock);
+    worker->runtime = JS_GetRuntime(context);
+    g_mutex_unlock(&worker->lock);
+
+    JS_SetOperationCallback(context, worker_operation_callback);
+
+    JS_BeginRequest(context);
+    if (!JS_DefineFunctions(context, gjs_get_import_global(context),
+                            &worker_global_funcs[0]))
+        g_error("Failed to define worker functions");
+    JS_EndRequest(context);
+
+    if (!gjs_context_eval_file(js_context, worker->filename, &status, &error)) {
+        if (!g_atomic_int_get(&worker->terminated))
+            g_warning("Worker %s failed: %s", worker->filename, error->message);
+        g_clear_error(&error);
+    } else if (!g_atomic_int_get(&worker->terminated)) {
+        g_main_loop_run(worker->loop);
+    }
+
+    g_mutex_lock(&worker->lock);
+    worker->runtime = NULL;
+    g_mutex_unlock(&worker->lock);
+
+    g_object_unref(js_context);
+
+    g_private_set(&current_worker, NULL);
+    g_main_context_pop_thread_default(worker->inbox.main_context);
+
+    g_mutex_lock(&worker->lock);
+    worker->finished = TRUE;
+    worker_port_cancel(&worker->inbox);
+    worker_port_schedule(worker, &worker->outbox, dispatch_to_parent);
+    g_mutex_unlock(&worker->lock);
+
+    worker_unref(worker);
+    return NULL;
+}
+
+GJS_NATIVE_CONSTRUCTOR_DECLARE(worker)
+{
+    GJS_NATIVE_CONSTRUCTOR_VARIABLES(worker)
+    char *filename;
+    GjsWorker *worker;
+    GError *error = NULL;
+
+    GJS_NATIVE_CONSTRUCTOR_PRELUDE(worker);
+
+    if (!gjs_parse_args(context, "Worker", "F", argc, argv,
+                        "filename", &filename))
+        return JS_FALSE;
+
+    worker = g_slice_new0(GjsWorker);
+    worker->refcount = 1;
+    worker->filename = filename;
+    worker->parent_runtime = JS_GetRuntime(context);
+    worker->object = object;
+    worker->link.data = worker;
+    g_mutex_init(&worker->lock);
+
+    worker->inbox.main_context = g_main_context_new();
+    worker->outbox.main_context = g_main_context_ref(gjs_runtime_get_main_context(worker->parent_runtime));
+    g_queue_init(&worker->inbox.messages);
+    g_queue_init(&worker->outbox.messages);
+    worker->loop = g_main_loop_new(worker->inbox.main_context, FALSE);
+
+    g_assert(priv_from_js(context, object) == NULL);
+    JS_SetPrivate(object, worker);
+
+    /* The object stays alive while the thread runs, so that its
+     * onmessage handler can be reached from the messages it posts.
+     */
+    JS_AddNamedObjectRoot(context, &worker->object, "Worker");
+
+    worker->thread = g_thread_try_new("gjs-worker", worker_thread_main,
+                                      worker_ref(worker), &error);
+    if (worker->thread == NULL) {
+        JS_RemoveObjectRoot(context, &worker->object);
+        worker_unref(worker);
+        gjs_throw(context, "Failed to start worker: %s", error->message);
+        g_error_free(error);
+        return JS_FALSE;
+    }
+
+    g_queue_push_tail_link(&gjs_runtime_get_wrapper_state(worker->parent_runtime)->workers,
+                           &worker->link);
+
+    GJS_NATIVE_CONSTRUCTOR_FINISH(worker);
+
+    return JS_TRUE;
+}
+
+static void
+gjs_worker_finalize(JSFreeOp *fop,
+                    JSObject *obj)
+{
+    GjsWorker *worker = JS_GetPrivate(obj);
+
+    if (worker == NULL)
+        return; /* prototype */
+
+    /* The root is only dropped once the thread has been joined */
+    worker->object = NULL;
+    worker_unref(worker);
+}
+
+static JSBool
+worker_post_message_func(JSContext *context,
+                         unsigned   argc,
+                         jsval     *vp)
+{
+    jsval *argv = JS_ARGV(context, vp);
+    JSObject *obj = JS_THIS_OBJECT(context, vp);
+    GjsWorker *worker;
+    GVariant *message;
+
+    worker = priv_from_js(context, obj);
+    if (worker == NULL) {
+        gjs_throw(context, "postMessage() called on the Worker prototype");
+        return JS_FALSE;
+    }
+
+    if (g_atomic_int_get(&worker->terminated)) {
+        gjs_throw(context, "Worker has been terminated");
+        return JS_FALSE;
+    }
+
+    message = message_from_value(context, argc > 0 ? argv[0] : JSVAL_VOID, 0);
+    if (message == NULL)
+        return JS_FALSE;
+
+    worker_post(worker, &worker->inbox, dispatch_to_worker, message);
+
+    JS_SET_RVAL(context, vp, JSVAL_VOID);
+    return JS_TRUE;
+}
+
+static JSBool
+worker_terminate_func(JSContext *context,
+                      unsigned   argc,
+                      jsval     *vp)
+{
+    jsval *argv = JS_ARGV(context, vp);
+    JSObject *obj = JS_THIS_OBJECT(context, vp);
+    GjsWorker *worker;
+
+    if (!gjs_parse_args(context, "terminate", "", argc, argv))
+        return JS_FALSE;
+
+    worker = priv_from_js(context, obj);
+    if (worker != NULL)
+        worker_terminate(worker, TRUE);
+
+    JS_SET_RVAL(context, vp, JSVAL_VOID);
+    return JS_TRUE;
+}
+
+static JSPropertySpec gjs_worker_proto_props[] = {
+    { NULL }
+};
+
+static JSFunctionSpec gjs_worker_proto_funcs[] = {
+    { "postMessage", JSOP_WRAPPER((JSNative)worker_post_message_func), 1, 0 },
+    { "terminate", JSOP_WRAPPER((JSNative)worker_terminate_func), 0, 0 },
+    { NULL }
+};
+
+JSBool
+gjs_define_worker_stuff(JSContext *context,
+                        JSObject  *module)
+{
+    jsval obj;
+
+    obj = gjs_worker_create_proto(context, module, "Worker", NULL);
+    return !JSVAL_IS_NULL(obj);
+}
@@ -23,8 +23,12 @@
 
 #include <config.h>
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <glib-object.h>
+#include <unistd.h>
 #include <gjs/gjs-module.h>
+#include <gi/keep-alive.h>
+#include <gi/object.h>
 #include <util/glib.h>
 #include <util/crash.h>
 
@@ -90,6 +94,183 @@ gjstest_test_func_gjs_context_construct_eval(void)
     g_object_unref (context);
 }
 
+/* Disposing of a context must stop the workers it started, both busy
+ * and idle ones, and drop what they posted
+ */
+static void
+gjstest_test_func_gjs_context_dispose_workers(void)
+{
+    GjsContext *context;
+    GError *error = NULL;
+    char *busy_path, *idle_path, *script;
+    int fd;
+
+    fd = g_file_open_tmp("gjs-test-busy-worker-XXXXXX.js", &busy_path, &error);
+    g_assert_no_error(error);
+    close(fd);
+    g_file_set_contents(busy_path, "postMessage('started'); while (true) ;",
+                        -1, &error);
+    g_assert_no_error(error);
+
+    fd = g_file_open_tmp("gjs-test-idle-worker-XXXXXX.js", &idle_path, &error);
+    g_assert_no_error(error);
+    close(fd);
+    g_file_set_contents(idle_path, "postMessage('started');", -1, &error);
+    g_assert_no_error(error);
+
+    script = g_strdup_printf("const Worker = imports.worker.Worker;\n"
+                             "new Worker('%s');\n"
+                             "new Worker('%s');\n",
+                             busy_path, idle_path);
+
+    context = gjs_context_new();
+    if (!gjs_context_eval(context, script, -1, "<workers>", NULL, &error))
+        g_error("%s", error->message);
+    g_object_unref(context);
+
+    g_unlink(busy_path);
+    g_unlink(idle_path);
+    g_free(busy_path);
+    g_free(idle_path);
+    g_free(script);
+}
+
+#define N_THREADS 4
+
+static gpointer
+context_thread_func(gpointer data)
+{
+    int index = GPOINTER_TO_INT(data);
+    GMainContext *main_context;
+    GjsContext *context;
+    GError *error = NULL;
+    char *script;
+
+    main_context = g_main_context_new();
+    g_main_context_push_thread_default(main_context);
+
+    context = gjs_context_new();
+    g_assert(gjs_context_get_current() == context);
+
+    /* Exercises class registration, construction of JS-implemented
+     * objects, signals, properties and plain GI calls at the same time
+     * as the other threads.
+     */
+    script = g_strdup_printf("const GLib = imports.gi.GLib;\n"
+                             "const GObject = imports.gi.GObject;\n"
+                             "const Counter = new GObject.Class({\n"
+                             "    Name: 'ThreadCounter%d',\n"
+                             "    Properties: { 'count': GObject.ParamSpec.int('count', '', '',\n"
+                             "        GObject.ParamFlags.READWRITE, 0, 1000000, 0) },\n"
+                             "    _init: function(params) {\n"
+                             "        this._count = 0;\n"
+                             "        this.parent(params);\n"
+                             "    },\n"
+                             "    get count() { return this._count; },\n"
+                             "    set count(v) { this._count = v; this.notify('count'); },\n"
+                             "});\n"
+                             "let total = 0;\n"
+                             "for (let i = 0; i < 2000; i++) {\n"
+                             "    let counter = new Counter();\n"
+                             "    counter.connect('notify::count', function(o) { total += o.count; });\n"
+                             "    counter.count = i;\n"
+                             "    if (GLib.ascii_strup('abc', -1) != 'ABC')\n"
+                             "        throw new Error('bad GI call');\n"
+                             "}\n"
+                             "if (total != 1999 * 2000 / 2)\n"
+                             "    throw new Error('bad total ' + total);\n",
+                             index);
+
+    if (!gjs_context_eval(context, script, -1, "<thread>", NULL, &error))
+        g_error("thread %d: %s", index, error->message);
+
+    g_free(script);
+    g_object_unref(context);
+    g_assert(gjs_context_get_current() == NULL);
+
+    g_main_context_pop_thread_default(main_context);
+    g_main_context_unref(main_context);
+
+    return NULL;
+}
+
+static void
+gjstest_test_func_gjs_context_threads(void)
+{
+    GThread *threads[N_THREADS];
+    int i;
+
+    for (i = 0; i < N_THREADS; i++)
+        threads[i] = g_thread_new("gjs-test", context_thread_func, GINT_TO_POINTER(i));
+
+    for (i = 0; i < N_THREADS; i++)
+        g_thread_join(threads[i]);
+}
+
+static gpointer
+shared_singleton_thread_func(gpointer data)
+{
+    GMainContext *main_context;
+    GjsContext *context;
+    GError *error = NULL;
+    int exit_status;
+
+    main_context = g_main_context_new();
+    g_main_context_push_thread_default(main_context);
+
+    context = gjs_context_new();
+
+    /* Must neither get the wrapper of the main thread nor a second one */
+    if (!gjs_context_eval(context,
+                          "const Gio = imports.gi.Gio;\n"
+                          "let refused = false;\n"
+                          "try {\n"
+                          "    Gio.Vfs.get_default();\n"
+                          "} catch (e) {\n"
+                          "    refused = e.message.indexOf('another thread') >= 0;\n"
+                          "}\n"
+                          "refused ? 0 : 1;\n",
+                          -1, "<shared-singleton>", &exit_status, &error))
+        g_error("%s", error->message);
+    g_assert_cmpint(exit_status, ==, 0);
+
+    g_object_unref(context);
+
+    g_main_context_pop_thread_default(main_context);
+    g_main_context_unref(main_context);
+
+    return NULL;
+}
+
+static void
+gjstest_test_func_gjs_context_shared_singleton(void)
+{
+    GjsContext *context;
+    GError *error = NULL;
+    int exit_status;
+
+    context = gjs_context_new();
+
+    if (!gjs_context_eval(context,
+                          "const Gio = imports.gi.Gio;\n"
+                          "var vfs = Gio.Vfs.get_default();\n"
+                          "vfs.owner = 'main';\n",
+                          -1, "<shared-singleton>", NULL, &error))
+        g_error("%s", error->message);
+
+    g_thread_join(g_thread_new("gjs-test", shared_singleton_thread_func, NULL));
+
+    /* The wrapper of the main thread is left alone */
+    if (!gjs_context_eval(context,
+                          "imports.system.gc();\n"
+                          "Gio.Vfs.get_default() === vfs && vfs.owner === 'main' ? 0 : 1;\n",
+                          -1, "<shared-singleton>", &exit_status, &error))
+        g_error("%s", error->message);
+    g_assert_cmpint(exit_status, ==, 0);
+
+    g_object_unref(context);
+}
+
 #define N_ELEMS 15
 
 static void
@@ -130,6 +311,236 @@ gjstest_test_func_gjs_jsapi_util_array(void)
 
 #undef N_ELEMS
 
+static void
+keep_alive_count_notify(JSObject *obj,
+                        void     *data)
+{
+    guint *n_notified = data;
+
+    (*n_notified)++;
+}
+
+#define N_CHILDREN 5000
+
+static void
+gjstest_test_func_gjs_keep_alive_children(void)
+{
+    GjsUnitTestFixture fixture;
+    JSContext *context;
+    JSObject *keep_alive;
+    JSObject **children;
+    guint n_notified = 0;
+    int i;
+
+    _gjs_unit_test_fixture_begin(&fixture);
+    context = fixture.context;
+
+    keep_alive = gjs_keep_alive_new(context);
+    JS_AddObjectRoot(context, &keep_alive);
+
+    children = g_new(JSObject *, N_CHILDREN);
+    for (i = 0; i < N_CHILDREN; i++) {
+        children[i] = JS_NewObject(context, NULL, NULL, NULL);
+        gjs_keep_alive_add_child(context, keep_alive,
+                                 keep_alive_count_notify, children[i],
+                                 &n_notified);
+    }
+
+    /* Remove every other child, so that the table is left with
+     * holes to probe across.
+     */
+    for (i = 0; i < N_CHILDREN; i += 2)
+        gjs_keep_alive_remove_child(context, keep_alive,
+                                    keep_alive_count_notify, children[i],
+                                    &n_notified);
+
+    /* Removing a child that isn't there is a no-op */
+    gjs_keep_alive_remove_child(context, keep_alive,
+                                keep_alive_count_notify, children[0],
+                                &n_notified);
+
+    JS_GC(fixture.runtime);
+    g_assert_cmpuint(n_notified, ==, 0);
+
+    JS_RemoveObjectRoot(context, &keep_alive);
+    g_free(children);
+
+    /* Tearing down the runtime finalizes the keep-alive, which
+     * notifies the remaining children.
+     */
+    _gjs_unit_test_fixture_finish(&fixture);
+    g_assert_cmpuint(n_notified, ==, N_CHILDREN / 2);
+}
+
+#undef N_CHILDREN
+
+/* Measures how GC mark time grows with the number of children of a
+ * KeepAlive, which is where every live closure and toggled-up object
+ * ends up. Only run with -m perf.
+ */
+static void
+gjstest_test_func_gjs_keep_alive_gc_perf(void)
+{
+    GjsUnitTestFixture fixture;
+    JSContext *context;
+    JSObject *keep_alive;
+    GTimer *timer;
+    guint n_children, n_added;
+
+    if (!g_test_perf())
+        return;
+
+    _gjs_unit_test_fixture_begin(&fixture);
+    context = fixture.context;
+
+    keep_alive = gjs_keep_alive_new(context);
+    JS_AddObjectRoot(context, &keep_alive);
+
+    timer = g_timer_new();
+    n_added = 0;
+
+    for (n_children = 1000; n_children <= 256000; n_children *= 4) {
+        for (; n_added < n_children; n_added++) {
+            JSObject *child = JS_NewObject(context, NULL, NULL, NULL);
+
+            gjs_keep_alive_add_child(context, keep_alive, NULL, child, NULL);
+        }
+
+        /* Warm up once so that the timed GC only marks */
+        JS_GC(fixture.runtime);
+
+        g_timer_start(timer);
+        JS_GC(fixture.runtime);
+        g_timer_stop(timer);
+
+        g_test_minimized_result(g_timer_elapsed(timer, NULL),
+                                "GC with %u keep-alive children: %.3f ms",
+                                n_children,
+                                g_timer_elapsed(timer, NULL) * 1000);
+    }
+
+    g_timer_destroy(timer);
+
+    JS_RemoveObjectRoot(context, &keep_alive);
+
+    _gjs_unit_test_fixture_finish(&fixture);
+}
+
+/* Compares the pause of a full GC with the longest slice of an
+ * incremental GC while a large number of GObject wrappers is alive.
+ * Only run with -m perf.
+ */
+static void
+gjstest_test_func_gjs_gc_wrapper_pause_perf(void)
+{
+    GjsUnitTestFixture fixture;
+    GError *error = NULL;
+    GTimer *timer;
+    double full_pause, max_slice, slice;
+    guint n_slices;
+    gboolean in_progress;
+
+    if (!g_test_perf())
+        return;
+
+    _gjs_unit_test_fixture_begin(&fixture);
+
+    if (!gjs_context_eval(fixture.gjs_context,
+                          "const GObject = imports.gi.GObject;\n"
+                          "var wrappers = [];\n"
+                          "for (let i = 0; i < 1000000; i++)\n"
+                          "    wrappers.push(new GObject.Object());\n",
+                          -1, "<gc-perf>", NULL, &error))
+        g_error("%s", error->message);
+
+    timer = g_timer_new();
+
+    JS_GC(fixture.runtime);
+    g_timer_start(timer);
+    JS_GC(fixture.runtime);
+    g_timer_stop(timer);
+    full_pause = g_timer_elapsed(timer, NULL);
+
+    max_slice = 0;
+    n_slices = 0;
+    do {
+        g_timer_start(timer);
+        in_progress = gjs_gc_slice(fixture.runtime, 10);
+        g_timer_stop(timer);
+
+        slice = g_timer_elapsed(timer, NULL);
+        max_slice = MAX(max_slice, slice);
+        n_slices++;
+    } while (in_progress);
+
+    g_test_message("1M wrappers: full GC %.3f ms, incremental GC %u slices, "
+                   "longest %.3f ms",
+                   full_pause * 1000, n_slices, max_slice * 1000);
+    g_test_minimized_result(max_slice, "longest GC slice: %.3f ms",
+                            max_slice * 1000);
+
+    g_timer_destroy(timer);
+
+    _gjs_unit_test_fixture_finish(&fixture);
+}
+
+/* Looks up a wrapper that was unreachable when an incremental GC
+ * started, between two of its slices, and checks that it survives
+ * being handed back to JS.
+ */
+static void
+gjstest_test_func_gjs_gc_wrapper_lookup_between_slices(void)
+{
+    GjsUnitTestFixture fixture;
+    GError *error = NULL;
+    JSObject *global, *wrapper;
+    GObject *gobj;
+    jsval value;
+    int exit_status;
+
+    _gjs_unit_test_fixture_begin(&fixture);
+    global = JS_GetGlobalObject(fixture.context);
+
+    if (!gjs_context_eval(fixture.gjs_context,
+                          "const GObject = imports.gi.GObject;\n"
+                          "var garbage = [];\n"
+                          "for (let i = 0; i < 100000; i++)\n"
+                          "    garbage.push({ i: i });\n"
+                          "var wrapper = new GObject.Object();\n",
+                          -1, "<gc-slices>", NULL, &error))
+        g_error("%s", error->message);
+
+    g_assert(JS_GetProperty(fixture.context, global, "wrapper", &value));
+    gobj = gjs_g_object_from_object(fixture.context, JSVAL_TO_OBJECT(value));
+
+    /* Only the wrapper keeps gobj alive from here on */
+    if (!gjs_context_eval(fixture.gjs_context, "wrapper = null;",
+                          -1, "<gc-slices>", NULL, &error))
+        g_error("%s", error->message);
+
+    if (!gjs_gc_slice(fixture.runtime, 1)) {
+        g_test_message("GC finished in a single slice, nothing to check");
+        _gjs_unit_test_fixture_finish(&fixture);
+        return;
+    }
+
+    wrapper = gjs_object_from_g_object(fixture.context, gobj);
+    value = OBJECT_TO_JSVAL(wrapper);
+    g_assert(JS_SetProperty(fixture.context, global, "wrapper", &value));
+
+    while (gjs_gc_slice(fixture.runtime, 1))
+        ;
+    JS_GC(fixture.runtime);
+
+    if (!gjs_context_eval(fixture.gjs_context,
+                          "wrapper instanceof GObject.Object ? 0 : 1;",
+                          -1, "<gc-slices>", &exit_status, &error))
+        g_error("%s", error->message);
+    g_assert_cmpint(exit_status, ==, 0);
+
+    _gjs_unit_test_fixture_finish(&fixture);
+}
+
 static void
 gjstest_test_func_gjs_jsapi_util_string_js_string_utf8(void)
 {
@@ -153,6 +564,65 @@ gjstest_test_func_gjs_jsapi_util_string_js_string_utf8(void)
     g_free(utf8_result);
 }
 
+static void
+gjstest_test_func_gjs_jsapi_util_string_conversions(void)
+{
+    GjsUnitTestFixture fixture;
+    JSContext *context;
+    static const jschar lone_surrogate[] = { 'a', 0xd800, 'b' };
+    const char *astral = "x \360\237\230\200 y";
+    GString *ascii;
+    char *utf8_result;
+    jsval js_string, other;
+    gsize mark;
+    int i;
+
+    _gjs_unit_test_fixture_begin(&fixture);
+    context = fixture.context;
+
+    /* long enough for the word-at-a-time scan and the heap path */
+    ascii = g_string_new(NULL);
+    for (i = 0; i < 100; i++)
+        g_string_append(ascii, "abcdefg ");
+    g_assert(gjs_string_from_utf8(context, ascii->str, -1, &js_string));
+    g_assert_cmpuint(JS_GetStringLength(JSVAL_TO_STRING(js_string)), ==, ascii->len);
+    g_assert(gjs_string_to_utf8(context, js_string, &utf8_result));
+    g_assert_cmpstr(utf8_result, ==, ascii->str);
+    g_free(utf8_result);
+
+    /* surrogate pairs round-trip */
+    g_assert(gjs_string_from_utf8(context, astral, -1, &js_string));
+    g_assert_cmpuint(JS_GetStringLength(JSVAL_TO_STRING(js_string)), ==, 6);
+    g_assert(gjs_string_to_utf8(context, js_string, &utf8_result));
+    g_assert_cmpstr(utf8_result, ==, astral);
+    g_free(utf8_result);
+
+    /* lone surrogates can't be encoded */
+    js_string = STRING_TO_JSVAL(JS_NewUCStringCopyN(context, lone_surrogate,
+                                                    G_N_ELEMENTS(lone_surrogate)));
+    g_assert(!gjs_string_to_utf8(context, js_string, &utf8_result));
+    g_assert(JS_IsExceptionPending(context));
+    JS_ClearPendingException(context);
+
+    /* scratch strings are released in bulk */
+    mark = gjs_runtime_scratch_mark(fixture.runtime);
+    g_assert(gjs_string_from_utf8(context, ascii->str, -1, &js_string));
+    for (i = 0; i < 20; i++) {
+        g_assert(gjs_string_to_utf8_scratch(context, js_string, &utf8_result));
+        g_assert_cmpstr(utf8_result, ==, ascii->str);
+    }
+    gjs_runtime_scratch_release(fixture.runtime, mark);
+    g_assert_cmpuint(gjs_runtime_scratch_mark(fixture.runtime), ==, mark);
+
+    /* static strings are converted once */
+    g_assert(gjs_string_from_static_utf8(context, g_type_name(G_TYPE_OBJECT), &js_string));
+    g_assert(gjs_string_from_static_utf8(context, g_type_name(G_TYPE_OBJECT), &other));
+    g_assert(JSVAL_TO_STRING(js_string) == JSVAL_TO_STRING(other));
+
+    g_string_free(ascii, TRUE);
+    _gjs_unit_test_fixture_finish(&fixture);
+}
+
 static void
 gjstest_test_func_gjs_stack_dump(void)
 {
@@ -278,9 +748,17 @@ main(int    argc,
 
     g_test_add_func("/gjs/context/construct/destroy", gjstest_test_func_gjs_context_construct_destroy);
     g_test_add_func("/gjs/context/construct/eval", gjstest_test_func_gjs_context_construct_eval);
+    g_test_add_func("/gjs/context/threads", gjstest_test_func_gjs_context_threads);
+    g_test_add_func("/gjs/context/shared-singleton", gjstest_test_func_gjs_context_shared_singleton);
+    g_test_add_func("/gjs/context/dispose/workers", gjstest_test_func_gjs_context_dispose_workers);
     g_test_add_func("/gjs/jsapi/util/array", gjstest_test_func_gjs_jsapi_util_array);
     g_test_add_func("/gjs/jsapi/util/error/throw", gjstest_test_func_gjs_jsapi_util_error_throw);
     g_test_add_func("/gjs/jsapi/util/string/js/string/utf8", gjstest_test_func_gjs_jsapi_util_string_js_string_utf8);
+    g_test_add_func("/gjs/jsapi/util/string/conversions", gjstest_test_func_gjs_jsapi_util_string_conversions);
+    g_test_add_func("/gjs/keep-alive/children", gjstest_test_func_gjs_keep_alive_children);
+    g_test_add_func("/gjs/keep-alive/gc-perf", gjstest_test_func_gjs_keep_alive_gc_perf);
+    g_test_add_func("/gjs/gc/wrapper-pause-perf", gjstest_test_func_gjs_gc_wrapper_pause_perf);
+    g_test_add_func("/gjs/gc/wrapper-lookup-between-slices", gjstest_test_func_gjs_gc_wrapper_lookup_between_slices);
     g_test_add_func("/gjs/stack/dump", gjstest_test_func_gjs_stack_dump);
     g_test_add_func("/util/glib/strv/concat/null", gjstest_test_func_util_glib_strv_concat_null);
     g_test_add_func("/util/glib/strv/concat/pointers", gjstest_test_func_util_glib_strv_concat_pointers);
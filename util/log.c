@@ -30,229 +30,331 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <signal.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#undef gjs_debug
+
+guint32 gjs_debug_topics = G_MAXUINT32;
+
+G_STATIC_ASSERT(GJS_DEBUG_LAST_TOPIC <= 32);
+
+static const char *topic_prefixes[GJS_DEBUG_LAST_TOPIC] = {
+    /* this is a special magic topic for use with
+     * git clone http://www.gnome.org/~federico/git/performance-scripts.git
+     * http://www.gnome.org/~federico/news-2006-03.html#timeline-tools
+     */
+    [GJS_DEBUG_STRACE_TIMESTAMP] = "MARK",
+    [GJS_DEBUG_GI_USAGE] = "JS GI USE",
+    [GJS_DEBUG_MEMORY] = "JS MEMORY",
+    [GJS_DEBUG_CONTEXT] = "JS CTX",
+    [GJS_DEBUG_IMPORTER] = "JS IMPORT",
+    [GJS_DEBUG_NATIVE] = "JS NATIVE",
+    [GJS_DEBUG_KEEP_ALIVE] = "JS KP ALV",
+    [GJS_DEBUG_GREPO] = "JS G REPO",
+    [GJS_DEBUG_GNAMESPACE] = "JS G NS",
+    [GJS_DEBUG_GOBJECT] = "JS G OBJ",
+    [GJS_DEBUG_GFUNCTION] = "JS G FUNC",
+    [GJS_DEBUG_GCLOSURE] = "JS G CLSR",
+    [GJS_DEBUG_GBOXED] = "JS G BXD",
+    [GJS_DEBUG_GENUM] = "JS G ENUM",
+    [GJS_DEBUG_GPARAM] = "JS G PRM",
+    [GJS_DEBUG_DATABASE] = "JS DB",
+    [GJS_DEBUG_RESULTSET] = "JS RS",
+    [GJS_DEBUG_WEAK_HASH] = "JS WEAK",
+    [GJS_DEBUG_MAINLOOP] = "JS MAINLOOP",
+    [GJS_DEBUG_PROPS] = "JS PROPS",
+    [GJS_DEBUG_SCOPE] = "JS SCOPE",
+    [GJS_DEBUG_HTTP] = "JS HTTP",
+    [GJS_DEBUG_BYTE_ARRAY] = "JS BYTE ARRAY",
+    [GJS_DEBUG_GERROR] = "JS G ERR",
+    [GJS_DEBUG_GFUNDAMENTAL] = "JS G FNDMTL",
+};
+
+#define PREFIX_LENGTH 12
+
+static FILE *logfp = NULL;
+static gboolean print_timestamp = FALSE;
+static GTimer *timer = NULL;
+
 /* prefix is allowed if it's in the ;-delimited environment variable
  * GJS_DEBUG_TOPICS or if that variable is not set.
  */
 static gboolean
-is_allowed_prefix (const char *prefix)
+is_allowed_prefix (char      **prefixes,
+                   const char *prefix)
 {
-    static const char *topics = NULL;
-    static char **prefixes = NULL;
-    gboolean found = FALSE;
     int i;
 
-    if (topics == NULL) {
-        topics = g_getenv("GJS_DEBUG_TOPICS");
-
-        if (!topics)
-            return TRUE;
-
-        /* We never really free this, should be gone when the process exits */
-        prefixes = g_strsplit(topics, ";", -1);
-    }
-
     if (!prefixes)
         return TRUE;
 
     for (i = 0; prefixes[i] != NULL; i++) {
-        if (!strcmp(prefixes[i], prefix)) {
-            found = TRUE;
-            break;
-        }
+        if (!strcmp(prefixes[i], prefix))
+            return TRUE;
     }
 
-    return found;
+    return FALSE;
 }
 
-#define PREFIX_LENGTH 12
+/* Ring buffer backend
+ *
+ * Writers claim a slot with an atomic increment and publish it by
+ * storing its sequence number once the text is in. Each slot is read
+ * like a seqlock: the reader copies the text out and only prints it if
+ * the sequence number was the expected one both before and after the
+ * copy, so it never needs a lock and can run from a signal handler.
+ * A writer lapped by RING_N_SLOTS others while formatting can lose its
+ * message.
+ *
+ * The dump on SIGUSR2 and on crashes is only set up when
+ * GJS_DEBUG_RING_SIGNALS is set too, since it replaces the handlers
+ * the embedder may have installed for those signals.
+ */
+
+#define RING_N_SLOTS 1024
+#define RING_SLOT_SIZE 256
+
+typedef struct {
+    volatile gint seq;
+    char text[RING_SLOT_SIZE];
+} RingSlot;
+
+static RingSlot *ring = NULL;
+static volatile gint ring_next = 0;
 
 static void
-write_to_stream(FILE       *logfp,
-                const char *prefix,
-                const char *s)
+ring_append(const char *prefix,
+            const char *s)
 {
-    /* seek to end to avoid truncating in case we're using shared logfile */
-    (void)fseek(logfp, 0, SEEK_END);
+    guint seq;
+    RingSlot *slot;
+    gsize len;
 
-    fprintf(logfp, "%*s: %s", PREFIX_LENGTH, prefix, s);
-    if (!g_str_has_suffix(s, "\n"))
-        fputs("\n", logfp);
-    fflush(logfp);
+    seq = (guint) g_atomic_int_add(&ring_next, 1);
+    slot = &ring[seq % RING_N_SLOTS];
+
+    g_atomic_int_set(&slot->seq, -1);
+
+    len = g_snprintf(slot->text, RING_SLOT_SIZE, "%*s: %s", PREFIX_LENGTH, prefix, s);
+    if (len >= RING_SLOT_SIZE - 1)
+        len = RING_SLOT_SIZE - 2;
+    if (len == 0 || slot->text[len - 1] != '\n') {
+        slot->text[len] = '\n';
+        slot->text[len + 1] = '\0';
+    }
+
+    g_atomic_int_set(&slot->seq, (gint) seq);
 }
 
 void
-gjs_debug(GjsDebugTopic topic,
-          const char   *format,
-          ...)
+gjs_debug_dump_ring_buffer(int fd)
 {
-    static FILE *logfp = NULL;
-    static gboolean debug_log_enabled = FALSE;
-    static gboolean strace_timestamps = FALSE;
-    static gboolean checked_for_timestamp = FALSE;
-    static gboolean print_timestamp = FALSE;
-    static GTimer *timer = NULL;
-    const char *prefix;
-    va_list args;
-    char *s;
+    char text[RING_SLOT_SIZE];
+    guint next, seq;
 
-    if (!checked_for_timestamp) {
-        print_timestamp = gjs_environment_variable_is_set("GJS_DEBUG_TIMESTAMP");
-        checked_for_timestamp = TRUE;
-    }
+    if (ring == NULL)
+        return;
 
-    if (print_timestamp && !timer) {
-        timer = g_timer_new();
+    /* only async-signal-safe calls from here on */
+    next = (guint) g_atomic_int_get(&ring_next);
+    seq = next > RING_N_SLOTS ? next - RING_N_SLOTS : 0;
+
+    for (; seq != next; seq++) {
+        RingSlot *slot = &ring[seq % RING_N_SLOTS];
+        gint before, after;
+
+        /* the atomic reads are full barriers, so the copy can't be
+         * reordered outside of them; if a writer got in between, read
+         * again, and the slot turns out to hold a newer message
+         */
+        after = g_atomic_int_get(&slot->seq);
+        do {
+            before = after;
+            if ((guint) before != seq)
+                break;
+
+            memcpy(text, slot->text, RING_SLOT_SIZE);
+            after = g_atomic_int_get(&slot->seq);
+        } while (after != before);
+
+        if ((guint) before != seq)
+            continue;
+
+        text[RING_SLOT_SIZE - 1] = '\0';
+        if (write(fd, text, strlen(text)) < 0)
+            return;
     }
+}
 
-    if (logfp == NULL) {
-        const char *debug_output = g_getenv("GJS_DEBUG_OUTPUT");
-        if (debug_output != NULL &&
-            strcmp(debug_output, "stderr") == 0) {
-            debug_log_enabled = TRUE;
-        } else if (debug_output != NULL) {
-            const char *log_file;
-            char *free_me;
-            char *c;
-
-            /* Allow debug-%u.log for per-pid logfiles as otherwise log
-             * messages from multiple processes can overwrite each other.
-             *
-             * (printf below should be safe as we check '%u' is the only format
-             * string)
-             */
-            c = strchr(debug_output, '%');
-            if (c && c[1] == 'u' && !strchr(c+1, '%')) {
-                free_me = g_strdup_printf(debug_output, (guint)getpid());
-                log_file = free_me;
-            } else {
-                log_file = debug_output;
-                free_me = NULL;
-            }
+static void
+dump_ring_signal_handler(int signum)
+{
+    gjs_debug_dump_ring_buffer(STDERR_FILENO);
 
-            /* avoid truncating in case we're using shared logfile */
-            logfp = fopen(log_file, "a");
-            if (!logfp)
-                fprintf(stderr, "Failed to open log file `%s': %s\n",
-                        log_file, g_strerror(errno));
+    /* the crash handlers are one-shot; let the default action happen */
+    if (signum != SIGUSR2)
+        raise(signum);
+}
 
-            g_free(free_me);
+static void
+ring_init(void)
+{
+    static const int crash_signals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+    struct sigaction sa;
+    guint i;
 
-            debug_log_enabled = TRUE;
+    ring = g_new0(RingSlot, RING_N_SLOTS);
+    for (i = 0; i < RING_N_SLOTS; i++)
+        ring[i].seq = -1;
+
+    if (!gjs_environment_variable_is_set("GJS_DEBUG_RING_SIGNALS"))
+        return;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = dump_ring_signal_handler;
+    sigaction(SIGUSR2, &sa, NULL);
+
+    sa.sa_flags = SA_RESETHAND;
+    for (i = 0; i < G_N_ELEMENTS(crash_signals); i++)
+        sigaction(crash_signals[i], &sa, NULL);
+}
+
+static void
+debug_init(void)
+{
+    const char *debug_output;
+    const char *topics;
+    char **prefixes;
+    gboolean debug_log_enabled = FALSE;
+    gboolean strace_timestamps;
+    guint32 mask;
+    int topic;
+
+    print_timestamp = gjs_environment_variable_is_set("GJS_DEBUG_TIMESTAMP");
+    if (print_timestamp)
+        timer = g_timer_new();
+
+    debug_output = g_getenv("GJS_DEBUG_OUTPUT");
+    if (debug_output != NULL &&
+        strcmp(debug_output, "stderr") == 0) {
+        debug_log_enabled = TRUE;
+    } else if (debug_output != NULL &&
+               strcmp(debug_output, "ring") == 0) {
+        ring_init();
+        debug_log_enabled = TRUE;
+    } else if (debug_output != NULL) {
+        const char *log_file;
+        char *free_me;
+        char *c;
+
+        /* Allow debug-%u.log for per-pid logfiles as otherwise log
+         * messages from multiple processes can overwrite each other.
+         *
+         * (printf below should be safe as we check '%u' is the only format
+         * string)
+         */
+        c = strchr(debug_output, '%');
+        if (c && c[1] == 'u' && !strchr(c+1, '%')) {
+            free_me = g_strdup_printf(debug_output, (guint)getpid());
+            log_file = free_me;
+        } else {
+            log_file = debug_output;
+            free_me = NULL;
         }
 
-        if (logfp == NULL)
-            logfp = stderr;
+        /* avoid truncating in case we're using shared logfile; in
+         * append mode every write goes to the end anyway */
+        logfp = fopen(log_file, "a");
+        if (!logfp)
+            fprintf(stderr, "Failed to open log file `%s': %s\n",
+                    log_file, g_strerror(errno));
+        else
+            setvbuf(logfp, NULL, _IOLBF, 0);
 
-        strace_timestamps = gjs_environment_variable_is_set("GJS_STRACE_TIMESTAMPS");
+        g_free(free_me);
+
+        debug_log_enabled = TRUE;
     }
 
-    /* only strace timestamps if debug
-     * log wasn't specifically switched on
+    if (logfp == NULL)
+        logfp = stderr;
+
+    strace_timestamps = gjs_environment_variable_is_set("GJS_STRACE_TIMESTAMPS");
+
+    /* We never really free this, should be gone when the process exits */
+    topics = g_getenv("GJS_DEBUG_TOPICS");
+    prefixes = topics ? g_strsplit(topics, ";", -1) : NULL;
+
+    /* only strace timestamps if debug log wasn't specifically
+     * switched on
      */
-    if (!debug_log_enabled &&
-        topic != GJS_DEBUG_STRACE_TIMESTAMP)
-        return;
+    mask = 0;
+    for (topic = 0; topic < GJS_DEBUG_LAST_TOPIC; topic++) {
+        gboolean enabled;
 
-    switch (topic) {
-    case GJS_DEBUG_STRACE_TIMESTAMP:
-        /* return early if strace timestamps are disabled, avoiding
-         * printf format overhead and so forth.
-         */
-        if (!strace_timestamps)
-            return;
-        /* this is a special magic topic for use with
-         * git clone http://www.gnome.org/~federico/git/performance-scripts.git
-         * http://www.gnome.org/~federico/news-2006-03.html#timeline-tools
-         */
-        prefix = "MARK";
-        break;
-    case GJS_DEBUG_GI_USAGE:
-        prefix = "JS GI USE";
-        break;
-    case GJS_DEBUG_MEMORY:
-        prefix = "JS MEMORY";
-        break;
-    case GJS_DEBUG_CONTEXT:
-        prefix = "JS CTX";
-        break;
-    case GJS_DEBUG_IMPORTER:
-        prefix = "JS IMPORT";
-        break;
-    case GJS_DEBUG_NATIVE:
-        prefix = "JS NATIVE";
-        break;
-    case GJS_DEBUG_KEEP_ALIVE:
-        prefix = "JS KP ALV";
-        break;
-    case GJS_DEBUG_GREPO:
-        prefix = "JS G REPO";
-        break;
-    case GJS_DEBUG_GNAMESPACE:
-        prefix = "JS G NS";
-        break;
-    case GJS_DEBUG_GOBJECT:
-        prefix = "JS G OBJ";
-        break;
-    case GJS_DEBUG_GFUNCTION:
-        prefix = "JS G FUNC";
-        break;
-    case GJS_DEBUG_GFUNDAMENTAL:
-        prefix = "JS G FNDMTL";
-        break;
-    case GJS_DEBUG_GCLOSURE:
-        prefix = "JS G CLSR";
-        break;
-    case GJS_DEBUG_GBOXED:
-        prefix = "JS G BXD";
-        break;
-    case GJS_DEBUG_GENUM:
-        prefix = "JS G ENUM";
-        break;
-    case GJS_DEBUG_GPARAM:
-        prefix = "JS G PRM";
-        break;
-    case GJS_DEBUG_DATABASE:
-        prefix = "JS DB";
-        break;
-    case GJS_DEBUG_RESULTSET:
-        prefix = "JS RS";
-        break;
-    case GJS_DEBUG_WEAK_HASH:
-        prefix = "JS WEAK";
-        break;
-    case GJS_DEBUG_MAINLOOP:
-        prefix = "JS MAINLOOP";
-        break;
-    case GJS_DEBUG_PROPS:
-        prefix = "JS PROPS";
-        break;
-    case GJS_DEBUG_SCOPE:
-        prefix = "JS SCOPE";
-        break;
-    case GJS_DEBUG_HTTP:
-        prefix = "JS HTTP";
-        break;
-    case GJS_DEBUG_BYTE_ARRAY:
-        prefix = "JS BYTE ARRAY";
-        break;
-    case GJS_DEBUG_GERROR:
-        prefix = "JS G ERR";
-        break;
-    default:
-        prefix = "???";
-        break;
+        if (topic == GJS_DEBUG_STRACE_TIMESTAMP)
+            enabled = strace_timestamps;
+        else
+            enabled = debug_log_enabled;
+
+        if (enabled && is_allowed_prefix(prefixes, topic_prefixes[topic]))
+            mask |= 1u << topic;
+    }
+
+    g_strfreev(prefixes);
+
+    g_atomic_int_set((volatile gint *) &gjs_debug_topics, (gint) mask);
+}
+
+static void
+write_to_stream(FILE       *logfp,
+                const char *prefix,
+                const char *s)
+{
+    fprintf(logfp, "%*s: %s", PREFIX_LENGTH, prefix, s);
+    if (!g_str_has_suffix(s, "\n"))
+        fputs("\n", logfp);
+}
+
+void
+gjs_debug(GjsDebugTopic topic,
+          const char   *format,
+          ...)
+{
+    static gsize initialized = 0;
+    const char *prefix;
+    va_list args;
+    char buf[512];
+    char *s, *free_me;
+    int len;
+
+    if (g_once_init_enter(&initialized)) {
+        debug_init();
+        g_once_init_leave(&initialized, 1);
     }
 
-    if (!is_allowed_prefix(prefix))
+    if (topic >= GJS_DEBUG_LAST_TOPIC ||
+        (g_atomic_int_get((volatile gint *) &gjs_debug_topics) & (1u << topic)) == 0)
         return;
 
+    prefix = topic_prefixes[topic];
+
+    /* format on the stack; only long messages need the heap */
     va_start (args, format);
-    s = g_strdup_vprintf (format, args);
+    len = g_vsnprintf (buf, sizeof(buf), format, args);
     va_end (args);
 
+    if (len >= (int) sizeof(buf)) {
+        va_start (args, format);
+        s = free_me = g_strdup_vprintf (format, args);
+        va_end (args);
+    } else {
+        s = buf;
+        free_me = NULL;
+    }
+
     if (topic == GJS_DEBUG_STRACE_TIMESTAMP) {
         /* Put a magic string in strace output */
         char *s2;
@@ -261,12 +363,13 @@ gjs_debug(GjsDebugTopic topic,
         access(s2, F_OK);
         g_free(s2);
     } else {
+        char *s2 = NULL;
+
         if (print_timestamp) {
             static gdouble previous = 0.0;
             gdouble total = g_timer_elapsed(timer, NULL) * 1000.0;
             gdouble since = total - previous;
             const char *ts_suffix;
-            char *s2;
 
             if (since > 50.0) {
                 ts_suffix = "!!  ";
@@ -278,16 +381,19 @@ gjs_debug(GjsDebugTopic topic,
                 ts_suffix = "    ";
             }
 
-            s2 = g_strdup_printf("%g %s%s",
-                                 total, ts_suffix, s);
-            g_free(s);
-            s = s2;
+            s = s2 = g_strdup_printf("%g %s%s",
+                                     total, ts_suffix, s);
 
             previous = total;
         }
 
-        write_to_stream(logfp, prefix, s);
+        if (ring != NULL)
+            ring_append(prefix, s);
+        else
+            write_to_stream(logfp, prefix, s);
+
+        g_free(s2);
     }
 
-    g_free(s);
+    g_free(free_me);
 }
@@ -31,7 +31,7 @@ G_BEGIN_DECLS
 /* The idea of this is to be able to have one big log file for the entire
  * environment, and grep out what you care about. So each module or app
  * should have its own entry in the enum. Be sure to add new enum entries
- * to the switch in log.c
+ * to topic_prefixes in log.c
  */
 typedef enum {
     GJS_DEBUG_STRACE_TIMESTAMP,
@@ -59,8 +59,17 @@ typedef enum {
     GJS_DEBUG_BYTE_ARRAY,
     GJS_DEBUG_GERROR,
     GJS_DEBUG_GFUNDAMENTAL,
+    GJS_DEBUG_LAST_TOPIC
 } GjsDebugTopic;
 
+/* Whether gjs_debug() is compiled in at all. When it is, a call costs
+ * one test of gjs_debug_topics, and its arguments are only evaluated
+ * if the topic is enabled.
+ */
+#ifndef GJS_ENABLE_DEBUG_LOG
+#define GJS_ENABLE_DEBUG_LOG 1
+#endif
+
 /* These defines are because we have some pretty expensive and
  * extremely verbose debug output in certain areas, that's useful
  * sometimes, but just too much to compile in by default. The areas
@@ -152,10 +161,32 @@ typedef enum {
 #define gjs_debug_gsignal(format...)
 #endif
 
+/* Bit n is set if topic n is logged. All bits are set until the first
+ * message has gone through gjs_debug() and read the environment.
+ */
+extern guint32 gjs_debug_topics;
+
 void gjs_debug(GjsDebugTopic topic,
                const char   *format,
                ...) G_GNUC_PRINTF (2, 3);
 
+#if GJS_ENABLE_DEBUG_LOG
+#define gjs_debug(topic, ...)                                           \
+    G_STMT_START {                                                      \
+        if (G_UNLIKELY(gjs_debug_topics & (1u << (topic))))             \
+            gjs_debug(topic, __VA_ARGS__);                              \
+    } G_STMT_END
+#else
+#define gjs_debug(topic, ...) G_STMT_START { } G_STMT_END
+#endif
+
+/* With GJS_DEBUG_OUTPUT=ring, messages are kept in memory, and written
+ * out by this; it is async-signal-safe, so embedders can call it from
+ * their own crash handlers. Setting GJS_DEBUG_RING_SIGNALS also installs
+ * handlers writing it to stderr on SIGUSR2 and when the process crashes.
+ */
+void gjs_debug_dump_ring_buffer(int fd);
+
 G_END_DECLS
 
 #endif  /* __GJS_UTIL_LOG_H__ */